@@ -0,0 +1,114 @@
+// Depth buffer precision of the projections Camera can build, on the cpu: for an eye distance d the depth the gpu
+// would store is computed with the camera's matrix in float (like the vertex shader does), then stepped to the
+// next representable value of the depth format, and both are turned back into a distance. The difference is the
+// smallest gap between two surfaces at that distance that still gets different depth values, anything closer
+// z-fights.
+//  - 24 bit unorm, standard projection: what the default framebuffer gives us
+//  - 32F, standard projection: the float exponent is wasted, window depth sits close to 1 where floats are coarse
+//  - 32F, reversed-Z with infinite far: depth goes to 0 with distance, right where floats are finest
+// The standard projections use a far plane of 10000 so every distance in the table is inside the frustum.
+// Also counts how many of 100k surface pairs a fixed relative distance apart end up in the wrong order.
+//
+// build (from the repo root):
+//   clang++ -std=c++17 -O2 -I. -Idependencies/include benchmarks/depth_precision.cpp glad.c -o depth_precision
+
+#include "camera.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdint>
+
+static const float nearZ = 0.1f;
+static const float farZ = 10000.0f;
+
+enum DepthFormat {
+    UNORM24_STANDARD,
+    FLOAT32_STANDARD,
+    FLOAT32_REVERSED
+};
+
+// window space depth for a point d units in front of the camera, the way the gpu gets there
+static float windowDepth(const glm::mat4& projection, DepthFormat format, float d)
+{
+    glm::vec4 clip = projection * glm::vec4(0.0f, 0.0f, -d, 1.0f);
+    float ndc = clip.z / clip.w;
+    if(format == FLOAT32_REVERSED)
+        return ndc; //glClipControl(GL_LOWER_LEFT, GL_ZERO_TO_ONE), already [0, 1]
+    float depth = ndc * 0.5f + 0.5f;
+    if(format == UNORM24_STANDARD){
+        const double scale = (1 << 24) - 1;
+        return (float)(std::round(depth * scale) / scale);
+    }
+    return depth;
+}
+
+// the next value the depth buffer can hold, one step further away
+static float nextDepth(DepthFormat format, float depth)
+{
+    if(format == UNORM24_STANDARD){
+        const double scale = (1 << 24) - 1;
+        return (float)((std::round(depth * scale) + 1.0) / scale);
+    }
+    if(format == FLOAT32_REVERSED)
+        return std::nextafter(depth, 0.0f);
+    return std::nextafter(depth, 1.0f);
+}
+
+// exact (double) inverse of the projection
+static double eyeDistance(DepthFormat format, double depth)
+{
+    if(format == FLOAT32_REVERSED)
+        return nearZ / depth;
+    double ndc = depth * 2.0 - 1.0;
+    return 2.0 * farZ * nearZ / ((farZ + nearZ) - ndc * (farZ - nearZ));
+}
+
+static double resolution(const glm::mat4& projection, DepthFormat format, float d)
+{
+    float depth = windowDepth(projection, format, d);
+    return eyeDistance(format, nextDepth(format, depth)) - eyeDistance(format, depth);
+}
+
+// pairs of surfaces at d and d * (1 + gap) that don't compare the right way round (equal counts as wrong)
+static unsigned int misordered(const glm::mat4& projection, DepthFormat format, float gap)
+{
+    unsigned int wrong = 0;
+    uint32_t seed = 12345;
+    for(int i = 0; i < 100000; i++){
+        seed = seed * 1664525u + 1013904223u;
+        //log uniform between the near plane and 10000
+        float d = nearZ * std::pow(farZ / nearZ, (seed >> 8) / 16777216.0f);
+        float a = windowDepth(projection, format, d);
+        float b = windowDepth(projection, format, d * (1.0f + gap));
+        bool closerWins = format == FLOAT32_REVERSED ? a > b : a < b;
+        if(!closerWins)
+            wrong++;
+    }
+    return wrong;
+}
+
+int main()
+{
+    Camera camera(glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+    glm::mat4 standard = camera.camToProjMatrix(45.0f, 800.0f, 600.0f, nearZ, farZ);
+    camera.setReversedZ(true);
+    glm::mat4 reversed = camera.camToProjMatrix(45.0f, 800.0f, 600.0f, nearZ, farZ);
+
+    std::printf("near %.1f, far %.0f (standard) / infinite (reversed)\n\n", nearZ, farZ);
+    std::printf("smallest separable gap in world units\n");
+    std::printf("distance    24 bit standard     32F standard    32F reversed-Z\n");
+    const float distances[] = {1.0f, 10.0f, 100.0f, 1000.0f, 10000.0f};
+    for(float d : distances){
+        std::printf("%8.0f   %16.3g %16.3g %17.3g\n", d,
+            resolution(standard, UNORM24_STANDARD, d), resolution(standard, FLOAT32_STANDARD, d), resolution(reversed, FLOAT32_REVERSED, d));
+    }
+
+    std::printf("\nmisordered surface pairs out of 100k (distance log uniform from near to %.0f)\n", farZ);
+    std::printf("relative gap   24 bit standard     32F standard    32F reversed-Z\n");
+    const float gaps[] = {1e-2f, 1e-3f, 1e-4f, 1e-5f, 1e-6f};
+    for(float gap : gaps){
+        std::printf("%12.0e   %16u %16u %17u\n", gap,
+            misordered(standard, UNORM24_STANDARD, gap), misordered(standard, FLOAT32_STANDARD, gap), misordered(reversed, FLOAT32_REVERSED, gap));
+    }
+    return 0;
+}
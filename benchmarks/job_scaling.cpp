@@ -0,0 +1,95 @@
+// Scaling of the job system from 1 core to all of them on the cpu work of a frame and of startup:
+//  - transforms: updateWorldTransforms over 256k entities (the split is per ECS chunk)
+//  - bc7:        compressImage of a 1024x1024 texture (the split is per row of blocks), what the cooks run
+//  - tiny jobs:  parallelFor over 1M items with a trivial body, mostly measures the scheduling overhead
+// Each pass restarts the job system with one more thread and reports the best of several runs.
+//
+// build (from the repo root):
+//   clang++ -std=c++17 -O2 -I. -Idependencies/include benchmarks/job_scaling.cpp glad.c stb_helper.cpp -o job_scaling
+// run:
+//   ./job_scaling [maxThreads]     (defaults to the number of cores)
+
+#include "jobs.h"
+#include "ecs.h"
+#include "scene.h"
+#include "texture_cooker.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+// best of runs, in ms
+template<typename F>
+static double timeBest(int runs, F f)
+{
+    double best = 1e30;
+    for(int i = 0; i < runs; i++){
+        auto start = std::chrono::high_resolution_clock::now();
+        f();
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+        if(ms < best)
+            best = ms;
+    }
+    return best;
+}
+
+int main(int argc, char** argv)
+{
+    const unsigned int entityCount = 256 * 1024;
+    const int imageSize = 1024;
+    unsigned int cores = std::thread::hardware_concurrency();
+    if(argc > 1)
+        cores = (unsigned int)std::atoi(argv[1]);
+    if(cores == 0)
+        cores = 1;
+
+    World world;
+    for(unsigned int i = 0; i < entityCount; i++){
+        Transform transform = makeTransform(glm::vec3(float(i % 512), float(i / 512), 0.0f), glm::vec3(1.0f + (i % 7) * 0.1f));
+        transform.rotation = glm::angleAxis(i * 0.001f, glm::normalize(glm::vec3(1.0f, 2.0f, 3.0f)));
+        world.create(transform, WorldTransform());
+    }
+
+    std::vector<uint8_t> image(imageSize * imageSize * 4);
+    for(int y = 0; y < imageSize; y++){
+        for(int x = 0; x < imageSize; x++){
+            uint8_t* p = &image[(y * imageSize + x) * 4];
+            p[0] = (uint8_t)(127.5f + 127.5f * std::sin(x * 0.05f));
+            p[1] = (uint8_t)(127.5f + 127.5f * std::cos(y * 0.03f));
+            p[2] = (uint8_t)((x ^ y) & 255);
+            p[3] = 255;
+        }
+    }
+
+    std::vector<float> values(1024 * 1024, 1.0f);
+
+    std::printf("%u entities (%u chunks), %dx%d bc7, %u tiny items\n", entityCount, (unsigned int)world.chunks<Transform, WorldTransform>().size(), imageSize, imageSize, (unsigned int)values.size());
+    std::printf("threads   transforms ms  speedup   bc7 ms  speedup   tiny ms  speedup   stolen\n");
+
+    double baseTransforms = 0.0, baseBC7 = 0.0, baseTiny = 0.0;
+    for(unsigned int threads = 1; threads <= cores; threads++){
+        jobSystem.start(threads - 1);
+
+        double transforms = timeBest(20, [&](){ updateWorldTransforms(world); });
+        double bc7 = timeBest(3, [&](){ compressImage(image, imageSize, imageSize, TEXTURE_BC7); });
+        double tiny = timeBest(20, [&](){
+            jobSystem.parallelFor((unsigned int)values.size(), 1024, [&values](unsigned int begin, unsigned int end){
+                for(unsigned int i = begin; i < end; i++)
+                    values[i] = values[i] * 0.5f + 0.5f;
+            });
+        });
+        unsigned int stolen = jobSystem.stolen;
+        jobSystem.stop();
+
+        if(threads == 1){
+            baseTransforms = transforms;
+            baseBC7 = bc7;
+            baseTiny = tiny;
+        }
+        std::printf("%7u   %13.2f  %6.2fx   %6.1f  %6.2fx   %7.2f  %6.2fx   %6u\n", threads, transforms, baseTransforms / transforms, bc7, baseBC7 / bc7, tiny, baseTiny / tiny, stolen);
+    }
+    return 0;
+}
@@ -0,0 +1,210 @@
+// Sorted alpha blending vs weighted blended order independent transparency (oit.h) as the number of
+// transparent quads grows. Both paths draw the same window quads with one instanced draw into an offscreen target:
+//  - sorted: collectTransparent() with the back to front sort, upload, draw with shaders/blending.fs
+//  - oit: collectTransparent() without the sort, upload, draw into the oit targets with shaders/oit.fs, composite
+// cpu is collect + sort + upload, gpu is a GL_TIME_ELAPSED query around the draws (and the composite). Both are
+// averaged over 20 frames after 5 warm up frames. The quads are scattered through a box in front of the camera
+// and overlap a lot, so the gpu numbers are mostly fill rate.
+//
+// build (from the repo root, macOS):
+//   clang++ -std=c++17 -O2 -I. -Idependencies/include benchmarks/oit.cpp glad.c
+//     dependencies/library/libglfw.3.3.dylib -framework OpenGL -framework Cocoa -framework IOKit -o oit
+// run from the repo root, it loads the shaders from shaders/.
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "gl_ext.h"
+#include "shader.h"
+#include "ecs.h"
+#include "scene.h"
+#include "render_target.h"
+#include "oit.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+static const int WIDTH = 1280;
+static const int HEIGHT = 720;
+static const int WARMUP_FRAMES = 5;
+static const int FRAMES = 20;
+
+struct Timings {
+    double cpu; // ms per frame
+    double gpu; // ms per frame
+};
+
+// one frame of either path, cpu and gpu time are added to timings
+static void drawFrame(World& world, bool oitPass, std::vector<TransparentDraw>& draws, Shader& shader, Shader& compositeShader,
+    RenderTarget& target, WeightedOIT& oit, unsigned int vao, unsigned int instanceVBO, unsigned int texture, unsigned int query, Timings& timings)
+{
+    const glm::vec3 cameraPosition(0.0f);
+    auto start = std::chrono::high_resolution_clock::now();
+    collectTransparent(world, cameraPosition, draws, !oitPass);
+    std::vector<glm::mat4> models(draws.size());
+    for(unsigned int i = 0; i < draws.size(); i++)
+        models[i] = draws[i].model;
+    glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+    glBufferData(GL_ARRAY_BUFFER, models.size() * sizeof(glm::mat4), NULL, GL_STREAM_DRAW); //orphan
+    glBufferSubData(GL_ARRAY_BUFFER, 0, models.size() * sizeof(glm::mat4), models.data());
+    auto end = std::chrono::high_resolution_clock::now();
+    timings.cpu += std::chrono::duration<double, std::milli>(end - start).count();
+
+    target.bind();
+    glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    glBeginQuery(GL_TIME_ELAPSED, query);
+    shader.use();
+    glBindTexture(GL_TEXTURE_2D, texture); //the composite leaves the oit targets bound
+    if(oitPass)
+        oit.begin();
+    glBindVertexArray(vao);
+    glDrawArraysInstanced(GL_TRIANGLES, 0, 6, (GLsizei)models.size());
+    glBindVertexArray(0);
+    if(oitPass){
+        target.bind();
+        oit.composite(compositeShader);
+    }
+    glEndQuery(GL_TIME_ELAPSED);
+
+    GLuint64 elapsed = 0;
+    glGetQueryObjectui64v(query, GL_QUERY_RESULT, &elapsed); //waits, fine here
+    timings.gpu += elapsed / 1e6;
+}
+
+int main()
+{
+    glfwInit();
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    GLFWwindow* window = glfwCreateWindow(64, 64, "oit", NULL, NULL);
+    if(window == NULL){
+        std::printf("Failed to create GLFW window\n");
+        glfwTerminate();
+        return -1;
+    }
+    glfwMakeContextCurrent(window);
+    gladLoadGL();
+    loadGLExtensions();
+
+    RenderTarget target;
+    target.create(WIDTH, HEIGHT);
+    WeightedOIT oit;
+    if(!oit.create(WIDTH, HEIGHT, target.depthStencil))
+        return -1;
+
+    Shader sortedShader("shaders/blendingInstanced.vs", "shaders/blending.fs");
+    Shader oitShader("shaders/blendingInstanced.vs", "shaders/oit.fs");
+    Shader compositeShader("shaders/fullscreen.vs", "shaders/oitComposite.fs");
+    glm::mat4 view = glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    glm::mat4 projection = glm::perspective(glm::radians(45.0f), (float)WIDTH / (float)HEIGHT, 0.1f, 200.0f);
+    Shader* windowShaders[2] = {&sortedShader, &oitShader};
+    for(Shader* shader : windowShaders){
+        shader->use();
+        shader->setInt("texture1", 0);
+        shader->setMat4("view", view);
+        shader->setMat4("projection", projection);
+    }
+    compositeShader.use();
+    compositeShader.setInt("accumulation", 0);
+    compositeShader.setInt("weights", 1);
+
+    //a tinted half transparent texture instead of textures/window.png, the benchmark shouldn't need the assets
+    const unsigned char pixels[16] = {
+        200,  80,  80, 128,   80, 200,  80, 128,
+         80,  80, 200, 128,  200, 200,  80, 128
+    };
+    unsigned int texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 2, 2, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+    //the window quad of main.cpp
+    float quadVertices[] = {
+        0.0f,  0.5f,  0.0f,  0.0f,  0.0f,
+        0.0f, -0.5f,  0.0f,  0.0f,  1.0f,
+        1.0f, -0.5f,  0.0f,  1.0f,  1.0f,
+
+        0.0f,  0.5f,  0.0f,  0.0f,  0.0f,
+        1.0f, -0.5f,  0.0f,  1.0f,  1.0f,
+        1.0f,  0.5f,  0.0f,  1.0f,  0.0f
+    };
+    unsigned int vao, vbo, instanceVBO;
+    glGenVertexArrays(1, &vao);
+    glGenBuffers(1, &vbo);
+    glGenBuffers(1, &instanceVBO);
+    glBindVertexArray(vao);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), quadVertices, GL_STATIC_DRAW);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
+    glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+    for(unsigned int i = 0; i < 4; i++){
+        glEnableVertexAttribArray(2 + i);
+        glVertexAttribPointer(2 + i, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(i * sizeof(glm::vec4)));
+        glVertexAttribDivisor(2 + i, 1);
+    }
+    glBindVertexArray(0);
+
+    unsigned int query;
+    glGenQueries(1, &query);
+
+    glEnable(GL_DEPTH_TEST);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glActiveTexture(GL_TEXTURE0);
+
+    std::printf("%dx%d, ms per frame (average of %d)\n", WIDTH, HEIGHT, FRAMES);
+    std::printf("   quads     sorted cpu   sorted gpu      oit cpu      oit gpu\n");
+    std::vector<TransparentDraw> draws;
+    const unsigned int counts[] = {1000, 4000, 16000, 64000};
+    for(unsigned int count : counts){
+        World world;
+        uint32_t seed = 12345;
+        auto next = [&seed](){
+            seed = seed * 1664525u + 1013904223u;
+            return (seed >> 8) / 16777216.0f;
+        };
+        for(unsigned int i = 0; i < count; i++){
+            glm::vec3 position((next() - 0.5f) * 60.0f, (next() - 0.5f) * 30.0f, -5.0f - next() * 100.0f);
+            world.create(WorldTransform{glm::translate(glm::mat4(1.0f), position)}, Transparent{texture});
+        }
+
+        Timings results[2];
+        for(int mode = 0; mode < 2; mode++){
+            bool oitPass = mode == 1;
+            Timings timings = {0.0, 0.0};
+            for(int frame = 0; frame < WARMUP_FRAMES; frame++)
+                drawFrame(world, oitPass, draws, *windowShaders[mode], compositeShader, target, oit, vao, instanceVBO, texture, query, timings);
+            timings = {0.0, 0.0};
+            for(int frame = 0; frame < FRAMES; frame++)
+                drawFrame(world, oitPass, draws, *windowShaders[mode], compositeShader, target, oit, vao, instanceVBO, texture, query, timings);
+            results[mode] = {timings.cpu / FRAMES, timings.gpu / FRAMES};
+        }
+        std::printf("%8u   %12.3f %12.3f %12.3f %12.3f\n", count, results[0].cpu, results[0].gpu, results[1].cpu, results[1].gpu);
+    }
+
+    glDeleteQueries(1, &query);
+    glDeleteVertexArrays(1, &vao);
+    glDeleteBuffers(1, &vbo);
+    glDeleteBuffers(1, &instanceVBO);
+    glDeleteTextures(1, &texture);
+    oit.release();
+    target.release();
+    shaderCompileThread.stop();
+    glfwTerminate();
+    return 0;
+}
@@ -0,0 +1,114 @@
+// Startup cost of building ~50 shader programs: compile + link one at a time, all started up front and waited
+// for at the end (KHR_parallel_shader_compile or the shared context compile thread), a cold program binary cache
+// (compile + link + glGetProgramBinary + write) and a warm one (read + glProgramBinary).
+// Every variant gets its own define so the driver can't reuse anything between them or between the passes,
+// but drivers with their own on disk shader cache will be faster on the second run of the benchmark.
+//
+// build (from the repo root, macOS):
+//   clang++ -std=c++17 -O2 -I. -Idependencies/include benchmarks/shader_startup.cpp glad.c
+//     dependencies/library/libglfw.3.3.dylib -framework OpenGL -framework Cocoa -framework IOKit -o shader_startup
+// run from the repo root, it only touches the cache/shaders folder.
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include "gl_ext.h"
+#include "shader.h"
+
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+struct ShaderPair {
+    const char* vertex;
+    const char* fragment;
+};
+
+// builds every variant, returns the total time in ms
+// serial waits for each program right after creating it, which is what the old Shader constructor did
+static double buildAll(const std::vector<ShaderPair>& pairs, int variantsPerPair, int firstVariant, bool serial, bool useCache, int& fromCache)
+{
+    fromCache = 0;
+    std::vector<Shader> shaders;
+    auto start = std::chrono::high_resolution_clock::now();
+    for(unsigned int i = 0; i < pairs.size(); i++){
+        for(int v = 0; v < variantsPerPair; v++){
+            shaders.push_back(Shader(pairs[i].vertex, pairs[i].fragment, {"BENCHMARK_VARIANT " + std::to_string(firstVariant + v)}, useCache));
+            if(serial)
+                shaders.back().finish();
+        }
+    }
+    for(unsigned int i = 0; i < shaders.size(); i++)
+        shaders[i].finish();
+    glFinish();
+    auto end = std::chrono::high_resolution_clock::now();
+
+    for(unsigned int i = 0; i < shaders.size(); i++){
+        if(shaders[i].loadedFromCache)
+            fromCache++;
+        glDeleteProgram(shaders[i].shaderProgram);
+    }
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+int main()
+{
+    glfwInit();
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    GLFWwindow* window = glfwCreateWindow(64, 64, "shader_startup", NULL, NULL);
+    if(window == NULL){
+        std::printf("Failed to create GLFW window\n");
+        glfwTerminate();
+        return -1;
+    }
+    glfwMakeContextCurrent(window);
+    gladLoadGL();
+    loadGLExtensions();
+    if(!glExt.parallelShaderCompile)
+        shaderCompileThread.start(window);
+
+    std::vector<ShaderPair> pairs = {
+        {"shaders/blending.vs", "shaders/blending.fs"},
+        {"shaders/blendingInstanced.vs", "shaders/blending.fs"},
+        {"shaders/depth.vs", "shaders/depth.fs"},
+        {"shaders/shaderSingleColor.vs", "shaders/shaderSingleColor.fs"},
+        {"shaders/indirectFallback.vs", "shaders/scene.fs"},
+    };
+
+    const int VARIANTS_PER_PAIR = 10;
+    const unsigned int programCount = (unsigned int)pairs.size() * VARIANTS_PER_PAIR;
+
+    std::printf("%u programs, program binary cache %s\n", programCount,
+        glExt.programBinary ? "available" : "not available (driver reports no binary formats), every run compiles");
+    std::printf("parallel compile: %s\n", glExt.parallelShaderCompile ? "KHR_parallel_shader_compile" : "shared context compile thread");
+
+    std::error_code error;
+    std::filesystem::remove_all(SHADER_CACHE_DIR, error);
+
+    int fromCache = 0;
+    double compile = buildAll(pairs, VARIANTS_PER_PAIR, 0, true, false, fromCache);
+    std::printf("serial compile:   %8.1f ms  (%.2f ms per program)\n", compile, compile / programCount);
+
+    double batched = buildAll(pairs, VARIANTS_PER_PAIR, 100, false, false, fromCache);
+    std::printf("batched compile:  %8.1f ms  (%.2f ms per program)\n", batched, batched / programCount);
+
+    double cold = buildAll(pairs, VARIANTS_PER_PAIR, 200, false, true, fromCache);
+    std::printf("cold cache:       %8.1f ms  (%.2f ms per program, %d from cache)\n", cold, cold / programCount, fromCache);
+
+    double warm = buildAll(pairs, VARIANTS_PER_PAIR, 200, false, true, fromCache);
+    std::printf("warm cache:       %8.1f ms  (%.2f ms per program, %d from cache)\n", warm, warm / programCount, fromCache);
+    if(batched > 0.0)
+        std::printf("batched speedup:  %8.1fx\n", compile / batched);
+    if(warm > 0.0)
+        std::printf("cache speedup:    %8.1fx\n", compile / warm);
+
+    shaderCompileThread.stop();
+    glfwTerminate();
+    return 0;
+}
@@ -0,0 +1,144 @@
+// The software occlusion rasterizer (software_occlusion.h) on a city block, no gpu needed:
+//  - 256 buildings as 12 triangle box occluders, camera at street level looking down a street
+//  - rasterize: begin + draw + finish (binning, tiles on the job system, hi-z build) at 320x192, scalar and
+//    simd rows (AVX2 when the cpu has it, 4 wide otherwise), from 1 thread up to all cores
+//  - test: 100k object boxes scattered over the city, the ones inside the frustum against the result
+// Prints the best of 20 runs in ms, how many objects were occluded and the largest difference between the
+// scalar and the simd depth buffer (should be 0 or a rounding step).
+//
+// build (from the repo root):
+//   clang++ -std=c++17 -O2 -I. -Idependencies/include benchmarks/software_occlusion.cpp glad.c -o software_occlusion
+// run:
+//   ./software_occlusion [maxThreads]     (defaults to the number of cores)
+
+#include "camera.h"
+#include "jobs.h"
+#include "software_occlusion.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+// best of runs, in ms
+template<typename F>
+static double timeBest(int runs, F f)
+{
+    double best = 1e30;
+    for(int i = 0; i < runs; i++){
+        auto start = std::chrono::high_resolution_clock::now();
+        f();
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+        if(ms < best)
+            best = ms;
+    }
+    return best;
+}
+
+// unit box around the origin as a triangle list
+static void unitBox(std::vector<glm::vec3>& positions, std::vector<unsigned int>& indices)
+{
+    for(int i = 0; i < 8; i++)
+        positions.push_back(glm::vec3((i & 1) ? 0.5f : -0.5f, (i & 2) ? 0.5f : -0.5f, (i & 4) ? 0.5f : -0.5f));
+    const unsigned int faces[36] = {0, 2, 1, 1, 2, 3,  4, 5, 6, 5, 7, 6,  0, 1, 4, 1, 5, 4,
+                                    2, 6, 3, 3, 6, 7,  0, 4, 2, 2, 4, 6,  1, 3, 5, 3, 7, 5};
+    indices.assign(faces, faces + 36);
+}
+
+int main(int argc, char** argv)
+{
+    unsigned int cores = std::thread::hardware_concurrency();
+    if(argc > 1)
+        cores = (unsigned int)std::atoi(argv[1]);
+    if(cores == 0)
+        cores = 1;
+
+    SoftwareOcclusion occlusion(320, 192);
+    std::vector<glm::vec3> positions;
+    std::vector<unsigned int> indices;
+    unitBox(positions, indices);
+    unsigned int box = occlusion.addMesh(positions, indices);
+
+    //16x16 blocks of 8x8 buildings with 4 wide streets, 6 to 30 high
+    std::vector<glm::mat4> buildings;
+    uint32_t seed = 1;
+    for(int z = 0; z < 16; z++){
+        for(int x = 0; x < 16; x++){
+            seed = seed * 1664525u + 1013904223u;
+            float height = 6.0f + (seed >> 8) % 25;
+            glm::mat4 model(1.0f);
+            model[0][0] = 8.0f;
+            model[1][1] = height;
+            model[2][2] = 8.0f;
+            model[3] = glm::vec4(x * 12.0f - 90.0f, height * 0.5f, -z * 12.0f, 1.0f);
+            buildings.push_back(model);
+        }
+    }
+
+    //objects: 1x1x1 boxes anywhere in the city, inside buildings or not
+    std::vector<glm::vec3> objectMin, objectMax;
+    for(int i = 0; i < 100000; i++){
+        seed = seed * 1664525u + 1013904223u;
+        float x = (seed >> 8) / 16777216.0f * 192.0f - 96.0f;
+        seed = seed * 1664525u + 1013904223u;
+        float z = (seed >> 8) / 16777216.0f * -192.0f;
+        seed = seed * 1664525u + 1013904223u;
+        float y = (seed >> 8) / 16777216.0f * 10.0f;
+        objectMin.push_back(glm::vec3(x, y, z));
+        objectMax.push_back(glm::vec3(x + 1.0f, y + 1.0f, z + 1.0f));
+    }
+
+    //standing in the street between the 8th and 9th column of buildings, looking down it
+    Camera camera(glm::vec3(0.0f, 1.8f, 6.0f), glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.1f, -0.05f, 1.0f));
+    glm::mat4 viewProjection = camera.worldToProjMatrix(60.0f, 1280.0f, 768.0f, 0.1f, 1000.0f);
+
+    //only what survives frustum culling gets tested, like collectVisibleDraws does
+    std::vector<unsigned int> inFrustum;
+    for(unsigned int i = 0; i < objectMin.size(); i++){
+        if(boxInFrustum(camera.frustumPlanes(), objectMin[i], objectMax[i]))
+            inFrustum.push_back(i);
+    }
+
+    auto rasterize = [&](){
+        occlusion.begin(viewProjection, false);
+        for(unsigned int i = 0; i < buildings.size(); i++)
+            occlusion.draw(box, buildings[i]);
+        occlusion.finish();
+    };
+
+    std::printf("simd rows: %s\n", occlusion.avx2 ? "AVX2, 8 wide" : "f4, 4 wide");
+
+    jobSystem.start(0);
+    occlusion.simd = false;
+    rasterize();
+    std::vector<float> scalarDepth(occlusion.depthBuffer(), occlusion.depthBuffer() + occlusion.bufferWidth() * occlusion.bufferHeight());
+    occlusion.simd = true;
+    rasterize();
+    float difference = 0.0f;
+    for(unsigned int i = 0; i < scalarDepth.size(); i++)
+        difference = std::max(difference, std::fabs(scalarDepth[i] - occlusion.depthBuffer()[i]));
+    jobSystem.stop();
+
+    std::printf("%u buildings, %u triangles after clipping, %u in tile bins, %dx%d, max scalar/simd difference %g\n",
+        (unsigned int)buildings.size(), occlusion.triangles, occlusion.tileTriangles, occlusion.bufferWidth(), occlusion.bufferHeight(), difference);
+    std::printf("%u of %u objects in the frustum\n", (unsigned int)inFrustum.size(), (unsigned int)objectMin.size());
+    std::printf("threads   scalar ms   simd ms   speedup    test ms   occluded\n");
+    for(unsigned int threads = 1; threads <= cores; threads++){
+        jobSystem.start(threads - 1);
+        occlusion.simd = false;
+        double scalar = timeBest(20, rasterize);
+        occlusion.simd = true;
+        double simd = timeBest(20, rasterize);
+        unsigned int occluded = 0;
+        double test = timeBest(5, [&](){
+            occluded = 0;
+            for(unsigned int i : inFrustum)
+                occluded += occlusion.isOccluded(objectMin[i], objectMax[i]) ? 1 : 0;
+        });
+        jobSystem.stop();
+        std::printf("%7u   %9.3f  %8.3f  %7.2fx   %8.2f   %8u\n", threads, scalar, simd, scalar / simd, test, occluded);
+    }
+    return 0;
+}
@@ -12,6 +12,8 @@
 #define GLM_ENABLE_EXPERIMENTAL
 #include "glm/ext.hpp"
 
+#include "simd_math.h"
+
 #include <vector>
 
 // Defines several possible options for camera movement. Used as abstraction to stay away from window-system specific input methods
@@ -51,7 +53,37 @@ class Camera{
         }
 
         void setPosition(float x, float y, float z){
-            camPos = glm::vec3(x, y, z);
+            setPosition(glm::vec3(x, y, z));
+        }
+
+        void setPosition(glm::vec3 position){
+            if(position == camPos)
+                return;
+            camPos = position;
+            markViewDirty();
+        }
+
+        void setOrientation(glm::vec3 newDirection, glm::vec3 newUp){
+            newDirection = glm::normalize(newDirection);
+            newUp = glm::normalize(newUp);
+            if(newDirection == direction && newUp == up)
+                return;
+            direction = newDirection;
+            up = newUp;
+            markViewDirty();
+        }
+
+        // call after writing camPos/direction/up directly, the setters and Process* functions do it themselves
+        void markViewDirty(){
+            viewDirty = true;
+            derivedDirty = true;
+            changes++;
+        }
+
+        // bumped whenever the view or the projection changes, keep a copy and compare to skip work (culling,
+        // uniform/ubo uploads, sort keys) on frames where the camera didn't change
+        unsigned int version() const{
+            return changes;
         }
         
         void ProcessKeyboard(Camera_Movement move, float deltaTime){
@@ -65,9 +97,15 @@ class Camera{
                 camPos -= glm::normalize(glm::cross(up, direction)) * cameraSpeed;
             if (move == RIGHT)
                 camPos += glm::normalize(glm::cross(up, direction)) * cameraSpeed;
+            markViewDirty();
         };
 
+        // cached, only rebuilt after the camera moved or turned
         glm::mat4 worldToCamMatrix(){
+            if(!viewDirty)
+                return view;
+            viewDirty = false;
+
             // 1. Normalize direction
             glm::vec3 newN = glm::normalize(direction);
             // 2. Get positive right axis vector
@@ -75,38 +113,74 @@ class Camera{
             // 3. Calculate camera up vector
             glm::vec3 newV = glm::cross(newN, newU);
 
-            // Create translation and rotation matrix
+            // The lookAt matrix is rotation * translation, rotation has the axes as rows and translation moves the
+            // camera to the origin. Multiplied out the translation column is just minus the camera position
+            // projected onto each axis, so there is no need to build both matrices and multiply them
             // In glm we access elements as mat[col][row] due to column-major layout
-            glm::mat4 translation = glm::mat4(1.0f); // Identity matrix by default
-            translation[3][0] = -camPos.x; // Third column, first row
-            translation[3][1] = -camPos.y;
-            translation[3][2] = -camPos.z;
-            glm::mat4 rotation = glm::mat4(1.0f);
-            rotation[0][0] = newU.x; // First column, first row
-            rotation[1][0] = newU.y;
-            rotation[2][0] = newU.z;
-            rotation[0][1] = newV.x; // First column, second row
-            rotation[1][1] = newV.y;
-            rotation[2][1] = newV.z;
-            rotation[0][2] = newN.x; // First column, third row
-            rotation[1][2] = newN.y;
-            rotation[2][2] = newN.z; 
-
-            // Return lookAt matrix as combination of translation and rotation matrix
-            return rotation * translation; // Remember to read from right to left (first translation then rotation)
-        }
-
-        //broken rn
+            view = glm::mat4(1.0f);
+            view[0][0] = newU.x; // First column, first row
+            view[1][0] = newU.y;
+            view[2][0] = newU.z;
+            view[0][1] = newV.x; // First column, second row
+            view[1][1] = newV.y;
+            view[2][1] = newV.z;
+            view[0][2] = newN.x; // First column, third row
+            view[1][2] = newN.y;
+            view[2][2] = newN.z;
+            view[3][0] = -glm::dot(newU, camPos);
+            view[3][1] = -glm::dot(newV, camPos);
+            view[3][2] = -glm::dot(newN, camPos);
+            return view;
+        }
+
+        // Reversed-Z with an infinite far plane: depth is nearZ / distance, so 1 at the near plane and 0 at infinity
+        // (farZ is ignored). Floats have most of their precision near 0, which cancels out the 1/z falloff and
+        // leaves roughly constant relative precision over the whole range. Only worth it with a 32F depth buffer and
+        // glClipControl(GL_LOWER_LEFT, GL_ZERO_TO_ONE), without it the [-1, 1] -> [0, 1] remap adds 0.5 to every
+        // depth and throws the precision away again. The depth test has to be flipped to GL_GREATER and depth
+        // cleared to 0.
+        void setReversedZ(bool enabled){
+            if(enabled == reversedZ)
+                return;
+            reversedZ = enabled;
+            projFOV = 0.0f; //forces camToProjMatrix to rebuild
+            derivedDirty = true;
+            changes++;
+        }
+
+        bool isReversedZ() const{
+            return reversedZ;
+        }
+
+        // cached, only rebuilt when one of the parameters changed (fov change, window resize)
         glm::mat4 camToProjMatrix(float FOV, float width, float height, float nearZ, float farZ){
+            if(FOV == projFOV && width == projWidth && height == projHeight && nearZ == projNear && farZ == projFar)
+                return projection;
+            projFOV = FOV;
+            projWidth = width;
+            projHeight = height;
+            projNear = nearZ;
+            projFar = farZ;
+            derivedDirty = true;
+            changes++;
+
             float hFOV = glm::radians(FOV/2.0f);
+            float tanHalfFOV = tan(hFOV);
             float ar = width/height;
             float A = (farZ + nearZ)/(farZ - nearZ);
             float B = - (2 * nearZ * farZ)/(farZ - nearZ);
 
             // In glm we access elements as mat[col][row] due to column-major layout
-            glm::mat4 projection = glm::mat4();
-            projection[0][0] = 1.0f / (ar * tan(hFOV)); // First column, first row
-            projection[1][1] = 1.0f / (tan(hFOV));
+            projection = glm::mat4(0.0f); // glm::mat4() is left uninitialized by newer glm versions
+            projection[0][0] = 1.0f / (ar * tanHalfFOV); // First column, first row
+            projection[1][1] = 1.0f / tanHalfFOV;
+
+            if(reversedZ){
+                //z_clip = nearZ, w_clip = -z_eye, the limit of the [0, 1] projection with near and far swapped as far -> infinity
+                projection[2][3] = -1.0f;
+                projection[3][2] = nearZ;
+                return projection;
+            }
 
             //idk why these 2 are negative
             projection[2][2] = -A; 
@@ -116,6 +190,51 @@ class Camera{
             return projection; 
         }
 
+        // projection * view, what culling and anything that goes straight from world to clip space wants
+        glm::mat4 worldToProjMatrix(float FOV, float width, float height, float nearZ, float farZ){
+            camToProjMatrix(FOV, width, height, nearZ, farZ);
+            updateDerived();
+            return viewProjection;
+        }
+
+        // everything below uses the projection of the last camToProjMatrix/worldToProjMatrix call
+        glm::mat4 worldToProjMatrix(){
+            updateDerived();
+            return viewProjection;
+        }
+
+        glm::mat4 camToWorldMatrix(){
+            updateDerived();
+            return inverseView;
+        }
+
+        glm::mat4 projToCamMatrix(){
+            updateDerived();
+            return inverseProjection;
+        }
+
+        // clip space back to world space, for reconstructing positions from depth
+        glm::mat4 projToWorldMatrix(){
+            updateDerived();
+            return inverseViewProjection;
+        }
+
+        // left, right, bottom, top, near, far in world space, normalized, a point p is inside all of them when
+        // dot(plane.xyz, p) + plane.w >= 0
+        const glm::vec4* frustumPlanes(){
+            updateDerived();
+            return planes;
+        }
+
+        bool sphereInFrustum(glm::vec3 center, float radius){
+            updateDerived();
+            for(int i = 0; i < 6; i++){
+                if(glm::dot(glm::vec3(planes[i]), center) + planes[i].w < -radius)
+                    return false;
+            }
+            return true;
+        }
+
         // processes input received from a mouse input system. Expects the offset value in both the x and y direction.
         void ProcessMouseMovement(float xoffset, float yoffset, float FOV, GLboolean constrainPitch = true)
         {
@@ -152,6 +271,7 @@ class Camera{
             //by rotating direction around WorldUp we must recalculate both right and up
             right = glm::normalize(glm::cross(worldUp, direction));
             up = glm::normalize(glm::cross(direction, right));
+            markViewDirty();
         }
 
         //combined multiple quaternion
@@ -207,6 +327,59 @@ class Camera{
         float sensitivity;//range 0 - 1 exculsive
         float yaw;
         float pitch;
+
+    private:
+        //cached matrices, see worldToCamMatrix/camToProjMatrix
+        bool viewDirty = true;
+        bool derivedDirty = true;
+        unsigned int changes = 0;
+        glm::mat4 view = glm::mat4(1.0f);
+        glm::mat4 projection = glm::mat4(1.0f);
+        float projFOV = 0.0f, projWidth = 0.0f, projHeight = 0.0f, projNear = 0.0f, projFar = 0.0f;
+        glm::mat4 viewProjection = glm::mat4(1.0f);
+        glm::mat4 inverseView = glm::mat4(1.0f);
+        glm::mat4 inverseProjection = glm::mat4(1.0f);
+        glm::mat4 inverseViewProjection = glm::mat4(1.0f);
+        glm::vec4 planes[6];
+        bool reversedZ = false;
+
+        void updateDerived(){
+            worldToCamMatrix();
+            if(!derivedDirty)
+                return;
+            derivedDirty = false;
+
+            viewProjection = simdMul(projection, view);
+            //the view is a rotation + translation, so its inverse is the transposed rotation + the camera position
+            inverseView = glm::mat4(1.0f);
+            for(int c = 0; c < 3; c++){
+                for(int r = 0; r < 3; r++)
+                    inverseView[c][r] = view[r][c];
+            }
+            inverseView[3] = glm::vec4(camPos, 1.0f);
+            inverseProjection = glm::inverse(projection);
+            inverseViewProjection = simdMul(inverseView, inverseProjection);
+
+            //Gribb/Hartmann: the planes are sums/differences of the rows of projection * view
+            for(int i = 0; i < 3; i++){
+                glm::vec4 row(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+                glm::vec4 w(viewProjection[0][3], viewProjection[1][3], viewProjection[2][3], viewProjection[3][3]);
+                planes[i * 2] = w + row;
+                planes[i * 2 + 1] = w - row;
+            }
+            if(reversedZ){
+                //clip depth runs from w (near) down to 0 (infinity), there is no far plane to cull against
+                glm::vec4 row(viewProjection[0][2], viewProjection[1][2], viewProjection[2][2], viewProjection[3][2]);
+                glm::vec4 w(viewProjection[0][3], viewProjection[1][3], viewProjection[2][3], viewProjection[3][3]);
+                planes[4] = w - row;
+                planes[5] = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+            }
+            for(int i = 0; i < 6; i++){
+                float length = glm::length(glm::vec3(planes[i]));
+                if(length > 0.0f)
+                    planes[i] = planes[i] * (1.0f / length);
+            }
+        }
 };
 
 #endif
\ No newline at end of file
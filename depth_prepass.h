@@ -0,0 +1,182 @@
+#ifndef DEPTH_PREPASS_H
+#define DEPTH_PREPASS_H
+
+#include <glad/glad.h>
+
+#include "shader.h"
+
+#include <cstdio>
+#include <string>
+
+// Depth pre-pass: the opaque draws go out twice. First depth only (color writes off, shaders/depth.fs is empty
+// so the gpu runs at its depth only rate), then shaded with depth writes off and the depth test on GL_EQUAL, so
+// the expensive fragment shader runs once per pixel no matter how much the geometry overlaps or in which order
+// it was submitted. Costs a second vertex pass, worth it once overdraw x shading cost outweighs that.
+// Both passes must use the same vertex shader with an invariant gl_Position, anything else can round
+// differently and GL_EQUAL drops the pixel. The opaque pass pairs shaders/depth.fs with the scene's own vertex
+// shader for that (shaders/indirect.vs or shaders/indirectFallback.vs, both declare gl_Position invariant).
+//
+// usage: beginDepth() -> opaque draws with the depth shader -> beginShading() -> opaque draws -> end()
+// with enabled off beginDepth() does nothing and the other two leave the normal depth test in place
+class DepthPrepass {
+    public:
+        bool enabled = true;
+        GLenum depthFunc = GL_LESS; // the normal depth test, GL_GREATER with reversed-Z
+
+        // returns false when the pre-pass is off and there is nothing to draw
+        bool beginDepth(){
+            if(!enabled)
+                return false;
+            glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+            glDepthMask(GL_TRUE);
+            glDepthFunc(depthFunc);
+            return true;
+        }
+
+        void beginShading(){
+            glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+            if(enabled){
+                glDepthMask(GL_FALSE); //already final, writing it again is wasted bandwidth
+                glDepthFunc(GL_EQUAL);
+            }
+        }
+
+        // back to the normal test for the transparent/other passes
+        void end(){
+            glDepthMask(GL_TRUE);
+            glDepthFunc(depthFunc);
+        }
+};
+
+#define OVERDRAW_QUERY_FRAMES 4
+
+// Overdraw statistics, fragments shaded vs pixels visible for the opaque pass.
+// While the shading pass runs every fragment that passes the depth test increments the stencil and is counted
+// by a GL_SAMPLES_PASSED query, then countVisible() draws a fullscreen triangle with stencil != 0 and counts
+// again, which gives the pixels covered at least once. shaded / visible is the average number of times a
+// covered pixel was shaded, 1.0 is perfect (what the pre-pass should get, ties aside).
+// The stencil is only touched while enabled, the results arrive OVERDRAW_QUERY_FRAMES - 1 frames late so
+// reading them never stalls.
+//
+// usage: beginShading() -> opaque draws -> endShading() -> countVisible(), the stencil must be cleared to 0 first
+class OverdrawStats {
+    public:
+        bool enabled = false;
+
+        // last results
+        unsigned long long shaded = 0;
+        unsigned long long visible = 0;
+
+        // after the context is current
+        void init(){
+            glGenQueries(OVERDRAW_QUERY_FRAMES, shadedQueries);
+            glGenQueries(OVERDRAW_QUERY_FRAMES, visibleQueries);
+            glGenVertexArrays(1, &emptyVAO); //core profile wants a vao bound even without attributes
+            for(unsigned int i = 0; i < OVERDRAW_QUERY_FRAMES; i++)
+                pending[i] = false;
+        }
+
+        void release(){
+            if(emptyVAO == 0)
+                return;
+            glDeleteQueries(OVERDRAW_QUERY_FRAMES, shadedQueries);
+            glDeleteQueries(OVERDRAW_QUERY_FRAMES, visibleQueries);
+            glDeleteVertexArrays(1, &emptyVAO);
+            emptyVAO = 0;
+        }
+
+        double overdraw() const{
+            return visible > 0 ? (double)shaded / (double)visible : 0.0;
+        }
+
+        void beginShading(){
+            collect();
+            if(!enabled)
+                return;
+            //the slot we are about to reuse is the oldest, wait for it if the gpu is that far behind
+            if(pending[slot])
+                read(slot);
+            glEnable(GL_STENCIL_TEST);
+            glStencilMask(0xFF);
+            glStencilFunc(GL_ALWAYS, 0, 0xFF);
+            glStencilOp(GL_KEEP, GL_KEEP, GL_INCR); //only fragments that pass the depth test count
+            glBeginQuery(GL_SAMPLES_PASSED, shadedQueries[slot]);
+            active = true;
+        }
+
+        void endShading(){
+            if(!active)
+                return;
+            glEndQuery(GL_SAMPLES_PASSED);
+            glDisable(GL_STENCIL_TEST);
+        }
+
+        // coverShader is shaders/fullscreen.vs with any fragment shader, color writes are off
+        void countVisible(Shader& coverShader){
+            if(!active)
+                return;
+            active = false;
+
+            GLboolean depthTest = glIsEnabled(GL_DEPTH_TEST);
+            glDisable(GL_DEPTH_TEST);
+            glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+            glEnable(GL_STENCIL_TEST);
+            glStencilFunc(GL_NOTEQUAL, 0, 0xFF);
+            glStencilOp(GL_KEEP, GL_KEEP, GL_KEEP);
+
+            glBeginQuery(GL_SAMPLES_PASSED, visibleQueries[slot]);
+            coverShader.use();
+            glBindVertexArray(emptyVAO);
+            glDrawArrays(GL_TRIANGLES, 0, 3);
+            glBindVertexArray(0);
+            glEndQuery(GL_SAMPLES_PASSED);
+
+            glDisable(GL_STENCIL_TEST);
+            glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+            if(depthTest)
+                glEnable(GL_DEPTH_TEST);
+
+            pending[slot] = true;
+            slot = (slot + 1) % OVERDRAW_QUERY_FRAMES;
+        }
+
+        // for the window title
+        std::string summary() const{
+            char text[96];
+            std::snprintf(text, sizeof(text), "shaded %llu / visible %llu (%.2fx)", shaded, visible, overdraw());
+            return text;
+        }
+
+    private:
+        GLuint shadedQueries[OVERDRAW_QUERY_FRAMES];
+        GLuint visibleQueries[OVERDRAW_QUERY_FRAMES];
+        bool pending[OVERDRAW_QUERY_FRAMES];
+        unsigned int slot = 0;
+        bool active = false;
+        GLuint emptyVAO = 0;
+
+        // reads every finished slot, oldest first
+        void collect(){
+            for(unsigned int i = 0; i < OVERDRAW_QUERY_FRAMES; i++){
+                unsigned int s = (slot + i) % OVERDRAW_QUERY_FRAMES;
+                if(!pending[s])
+                    continue;
+                GLuint available = 0;
+                glGetQueryObjectuiv(visibleQueries[s], GL_QUERY_RESULT_AVAILABLE, &available);
+                if(!available)
+                    return;
+                read(s);
+            }
+        }
+
+        void read(unsigned int s){
+            GLuint64 samples = 0;
+            glGetQueryObjectui64v(shadedQueries[s], GL_QUERY_RESULT, &samples);
+            shaded = samples;
+            glGetQueryObjectui64v(visibleQueries[s], GL_QUERY_RESULT, &samples);
+            visible = samples;
+            pending[s] = false;
+        }
+};
+
+#endif
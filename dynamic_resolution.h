@@ -0,0 +1,139 @@
+#ifndef DYNAMIC_RESOLUTION_H
+#define DYNAMIC_RESOLUTION_H
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <string>
+
+#define DYNAMIC_RESOLUTION_QUERY_FRAMES 4
+
+// Dynamic resolution: the scene renders at scale x the window size per axis, scale follows how long the gpu took.
+// Each frame's gpu work sits in a GL_TIME_ELAPSED query, read back DYNAMIC_RESOLUTION_QUERY_FRAMES - 1 frames
+// later without waiting. The gpu time is the feedback, not the frame time, since with vsync the frame time says
+// nothing about how much headroom is left.
+// The cost of the scene goes with the pixel count, so the scale that should hit the budget is
+// scale * sqrt(budget / gpuTime). Over budget it drops there right away; it only grows again one step at a time,
+// and only while the frame stays under 85% of the budget. Scales are quantized to SCALE_STEP, because a new scale
+// reallocates the scene targets, and a change waits for a few frames measured at the current scale.
+// The upscale to the window happens in shaders/upscale.fs, bilinear plus a contrast limited sharpen.
+//
+// usage: init() -> per frame renderSize() for the targets, beginFrame() -> gpu work -> endFrame()
+class DynamicResolution {
+    public:
+        bool enabled = true;
+        double budget = 14.0; // ms of gpu time, a 60Hz frame minus some slack
+        float minScale = 0.5f;
+        float maxScale = 1.0f;
+
+        float scale = 1.0f;    // per axis
+        double gpuTime = 0.0;  // smoothed ms of the frames at the current scale
+
+        void init(){
+            glGenQueries(DYNAMIC_RESOLUTION_QUERY_FRAMES, queries);
+            for(unsigned int i = 0; i < DYNAMIC_RESOLUTION_QUERY_FRAMES; i++)
+                pending[i] = false;
+        }
+
+        void release(){
+            if(!initialized())
+                return;
+            glDeleteQueries(DYNAMIC_RESOLUTION_QUERY_FRAMES, queries);
+            queries[0] = 0;
+        }
+
+        // the size to render at for this frame, at least 1x1
+        void renderSize(int windowWidth, int windowHeight, int& width, int& height) const{
+            float s = enabled ? scale : 1.0f;
+            width = std::max(1, (int)std::lround(windowWidth * s));
+            height = std::max(1, (int)std::lround(windowHeight * s));
+        }
+
+        void beginFrame(){
+            collect();
+            //the slot about to be reused is the oldest, if the gpu is that far behind skip measuring this frame
+            if(!initialized() || pending[slot])
+                return;
+            glBeginQuery(GL_TIME_ELAPSED, queries[slot]);
+            slotScale[slot] = enabled ? scale : 1.0f;
+            active = true;
+        }
+
+        void endFrame(){
+            if(!active)
+                return;
+            glEndQuery(GL_TIME_ELAPSED);
+            active = false;
+            pending[slot] = true;
+            slot = (slot + 1) % DYNAMIC_RESOLUTION_QUERY_FRAMES;
+        }
+
+        // for the window title
+        std::string summary() const{
+            char text[64];
+            std::snprintf(text, sizeof(text), "%d%% res (gpu %.1f ms)", (int)std::lround((enabled ? scale : 1.0f) * 100.0f), gpuTime);
+            return text;
+        }
+
+    private:
+        static constexpr float SCALE_STEP = 0.05f;
+        static constexpr unsigned int SETTLE_FRAMES = 4; // samples at the current scale before it may change again
+
+        GLuint queries[DYNAMIC_RESOLUTION_QUERY_FRAMES] = {0};
+        bool pending[DYNAMIC_RESOLUTION_QUERY_FRAMES];
+        float slotScale[DYNAMIC_RESOLUTION_QUERY_FRAMES];
+        unsigned int slot = 0;
+        bool active = false;
+        unsigned int samples = 0; // since the last scale change
+
+        bool initialized() const{
+            return queries[0] != 0;
+        }
+
+        // reads every finished query, oldest first
+        void collect(){
+            if(!initialized())
+                return;
+            for(unsigned int i = 0; i < DYNAMIC_RESOLUTION_QUERY_FRAMES; i++){
+                unsigned int s = (slot + i) % DYNAMIC_RESOLUTION_QUERY_FRAMES;
+                if(!pending[s])
+                    continue;
+                GLuint available = 0;
+                glGetQueryObjectuiv(queries[s], GL_QUERY_RESULT_AVAILABLE, &available);
+                if(!available)
+                    return;
+                GLuint64 elapsed = 0;
+                glGetQueryObjectui64v(queries[s], GL_QUERY_RESULT, &elapsed);
+                pending[s] = false;
+                //frames still rendered at the old scale say nothing about the new one
+                if(slotScale[s] == (enabled ? scale : 1.0f))
+                    update(elapsed / 1e6);
+            }
+        }
+
+        void update(double milliseconds){
+            gpuTime = samples == 0 ? milliseconds : gpuTime + (milliseconds - gpuTime) * 0.25;
+            samples++;
+            if(!enabled || samples < SETTLE_FRAMES || gpuTime <= 0.0)
+                return;
+
+            float target = scale;
+            if(gpuTime > budget){
+                float fit = scale * (float)std::sqrt(budget / gpuTime);
+                target = std::floor(fit / SCALE_STEP) * SCALE_STEP;
+                if(target >= scale)
+                    target = scale - SCALE_STEP;
+            }else if(gpuTime < budget * 0.85){
+                target = scale + SCALE_STEP;
+            }
+            target = std::min(std::max(std::round(target / SCALE_STEP) * SCALE_STEP, minScale), maxScale);
+            if(std::fabs(target - scale) < SCALE_STEP * 0.5f)
+                return;
+            scale = target;
+            samples = 0;
+        }
+};
+
+#endif
@@ -0,0 +1,335 @@
+#ifndef ECS_H
+#define ECS_H
+
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+// Archetype based entity component system.
+// Every distinct set of component types is an archetype, and its entities live in fixed size chunks that store
+// each component as its own tightly packed array (SoA), so a system that only needs transforms walks one
+// contiguous array per chunk instead of hopping between objects. Chunks are also the unit for splitting work
+// between threads, see World::chunks().
+//
+// Components have to be trivially copyable (they are moved around with memcpy when an entity changes archetype
+// or another entity is removed), plain structs of glm types and ints are.
+
+// chunk size in bytes, 16KB keeps a chunk of a few components inside L1/L2
+#define ECS_CHUNK_SIZE (16 * 1024)
+#define ECS_MAX_COMPONENTS 64
+
+struct Entity {
+    uint32_t index = ~0u;
+    uint32_t generation = 0; // bumped when the index is reused, so stale handles stop resolving
+
+    bool operator==(const Entity& other) const{ return index == other.index && generation == other.generation; }
+    bool operator!=(const Entity& other) const{ return !(*this == other); }
+};
+
+// one bit per component type
+typedef uint64_t ComponentMask;
+
+struct ComponentInfo {
+    size_t size;
+    size_t alignment;
+};
+
+inline std::vector<ComponentInfo>& componentInfos()
+{
+    static std::vector<ComponentInfo> infos;
+    return infos;
+}
+
+inline unsigned int registerComponent(size_t size, size_t alignment)
+{
+    componentInfos().push_back({size, alignment});
+    return (unsigned int)componentInfos().size() - 1;
+}
+
+// ids are handed out the first time a type is used
+template<typename T>
+unsigned int componentId()
+{
+    static_assert(std::is_trivially_copyable<T>::value, "components are moved with memcpy");
+    static const unsigned int id = registerComponent(sizeof(T), alignof(T));
+    return id;
+}
+
+template<typename... Ts>
+ComponentMask componentMask()
+{
+    ComponentMask mask = 0;
+    unsigned int ids[] = {componentId<Ts>()..., 0u};
+    for(unsigned int i = 0; i < sizeof...(Ts); i++)
+        mask |= ComponentMask(1) << ids[i];
+    return mask;
+}
+
+struct Archetype;
+
+struct alignas(64) ChunkData {
+    uint8_t bytes[ECS_CHUNK_SIZE];
+};
+
+struct Chunk {
+    Archetype* archetype;
+    unsigned int count = 0;
+    std::unique_ptr<ChunkData> data = std::unique_ptr<ChunkData>(new ChunkData);
+
+    Entity* entities(){
+        return (Entity*)data->bytes;
+    }
+
+    // the column of component T, nullptr if the archetype doesn't have it
+    template<typename T>
+    T* get();
+};
+
+struct Archetype {
+    ComponentMask mask;
+    std::vector<unsigned int> components; // ids
+    std::vector<size_t> offsets;          // byte offset of each component array inside a chunk
+    int column[ECS_MAX_COMPONENTS];       // component id -> index into components/offsets, -1 if not here
+    unsigned int capacity;                // entities per chunk
+    std::vector<std::unique_ptr<Chunk>> chunks;
+
+    explicit Archetype(ComponentMask componentMask) : mask(componentMask){
+        for(unsigned int i = 0; i < ECS_MAX_COMPONENTS; i++){
+            column[i] = -1;
+            if(mask & (ComponentMask(1) << i)){
+                column[i] = (int)components.size();
+                components.push_back(i);
+            }
+        }
+
+        //the biggest capacity whose arrays (each aligned to its type, at least 16 for simd) fit in a chunk
+        capacity = ECS_CHUNK_SIZE / sizeof(Entity);
+        while(capacity > 1 && !layout(capacity))
+            capacity--;
+        layout(capacity);
+    }
+
+    void* columnData(Chunk& chunk, unsigned int index){
+        return chunk.data->bytes + offsets[index];
+    }
+
+    private:
+        bool layout(unsigned int entities){
+            offsets.clear();
+            size_t offset = entities * sizeof(Entity);
+            for(unsigned int i = 0; i < components.size(); i++){
+                const ComponentInfo& info = componentInfos()[components[i]];
+                size_t alignment = info.alignment > 16 ? info.alignment : 16;
+                offset = (offset + alignment - 1) / alignment * alignment;
+                offsets.push_back(offset);
+                offset += entities * info.size;
+            }
+            return offset <= ECS_CHUNK_SIZE;
+        }
+};
+
+template<typename T>
+T* Chunk::get()
+{
+    int index = archetype->column[componentId<T>()];
+    return index < 0 ? nullptr : (T*)archetype->columnData(*this, index);
+}
+
+class World {
+    public:
+        template<typename... Ts>
+        Entity create(const Ts&... components){
+            Archetype* archetype = findArchetype(componentMask<Ts...>());
+            Entity entity = allocateEntity();
+            place(entity, archetype);
+            int unpack[] = {(set(entity, components), 0)..., 0};
+            (void)unpack;
+            return entity;
+        }
+
+        void destroy(Entity entity){
+            if(!alive(entity))
+                return;
+            Record& record = records[entity.index];
+            removeRow(record.archetype, record.chunk, record.row);
+            record.archetype = nullptr;
+            record.generation++;
+            freeIndices.push_back(entity.index);
+            entityCount--;
+        }
+
+        bool alive(Entity entity) const{
+            return entity.index < records.size() && records[entity.index].generation == entity.generation && records[entity.index].archetype;
+        }
+
+        template<typename T>
+        bool has(Entity entity) const{
+            return alive(entity) && records[entity.index].archetype->column[componentId<T>()] >= 0;
+        }
+
+        // nullptr if the entity is gone or doesn't have a T
+        template<typename T>
+        T* get(Entity entity){
+            if(!alive(entity))
+                return nullptr;
+            const Record& record = records[entity.index];
+            T* column = record.archetype->chunks[record.chunk]->template get<T>();
+            return column ? column + record.row : nullptr;
+        }
+
+        // adds (or overwrites) a component, moves the entity to the matching archetype
+        template<typename T>
+        void add(Entity entity, const T& component){
+            if(!alive(entity))
+                return;
+            if(!has<T>(entity))
+                move(entity, findArchetype(records[entity.index].archetype->mask | componentMask<T>()));
+            set(entity, component);
+        }
+
+        template<typename T>
+        void remove(Entity entity){
+            if(!has<T>(entity))
+                return;
+            move(entity, findArchetype(records[entity.index].archetype->mask & ~componentMask<T>()));
+        }
+
+        // every chunk with at least the components Ts, hand these out to worker threads for parallel systems
+        template<typename... Ts>
+        std::vector<Chunk*> chunks(){
+            ComponentMask mask = componentMask<Ts...>();
+            std::vector<Chunk*> result;
+            for(unsigned int i = 0; i < archetypes.size(); i++){
+                if((archetypes[i]->mask & mask) != mask)
+                    continue;
+                for(unsigned int c = 0; c < archetypes[i]->chunks.size(); c++){
+                    if(archetypes[i]->chunks[c]->count)
+                        result.push_back(archetypes[i]->chunks[c].get());
+                }
+            }
+            return result;
+        }
+
+        // f(count, entities, Ts* arrays...) once per chunk, the arrays are count long
+        template<typename... Ts, typename F>
+        void eachChunk(F f){
+            std::vector<Chunk*> matching = chunks<Ts...>();
+            for(unsigned int i = 0; i < matching.size(); i++)
+                f(matching[i]->count, (const Entity*)matching[i]->entities(), matching[i]->template get<Ts>()...);
+        }
+
+        // f(entity, Ts&...) once per entity
+        template<typename... Ts, typename F>
+        void each(F f){
+            eachChunk<Ts...>([&f](unsigned int count, const Entity* entities, Ts*... arrays){
+                for(unsigned int i = 0; i < count; i++)
+                    f(entities[i], arrays[i]...);
+            });
+        }
+
+        unsigned int size() const{
+            return entityCount;
+        }
+
+        unsigned int archetypeCount() const{
+            return (unsigned int)archetypes.size();
+        }
+
+    private:
+        struct Record {
+            Archetype* archetype = nullptr;
+            unsigned int chunk = 0;
+            unsigned int row = 0;
+            uint32_t generation = 0;
+        };
+
+        std::vector<std::unique_ptr<Archetype>> archetypes;
+        std::map<ComponentMask, Archetype*> archetypeByMask;
+        std::vector<Record> records;
+        std::vector<uint32_t> freeIndices;
+        unsigned int entityCount = 0;
+
+        Archetype* findArchetype(ComponentMask mask){
+            std::map<ComponentMask, Archetype*>::iterator it = archetypeByMask.find(mask);
+            if(it != archetypeByMask.end())
+                return it->second;
+            archetypes.push_back(std::unique_ptr<Archetype>(new Archetype(mask)));
+            archetypeByMask[mask] = archetypes.back().get();
+            return archetypes.back().get();
+        }
+
+        Entity allocateEntity(){
+            Entity entity;
+            if(!freeIndices.empty()){
+                entity.index = freeIndices.back();
+                freeIndices.pop_back();
+            }else{
+                entity.index = (uint32_t)records.size();
+                records.push_back(Record());
+            }
+            entity.generation = records[entity.index].generation;
+            entityCount++;
+            return entity;
+        }
+
+        // appends a row for the entity at the end of the archetype, the components are left uninitialized
+        void place(Entity entity, Archetype* archetype){
+            if(archetype->chunks.empty() || archetype->chunks.back()->count == archetype->capacity){
+                archetype->chunks.push_back(std::unique_ptr<Chunk>(new Chunk()));
+                archetype->chunks.back()->archetype = archetype;
+            }
+            Chunk& chunk = *archetype->chunks.back();
+            Record& record = records[entity.index];
+            record.archetype = archetype;
+            record.chunk = (unsigned int)archetype->chunks.size() - 1;
+            record.row = chunk.count;
+            chunk.entities()[chunk.count++] = entity;
+        }
+
+        template<typename T>
+        void set(Entity entity, const T& component){
+            *get<T>(entity) = component;
+        }
+
+        // fills the hole with the last entity of the archetype so every chunk stays densely packed
+        void removeRow(Archetype* archetype, unsigned int chunkIndex, unsigned int row){
+            Chunk& chunk = *archetype->chunks[chunkIndex];
+            Chunk& last = *archetype->chunks.back();
+            unsigned int lastRow = last.count - 1;
+            if(&chunk != &last || row != lastRow){
+                Entity moved = last.entities()[lastRow];
+                chunk.entities()[row] = moved;
+                for(unsigned int i = 0; i < archetype->components.size(); i++){
+                    size_t size = componentInfos()[archetype->components[i]].size;
+                    std::memcpy((uint8_t*)archetype->columnData(chunk, i) + row * size, (uint8_t*)archetype->columnData(last, i) + lastRow * size, size);
+                }
+                records[moved.index].chunk = chunkIndex;
+                records[moved.index].row = row;
+            }
+            last.count--;
+            if(last.count == 0)
+                archetype->chunks.pop_back();
+        }
+
+        void move(Entity entity, Archetype* destination){
+            Record old = records[entity.index];
+            place(entity, destination);
+            const Record& record = records[entity.index];
+            Chunk& from = *old.archetype->chunks[old.chunk];
+            Chunk& to = *destination->chunks[record.chunk];
+            for(unsigned int i = 0; i < destination->components.size(); i++){
+                int column = old.archetype->column[destination->components[i]];
+                if(column < 0)
+                    continue;
+                size_t size = componentInfos()[destination->components[i]].size;
+                std::memcpy((uint8_t*)destination->columnData(to, i) + record.row * size, (uint8_t*)old.archetype->columnData(from, column) + old.row * size, size);
+            }
+            removeRow(old.archetype, old.chunk, old.row);
+        }
+};
+
+#endif
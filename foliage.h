@@ -0,0 +1,211 @@
+#ifndef FOLIAGE_H
+#define FOLIAGE_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include "occlusion.h"
+#include "shader.h"
+
+#include <cstdint>
+#include <vector>
+
+#define FOLIAGE_GRID 16 // cells per side, the unit of culling
+
+// Cutout vegetation (grass, leaves, fences) as part of the opaque pass. Texels are either there or not, so
+// instead of going through the sorted blending path they are alpha tested (shaders/foliage.fs discards below
+// 0.5) or, when the bound framebuffer is multisampled, turned into a coverage mask with GL_SAMPLE_ALPHA_TO_COVERAGE.
+// Either way they write depth and need no sorting, a field of 100k+ blades is a handful of instanced draws.
+// The texture cooker already rescales the alpha of every mip to keep the coverage of level 0 (CookOptions::
+// alphaCutoff), so blades don't thin out in the distance.
+//
+// Every blade is two crossed quads, an instance is just its base position and scale (16 bytes), the yaw comes
+// from a hash of the position in shaders/foliage.vs. scatter() sorts the instances into a FOLIAGE_GRID x
+// FOLIAGE_GRID grid once, draw() culls the cells against the frustum and the hi-z pyramid and draws each run of
+// neighbouring visible cells with one call.
+//
+// usage: scatter() once, then draw() after the opaque draws with the foliage shader in use, release() at the end
+class FoliageField {
+    public:
+        unsigned int texture = 0;
+
+        // last draw()
+        unsigned int visibleCells = 0;
+        unsigned int visibleInstances = 0;
+
+        // count blades of minScale..maxScale height on the square around center (y is the ground)
+        void scatter(glm::vec3 center, float halfExtent, unsigned int count, float minScale, float maxScale, uint32_t seed = 1){
+            std::vector<glm::vec4> blades(count);
+            std::vector<unsigned int> cellOf(count);
+            std::vector<unsigned int> cellCount(FOLIAGE_GRID * FOLIAGE_GRID, 0);
+            for(unsigned int i = 0; i < count; i++){
+                float x = random(seed) * 2.0f - 1.0f;
+                float z = random(seed) * 2.0f - 1.0f;
+                float scale = minScale + random(seed) * (maxScale - minScale);
+                blades[i] = glm::vec4(center.x + x * halfExtent, center.y, center.z + z * halfExtent, scale);
+                unsigned int cx = glm::min((unsigned int)((x * 0.5f + 0.5f) * FOLIAGE_GRID), (unsigned int)FOLIAGE_GRID - 1);
+                unsigned int cz = glm::min((unsigned int)((z * 0.5f + 0.5f) * FOLIAGE_GRID), (unsigned int)FOLIAGE_GRID - 1);
+                cellOf[i] = cz * FOLIAGE_GRID + cx;
+                cellCount[cellOf[i]]++;
+            }
+
+            //counting sort by cell, every cell is one contiguous range of the instance buffer
+            cells.assign(FOLIAGE_GRID * FOLIAGE_GRID, Cell());
+            unsigned int first = 0;
+            for(unsigned int c = 0; c < cells.size(); c++){
+                cells[c].first = first;
+                first += cellCount[c];
+            }
+            std::vector<glm::vec4> sorted(count);
+            std::vector<unsigned int> next(cells.size());
+            for(unsigned int c = 0; c < cells.size(); c++)
+                next[c] = cells[c].first;
+            for(unsigned int i = 0; i < count; i++){
+                Cell& cell = cells[cellOf[i]];
+                glm::vec4 blade = blades[i];
+                //the crossed quads reach half their scale out from the base, whichever way they are turned
+                glm::vec3 bladeMin(blade.x - 0.5f * blade.w, blade.y, blade.z - 0.5f * blade.w);
+                glm::vec3 bladeMax(blade.x + 0.5f * blade.w, blade.y + blade.w, blade.z + 0.5f * blade.w);
+                if(cell.count == 0){
+                    cell.boxMin = bladeMin;
+                    cell.boxMax = bladeMax;
+                }else{
+                    cell.boxMin = glm::min(cell.boxMin, bladeMin);
+                    cell.boxMax = glm::max(cell.boxMax, bladeMax);
+                }
+                cell.count++;
+                sorted[next[cellOf[i]]++] = blade;
+            }
+            instances = count;
+            upload(sorted);
+        }
+
+        // true when the bound draw framebuffer is multisampled, pick the ALPHA_TO_COVERAGE shader variant then
+        bool alphaToCoverage() const{
+            GLint sampleBuffers = 0;
+            glGetIntegerv(GL_SAMPLE_BUFFERS, &sampleBuffers);
+            return sampleBuffers > 0;
+        }
+
+        // the foliage shader must be in use with view/projection set, hiz may be null or empty
+        void draw(const glm::vec4* frustum, const HiZBuffer* hiz){
+            visibleCells = 0;
+            visibleInstances = 0;
+            if(vao == 0 || instances == 0)
+                return;
+            bool occlusion = hiz && hiz->valid();
+            bool coverage = alphaToCoverage();
+
+            //both sides of a blade are visible, and blending must not touch the cutout
+            glDisable(GL_CULL_FACE);
+            glDisable(GL_BLEND);
+            if(coverage)
+                glEnable(GL_SAMPLE_ALPHA_TO_COVERAGE);
+            glBindTexture(GL_TEXTURE_2D, texture);
+            glBindVertexArray(vao);
+            glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+            //neighbouring visible cells are neighbours in the buffer too, draw them as one run
+            unsigned int runFirst = 0;
+            unsigned int runCount = 0;
+            for(unsigned int c = 0; c < cells.size(); c++){
+                const Cell& cell = cells[c];
+                bool visible = cell.count > 0 && boxInFrustum(frustum, cell.boxMin, cell.boxMax)
+                    && !(occlusion && hiz->isOccluded(cell.boxMin, cell.boxMax));
+                if(visible){
+                    visibleCells++;
+                    visibleInstances += cell.count;
+                    if(runCount == 0)
+                        runFirst = cell.first;
+                    runCount += cell.count;
+                    continue;
+                }
+                drawRun(runFirst, runCount);
+                runCount = 0;
+            }
+            drawRun(runFirst, runCount);
+            glBindVertexArray(0);
+
+            if(coverage)
+                glDisable(GL_SAMPLE_ALPHA_TO_COVERAGE);
+            glEnable(GL_BLEND);
+            glEnable(GL_CULL_FACE);
+        }
+
+        void release(){
+            if(vao == 0)
+                return;
+            glDeleteVertexArrays(1, &vao);
+            glDeleteBuffers(1, &vbo);
+            glDeleteBuffers(1, &instanceVBO);
+            vao = vbo = instanceVBO = 0;
+        }
+
+    private:
+        struct Cell {
+            unsigned int first = 0;
+            unsigned int count = 0;
+            glm::vec3 boxMin = glm::vec3(0.0f);
+            glm::vec3 boxMax = glm::vec3(0.0f);
+        };
+
+        std::vector<Cell> cells;
+        unsigned int instances = 0;
+        unsigned int vao = 0;
+        unsigned int vbo = 0;
+        unsigned int instanceVBO = 0;
+
+        static float random(uint32_t& seed){
+            seed = seed * 1664525u + 1013904223u;
+            return (seed >> 8) / 16777216.0f;
+        }
+
+        void upload(const std::vector<glm::vec4>& sorted){
+            if(vao == 0){
+                //two crossed unit quads standing on the origin, texture coordinates flipped like the windows
+                const float bladeVertices[] = {
+                    // positions           // texture Coords
+                    -0.5f, 1.0f,  0.0f,    0.0f, 0.0f,
+                    -0.5f, 0.0f,  0.0f,    0.0f, 1.0f,
+                     0.5f, 0.0f,  0.0f,    1.0f, 1.0f,
+                    -0.5f, 1.0f,  0.0f,    0.0f, 0.0f,
+                     0.5f, 0.0f,  0.0f,    1.0f, 1.0f,
+                     0.5f, 1.0f,  0.0f,    1.0f, 0.0f,
+
+                     0.0f, 1.0f, -0.5f,    0.0f, 0.0f,
+                     0.0f, 0.0f, -0.5f,    0.0f, 1.0f,
+                     0.0f, 0.0f,  0.5f,    1.0f, 1.0f,
+                     0.0f, 1.0f, -0.5f,    0.0f, 0.0f,
+                     0.0f, 0.0f,  0.5f,    1.0f, 1.0f,
+                     0.0f, 1.0f,  0.5f,    1.0f, 0.0f
+                };
+                glGenVertexArrays(1, &vao);
+                glGenBuffers(1, &vbo);
+                glGenBuffers(1, &instanceVBO);
+                glBindVertexArray(vao);
+                glBindBuffer(GL_ARRAY_BUFFER, vbo);
+                glBufferData(GL_ARRAY_BUFFER, sizeof(bladeVertices), bladeVertices, GL_STATIC_DRAW);
+                glEnableVertexAttribArray(0);
+                glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
+                glEnableVertexAttribArray(1);
+                glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
+                //per instance position + scale, the pointer is set per run in drawRun
+                glEnableVertexAttribArray(2);
+                glVertexAttribDivisor(2, 1);
+                glBindVertexArray(0);
+            }
+            glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+            glBufferData(GL_ARRAY_BUFFER, sorted.size() * sizeof(glm::vec4), sorted.data(), GL_STATIC_DRAW);
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+        }
+
+        //no base instance in 3.3, the attribute pointer starts at the run instead
+        void drawRun(unsigned int first, unsigned int count){
+            if(count == 0)
+                return;
+            glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(glm::vec4), (void*)(first * sizeof(glm::vec4)));
+            glDrawArraysInstanced(GL_TRIANGLES, 0, 12, count);
+        }
+};
+
+#endif
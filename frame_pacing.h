@@ -0,0 +1,212 @@
+#ifndef FRAME_PACING_H
+#define FRAME_PACING_H
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <thread>
+
+// Frame pacing: how far the cpu may run ahead of the gpu, how fast frames are started and what that costs in
+// latency.
+//  - swapInterval: 0 = no vsync, 1 = vsync, -1 = adaptive vsync (tears instead of waiting a whole refresh when a
+//    frame is late, needs EXT_swap_control_tear, falls back to 1)
+//  - targetFps: frame limiter, sleeps most of the wait and spins the last bit since sleep is only good to ~1ms
+//  - maxFramesInFlight: every frame gets a fence after its swap, beginFrame() waits until fewer than this many
+//    are still on the gpu. 1 = lowest latency, more = better throughput when cpu and gpu times vary
+//  - latency: input sampled (inputSampled(), right after glfwPollEvents) to the gpu finishing that frame's swap,
+//    from a GL_TIMESTAMP query mapped onto the cpu clock. Scanout comes on top (up to a refresh with vsync), and
+//    the simulation thread adds its own tick of delay before input shows up in a snapshot.
+//
+// The stream RingBuffer keeps its own fences, so more than RingBuffer::FRAMES in flight never happens anyway.
+//
+// usage per frame: beginFrame() -> glfwPollEvents() -> inputSampled() -> render -> glfwSwapBuffers() -> endFrame()
+
+#define FRAME_PACER_MAX_FRAMES 4
+
+class FramePacer {
+    public:
+        int swapInterval = 1;
+        double targetFps = 0.0; // 0 = no limit
+        unsigned int maxFramesInFlight = 2;
+
+        bool adaptiveSupported = false;
+
+        // statistics in ms, smoothed over roughly the last 16 frames
+        double frameTime = 0.0;
+        double latency = 0.0;
+        double fenceWait = 0.0;   // time beginFrame() blocked on the in flight limit
+        double limiterWait = 0.0; // time beginFrame() slept/spun for targetFps
+        unsigned long long frames = 0;
+
+        // after the context is current and gl is loaded, the swap interval applies to the current context
+        void init(){
+            adaptiveSupported = glfwExtensionSupported("WGL_EXT_swap_control_tear") || glfwExtensionSupported("GLX_EXT_swap_control_tear");
+            glGenQueries(FRAME_PACER_MAX_FRAMES, queries);
+            for(unsigned int i = 0; i < FRAME_PACER_MAX_FRAMES; i++)
+                inFlight[i].fence = 0;
+            setSwapInterval(swapInterval);
+            calibrate();
+            lastFrameStart = nextFrame = Clock::now();
+        }
+
+        void release(){
+            for(unsigned int i = 0; i < FRAME_PACER_MAX_FRAMES; i++){
+                if(inFlight[i].fence)
+                    glDeleteSync(inFlight[i].fence);
+                inFlight[i].fence = 0;
+            }
+            glDeleteQueries(FRAME_PACER_MAX_FRAMES, queries);
+        }
+
+        void setSwapInterval(int interval){
+            swapInterval = interval;
+            glfwSwapInterval(interval < 0 && !adaptiveSupported ? 1 : interval);
+        }
+
+        // off -> vsync -> adaptive (if supported) -> off
+        void cycleSwapInterval(){
+            if(swapInterval == 0)
+                setSwapInterval(1);
+            else if(swapInterval == 1 && adaptiveSupported)
+                setSwapInterval(-1);
+            else
+                setSwapInterval(0);
+        }
+
+        void beginFrame(){
+            Clock::time_point start = Clock::now();
+
+            //results of the frames the gpu already finished, then block until we are under the in flight limit
+            collect(false);
+            unsigned int limit = maxFramesInFlight < 1 ? 1 : (maxFramesInFlight > FRAME_PACER_MAX_FRAMES ? FRAME_PACER_MAX_FRAMES : maxFramesInFlight);
+            while(count >= limit)
+                collect(true);
+            Clock::time_point fenced = Clock::now();
+
+            if(targetFps > 0.0){
+                Clock::duration period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / targetFps));
+                nextFrame += period;
+                //a long frame (loading, breakpoint) shouldn't be followed by a burst of catch up frames
+                if(nextFrame < fenced - period)
+                    nextFrame = fenced;
+                waitUntil(nextFrame);
+            }
+            Clock::time_point now = Clock::now();
+
+            smooth(fenceWait, milliseconds(fenced - start));
+            smooth(limiterWait, milliseconds(now - fenced));
+            if(frames > 0)
+                smooth(frameTime, milliseconds(now - lastFrameStart));
+            lastFrameStart = now;
+            inputTime = now;
+
+            //gpu and cpu clocks drift apart, resync about once a second
+            if(frames % 64 == 0)
+                calibrate();
+        }
+
+        // right after glfwPollEvents, the latency is measured from here
+        void inputSampled(){
+            inputTime = Clock::now();
+        }
+
+        // right after glfwSwapBuffers
+        void endFrame(){
+            Frame& frame = inFlight[(first + count) % FRAME_PACER_MAX_FRAMES];
+            frame.query = queries[(first + count) % FRAME_PACER_MAX_FRAMES];
+            glQueryCounter(frame.query, GL_TIMESTAMP);
+            frame.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            frame.input = inputTime;
+            count++;
+            frames++;
+        }
+
+        // for the window title
+        std::string summary() const{
+            const char* vsync = swapInterval == 0 ? "off" : (swapInterval < 0 && adaptiveSupported ? "adaptive" : "on");
+            char text[160];
+            std::snprintf(text, sizeof(text), "%.0f fps | %.2f ms | latency %.1f ms | vsync %s | %u in flight",
+                frameTime > 0.0 ? 1000.0 / frameTime : 0.0, frameTime, latency, vsync, maxFramesInFlight);
+            std::string result = text;
+            if(targetFps > 0.0)
+                result += " | limit " + std::to_string((int)targetFps);
+            return result;
+        }
+
+    private:
+        typedef std::chrono::steady_clock Clock;
+
+        struct Frame {
+            GLsync fence;
+            GLuint query;
+            Clock::time_point input;
+        };
+
+        GLuint queries[FRAME_PACER_MAX_FRAMES];
+        Frame inFlight[FRAME_PACER_MAX_FRAMES]; // ring, oldest at first
+        unsigned int first = 0;
+        unsigned int count = 0;
+
+        Clock::time_point lastFrameStart;
+        Clock::time_point nextFrame;
+        Clock::time_point inputTime;
+        int64_t gpuToCpu = 0; // ns to add to a GL_TIMESTAMP to get steady_clock time
+
+        static double milliseconds(Clock::duration duration){
+            return std::chrono::duration<double, std::milli>(duration).count();
+        }
+
+        static void smooth(double& average, double sample){
+            average = average == 0.0 ? sample : average + (sample - average) * 0.0625;
+        }
+
+        static void waitUntil(Clock::time_point deadline){
+            while(true){
+                Clock::duration left = deadline - Clock::now();
+                if(left <= Clock::duration::zero())
+                    return;
+                if(left > std::chrono::milliseconds(2))
+                    std::this_thread::sleep_for(left - std::chrono::milliseconds(2));
+                else
+                    std::this_thread::yield();
+            }
+        }
+
+        void calibrate(){
+            GLint64 gpu = 0;
+            glGetInteger64v(GL_TIMESTAMP, &gpu);
+            int64_t cpu = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count();
+            gpuToCpu = cpu - (int64_t)gpu;
+        }
+
+        // retires the oldest frame if the gpu is done with it, or waits for it when block is set
+        void collect(bool block){
+            while(count > 0){
+                Frame& frame = inFlight[first];
+                GLenum result = glClientWaitSync(frame.fence, GL_SYNC_FLUSH_COMMANDS_BIT, block ? 100000000 : 0); //100ms
+                if(result == GL_TIMEOUT_EXPIRED){
+                    if(block)
+                        continue;
+                    return;
+                }
+                glDeleteSync(frame.fence);
+                frame.fence = 0;
+
+                GLuint64 gpuDone = 0;
+                glGetQueryObjectui64v(frame.query, GL_QUERY_RESULT, &gpuDone);
+                int64_t input = std::chrono::duration_cast<std::chrono::nanoseconds>(frame.input.time_since_epoch()).count();
+                smooth(latency, ((int64_t)gpuDone + gpuToCpu - input) / 1e6);
+
+                first = (first + 1) % FRAME_PACER_MAX_FRAMES;
+                count--;
+                if(block)
+                    return;
+            }
+        }
+};
+
+#endif
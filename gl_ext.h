@@ -0,0 +1,156 @@
+#ifndef GL_EXT_H
+#define GL_EXT_H
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <cstring>
+#include <iostream>
+
+// glad was generated for the 3.3 core profile only, so anything newer than that (or any extension)
+// has to be declared and loaded by hand. Call loadGLExtensions() once right after gladLoadGL() and
+// check the matching flag in glExt before using one of the function pointers.
+
+// ARB_buffer_storage (core in 4.4)
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#define GL_MAP_COHERENT_BIT 0x0080
+#define GL_DYNAMIC_STORAGE_BIT 0x0100
+#define GL_CLIENT_STORAGE_BIT 0x0200
+#endif
+typedef void (APIENTRYP PFNGLBUFFERSTORAGEPROC)(GLenum target, GLsizeiptr size, const void *data, GLbitfield flags);
+
+// ARB_draw_indirect / ARB_multi_draw_indirect (core in 4.0 / 4.3)
+#ifndef GL_DRAW_INDIRECT_BUFFER
+#define GL_DRAW_INDIRECT_BUFFER 0x8F3F
+#endif
+typedef void (APIENTRYP PFNGLMULTIDRAWELEMENTSINDIRECTPROC)(GLenum mode, GLenum type, const void *indirect, GLsizei drawcount, GLsizei stride);
+
+// ARB_shader_storage_buffer_object (core in 4.3)
+#ifndef GL_SHADER_STORAGE_BUFFER
+#define GL_SHADER_STORAGE_BUFFER 0x90D2
+#define GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT 0x90DF
+#endif
+
+// ARB_get_program_binary (core in 4.1)
+#ifndef GL_PROGRAM_BINARY_LENGTH
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#endif
+typedef void (APIENTRYP PFNGLGETPROGRAMBINARYPROC)(GLuint program, GLsizei bufSize, GLsizei *length, GLenum *binaryFormat, void *binary);
+typedef void (APIENTRYP PFNGLPROGRAMBINARYPROC)(GLuint program, GLenum binaryFormat, const void *binary, GLsizei length);
+typedef void (APIENTRYP PFNGLPROGRAMPARAMETERIPROC)(GLuint program, GLenum pname, GLint value);
+
+// KHR_parallel_shader_compile / ARB_parallel_shader_compile (same enums)
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_MAX_SHADER_COMPILER_THREADS_KHR 0x91B0
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+typedef void (APIENTRYP PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)(GLuint count);
+
+// ARB_clip_control (core in 4.5), not on macOS
+#ifndef GL_ZERO_TO_ONE
+#define GL_NEGATIVE_ONE_TO_ONE 0x935E
+#define GL_ZERO_TO_ONE 0x935F
+#endif
+typedef void (APIENTRYP PFNGLCLIPCONTROLPROC)(GLenum origin, GLenum depth);
+
+struct GLExtensions {
+    int major = 3;
+    int minor = 3;
+
+    bool bufferStorage = false;
+    PFNGLBUFFERSTORAGEPROC BufferStorage = nullptr;
+
+    bool multiDrawIndirect = false;
+    PFNGLMULTIDRAWELEMENTSINDIRECTPROC MultiDrawElementsIndirect = nullptr;
+
+    bool shaderStorage = false;
+    bool shaderDrawParameters = false; // gl_DrawIDARB in shaders
+
+    bool textureCompressionS3TC = false;     // BC1/BC3
+    bool textureCompressionS3TCsRGB = false; // their sRGB variants
+    bool textureCompressionBPTC = false;     // BC7
+
+    bool programBinary = false; // only set if the driver actually offers a binary format (macOS reports none)
+    PFNGLGETPROGRAMBINARYPROC GetProgramBinary = nullptr;
+    PFNGLPROGRAMBINARYPROC ProgramBinary = nullptr;
+    PFNGLPROGRAMPARAMETERIPROC ProgramParameteri = nullptr;
+
+    bool parallelShaderCompile = false; // GL_COMPLETION_STATUS_KHR can be polled without blocking
+    PFNGLMAXSHADERCOMPILERTHREADSKHRPROC MaxShaderCompilerThreads = nullptr;
+
+    bool clipControl = false; // depth in [0, 1] instead of [-1, 1], needed for reversed-Z to pay off
+    PFNGLCLIPCONTROLPROC ClipControl = nullptr;
+};
+
+inline GLExtensions glExt;
+
+// true if the context is at least major.minor
+inline bool glVersionAtLeast(int major, int minor)
+{
+    return glExt.major > major || (glExt.major == major && glExt.minor >= minor);
+}
+
+// core profile contexts don't have a single GL_EXTENSIONS string anymore, we have to walk them one by one
+inline bool hasGLExtension(const char* name)
+{
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for(GLint i = 0; i < count; i++){
+        const char* ext = (const char*)glGetStringi(GL_EXTENSIONS, i);
+        if(ext && std::strcmp(ext, name) == 0)
+            return true;
+    }
+    return false;
+}
+
+inline void loadGLExtensions()
+{
+    glGetIntegerv(GL_MAJOR_VERSION, &glExt.major);
+    glGetIntegerv(GL_MINOR_VERSION, &glExt.minor);
+
+    if(glVersionAtLeast(4, 4) || hasGLExtension("GL_ARB_buffer_storage")){
+        glExt.BufferStorage = (PFNGLBUFFERSTORAGEPROC)glfwGetProcAddress("glBufferStorage");
+        glExt.bufferStorage = glExt.BufferStorage != nullptr;
+    }
+
+    if(glVersionAtLeast(4, 3) || hasGLExtension("GL_ARB_multi_draw_indirect")){
+        glExt.MultiDrawElementsIndirect = (PFNGLMULTIDRAWELEMENTSINDIRECTPROC)glfwGetProcAddress("glMultiDrawElementsIndirect");
+        glExt.multiDrawIndirect = glExt.MultiDrawElementsIndirect != nullptr;
+    }
+
+    glExt.shaderStorage = glVersionAtLeast(4, 3) || hasGLExtension("GL_ARB_shader_storage_buffer_object");
+    glExt.shaderDrawParameters = hasGLExtension("GL_ARB_shader_draw_parameters");
+
+    glExt.textureCompressionS3TC = hasGLExtension("GL_EXT_texture_compression_s3tc");
+    glExt.textureCompressionS3TCsRGB = glExt.textureCompressionS3TC && (hasGLExtension("GL_EXT_texture_sRGB") || hasGLExtension("GL_EXT_texture_compression_s3tc_srgb"));
+    glExt.textureCompressionBPTC = glVersionAtLeast(4, 2) || hasGLExtension("GL_ARB_texture_compression_bptc");
+
+    if(glVersionAtLeast(4, 1) || hasGLExtension("GL_ARB_get_program_binary")){
+        GLint formats = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+        glExt.GetProgramBinary = (PFNGLGETPROGRAMBINARYPROC)glfwGetProcAddress("glGetProgramBinary");
+        glExt.ProgramBinary = (PFNGLPROGRAMBINARYPROC)glfwGetProcAddress("glProgramBinary");
+        glExt.ProgramParameteri = (PFNGLPROGRAMPARAMETERIPROC)glfwGetProcAddress("glProgramParameteri");
+        glExt.programBinary = formats > 0 && glExt.GetProgramBinary && glExt.ProgramBinary && glExt.ProgramParameteri;
+    }
+
+    if(hasGLExtension("GL_KHR_parallel_shader_compile"))
+        glExt.MaxShaderCompilerThreads = (PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)glfwGetProcAddress("glMaxShaderCompilerThreadsKHR");
+    else if(hasGLExtension("GL_ARB_parallel_shader_compile"))
+        glExt.MaxShaderCompilerThreads = (PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)glfwGetProcAddress("glMaxShaderCompilerThreadsARB");
+    glExt.parallelShaderCompile = glExt.MaxShaderCompilerThreads != nullptr;
+    if(glExt.parallelShaderCompile)
+        glExt.MaxShaderCompilerThreads(0xFFFFFFFF); //let the driver pick how many
+
+    if(glVersionAtLeast(4, 5) || hasGLExtension("GL_ARB_clip_control")){
+        glExt.ClipControl = (PFNGLCLIPCONTROLPROC)glfwGetProcAddress("glClipControl");
+        glExt.clipControl = glExt.ClipControl != nullptr;
+    }
+
+    std::cout << "GL " << glExt.major << "." << glExt.minor << " (" << glGetString(GL_RENDERER) << ")" << std::endl;
+}
+
+#endif
@@ -0,0 +1,110 @@
+#ifndef GL_WORKER_H
+#define GL_WORKER_H
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+// A thread with its own hidden GL context that shares objects (programs, buffers, textures) with the main one,
+// for GL work that would otherwise stall the render loop. Jobs run one after the other in submit order, and every
+// job is finished (glFinish) before its future becomes ready so the main context can use what it created.
+// Containers (VAOs, framebuffers) are not shared between contexts, don't create those here.
+class GLWorkerThread {
+    public:
+        // main thread only (glfw creates windows there), call after the main context is current
+        bool start(GLFWwindow* shareWith){
+            if(worker.joinable())
+                return true;
+
+            //the hidden context has to match the main one or sharing fails on some platforms
+            glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, glfwGetWindowAttrib(shareWith, GLFW_CONTEXT_VERSION_MAJOR));
+            glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, glfwGetWindowAttrib(shareWith, GLFW_CONTEXT_VERSION_MINOR));
+            glfwWindowHint(GLFW_OPENGL_PROFILE, glfwGetWindowAttrib(shareWith, GLFW_OPENGL_PROFILE));
+            glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, glfwGetWindowAttrib(shareWith, GLFW_OPENGL_FORWARD_COMPAT));
+            glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+            context = glfwCreateWindow(1, 1, "gl worker", NULL, shareWith);
+            glfwDefaultWindowHints();
+            if(context == NULL){
+                std::cout << "ERROR::GL_WORKER::CONTEXT_CREATION_FAILED" << std::endl;
+                return false;
+            }
+
+            quit = false;
+            worker = std::thread([this](){ run(); });
+            return true;
+        }
+
+        // finishes the queued jobs, main thread only, before glfwTerminate
+        void stop(){
+            if(!worker.joinable())
+                return;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                quit = true;
+            }
+            wake.notify_one();
+            worker.join();
+            glfwDestroyWindow(context);
+            context = NULL;
+        }
+
+        bool running() const{
+            return worker.joinable();
+        }
+
+        // runs job() on the worker, the result comes back through the future
+        template<typename Job>
+        auto submit(Job job) -> std::future<decltype(job())>{
+            typedef decltype(job()) Result;
+            //the destructor runs after job() returned but before the task stores the result and wakes the waiting side
+            struct FinishGL {
+                ~FinishGL(){ glFinish(); }
+            };
+            std::shared_ptr<std::packaged_task<Result()>> task = std::make_shared<std::packaged_task<Result()>>([job](){
+                FinishGL finish;
+                return job();
+            });
+            std::future<Result> result = task->get_future();
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                jobs.push_back([task](){ (*task)(); });
+            }
+            wake.notify_one();
+            return result;
+        }
+
+    private:
+        GLFWwindow* context = NULL;
+        std::thread worker;
+        std::mutex mutex;
+        std::condition_variable wake;
+        std::deque<std::function<void()>> jobs;
+        bool quit = false;
+
+        void run(){
+            glfwMakeContextCurrent(context);
+            while(true){
+                std::function<void()> job;
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    wake.wait(lock, [this](){ return quit || !jobs.empty(); });
+                    if(jobs.empty())
+                        break;
+                    job = jobs.front();
+                    jobs.pop_front();
+                }
+                job();
+            }
+            glfwMakeContextCurrent(NULL);
+        }
+};
+
+#endif
@@ -0,0 +1,237 @@
+#ifndef INDIRECT_H
+#define INDIRECT_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include "gl_ext.h"
+#include "ring_buffer.h"
+#include "shader.h"
+#include "mesh.h"
+
+#include <algorithm>
+#include <functional>
+#include <vector>
+
+// layout is fixed by the spec, this is what glMultiDrawElementsIndirect reads from GL_DRAW_INDIRECT_BUFFER
+struct DrawElementsIndirectCommand {
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLint baseVertex;
+    GLuint baseInstance;
+};
+
+// per draw data the shader fetches with gl_DrawID, matches the std430 DrawData struct in shaders/indirect.vs
+struct DrawData {
+    glm::mat4 model;
+    GLuint materialIndex;
+    GLuint pad[3];
+};
+
+// where a mesh lives inside the pool
+struct PoolMesh {
+    GLuint indexCount;
+    GLuint firstIndex;
+    GLint baseVertex;
+
+    // object space bounds, used for culling before anything is added to a DrawList
+    glm::vec3 boundsMin;
+    glm::vec3 boundsMax;
+};
+
+// All geometry in one VAO/VBO/EBO so a single multi draw call can reach any mesh.
+// Meshes are appended on the cpu with add() and uploaded in one go with upload().
+class MeshPool {
+    public:
+        unsigned int VAO = 0;
+        std::vector<PoolMesh> meshes;
+
+        // returns the handle used by DrawList::add
+        unsigned int add(const std::vector<Vertex>& meshVertices, const std::vector<unsigned int>& meshIndices){
+            PoolMesh mesh;
+            mesh.indexCount = (GLuint)meshIndices.size();
+            mesh.firstIndex = (GLuint)indices.size();
+            mesh.baseVertex = (GLint)vertices.size();
+            mesh.boundsMin = glm::vec3(1e30f);
+            mesh.boundsMax = glm::vec3(-1e30f);
+            for(unsigned int i = 0; i < meshVertices.size(); i++){
+                mesh.boundsMin = glm::min(mesh.boundsMin, meshVertices[i].Position);
+                mesh.boundsMax = glm::max(mesh.boundsMax, meshVertices[i].Position);
+            }
+
+            vertices.insert(vertices.end(), meshVertices.begin(), meshVertices.end());
+            indices.insert(indices.end(), meshIndices.begin(), meshIndices.end()); //stay local, baseVertex offsets them
+            meshes.push_back(mesh);
+            return (unsigned int)meshes.size() - 1;
+        }
+
+        // same vertex layout as Mesh::setupMesh so the same shaders work on both
+        void upload(){
+            if(VAO == 0){
+                glGenVertexArrays(1, &VAO);
+                glGenBuffers(1, &VBO);
+                glGenBuffers(1, &EBO);
+            }
+
+            glBindVertexArray(VAO);
+            glBindBuffer(GL_ARRAY_BUFFER, VBO);
+            glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), vertices.data(), GL_STATIC_DRAW);
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+
+            glEnableVertexAttribArray(0);
+            glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
+            glEnableVertexAttribArray(1);
+            glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
+            glEnableVertexAttribArray(2);
+            glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
+            glBindVertexArray(0);
+        }
+
+        void release(){
+            if(VAO == 0)
+                return;
+            glDeleteVertexArrays(1, &VAO);
+            glDeleteBuffers(1, &VBO);
+            glDeleteBuffers(1, &EBO);
+            VAO = 0;
+        }
+
+    private:
+        unsigned int VBO = 0, EBO = 0;
+        std::vector<Vertex> vertices;
+        std::vector<unsigned int> indices;
+};
+
+// Collects the visible draws of a frame (fill it after culling) and submits them.
+// With GL 4.3 + ARB_shader_draw_parameters the whole list is one glMultiDrawElementsIndirect (one per
+// material run if the caller still binds textures per material), the commands and per draw data are streamed through the RingBuffer and
+// the shader picks its DrawData with gl_DrawIDARB. On 3.3 it falls back to a glDrawElementsBaseVertex loop
+// with the same data set as uniforms.
+class DrawList {
+    public:
+        // binds whatever textures a material index needs, not needed when materials come from a MaterialTable
+        typedef std::function<void(unsigned int material)> MaterialBinder;
+
+        bool useIndirect;
+
+        // statistics of the last submit()
+        unsigned int drawCount = 0;
+        unsigned int submitCount = 0; // api draw calls actually issued
+
+        DrawList(){
+            useIndirect = supported();
+            ssboAlignment = 16;
+            if(useIndirect){
+                GLint alignment = 0;
+                glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &alignment);
+                if(alignment > ssboAlignment)
+                    ssboAlignment = alignment;
+            }
+        }
+
+        static bool supported(){
+            return glExt.multiDrawIndirect && glExt.shaderStorage && glExt.shaderDrawParameters;
+        }
+
+        void clear(){
+            draws.clear();
+        }
+
+        void add(unsigned int mesh, const glm::mat4& model, unsigned int material){
+            draws.push_back({mesh, material, model});
+        }
+
+        // shader must be shaders/indirect.vs when useIndirect is set, shaders/indirectFallback.vs otherwise
+        void submit(MeshPool& pool, Shader& shader, RingBuffer& ring, MaterialBinder bindMaterial = nullptr){
+            drawCount = (unsigned int)draws.size();
+            submitCount = 0;
+            if(draws.empty())
+                return;
+
+            //group by material so each material is bound once
+            if(bindMaterial){
+                std::stable_sort(draws.begin(), draws.end(), [](const Draw& a, const Draw& b){
+                    return a.material < b.material;
+                });
+            }
+
+            shader.use();
+            glBindVertexArray(pool.VAO);
+            if(useIndirect)
+                submitIndirect(pool, shader, ring, bindMaterial);
+            else
+                submitLoop(pool, shader, bindMaterial);
+            glBindVertexArray(0);
+        }
+
+    private:
+        struct Draw {
+            unsigned int mesh;
+            unsigned int material;
+            glm::mat4 model;
+        };
+
+        std::vector<Draw> draws;
+        GLint ssboAlignment;
+
+        void submitIndirect(MeshPool& pool, Shader& shader, RingBuffer& ring, MaterialBinder& bindMaterial){
+            RingAllocation commandAlloc = ring.allocate(draws.size() * sizeof(DrawElementsIndirectCommand), 16);
+            RingAllocation dataAlloc = ring.allocate(draws.size() * sizeof(DrawData), ssboAlignment);
+            if(!commandAlloc.ptr || !dataAlloc.ptr)
+                return; //ring is too small for this many draws, it already reported it
+
+            DrawElementsIndirectCommand* commands = (DrawElementsIndirectCommand*)commandAlloc.ptr;
+            DrawData* data = (DrawData*)dataAlloc.ptr;
+            for(unsigned int i = 0; i < draws.size(); i++){
+                const PoolMesh& mesh = pool.meshes[draws[i].mesh];
+                commands[i] = {mesh.indexCount, 1, mesh.firstIndex, mesh.baseVertex, 0};
+                data[i].model = draws[i].model;
+                data[i].materialIndex = draws[i].material;
+            }
+            ring.flush();
+
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandAlloc.buffer);
+            glBindBufferRange(GL_SHADER_STORAGE_BUFFER, 0, dataAlloc.buffer, dataAlloc.offset, dataAlloc.size);
+
+            unsigned int start = 0;
+            while(start < draws.size()){
+                unsigned int end = start + 1;
+                if(bindMaterial){
+                    while(end < draws.size() && draws[end].material == draws[start].material)
+                        end++;
+                    bindMaterial(draws[start].material);
+                }else{
+                    end = (unsigned int)draws.size(); //the shader looks the material up itself, everything goes in one call
+                }
+
+                //gl_DrawID restarts at 0 for every multi draw, so the shader needs to know where this run starts
+                shader.setInt("drawBase", (int)start);
+                glExt.MultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT,
+                    (void*)(commandAlloc.offset + start * sizeof(DrawElementsIndirectCommand)), end - start, 0);
+                submitCount++;
+                start = end;
+            }
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+        }
+
+        void submitLoop(MeshPool& pool, Shader& shader, MaterialBinder& bindMaterial){
+            unsigned int boundMaterial = ~0u;
+            for(unsigned int i = 0; i < draws.size(); i++){
+                if(bindMaterial && draws[i].material != boundMaterial){
+                    bindMaterial(draws[i].material);
+                    boundMaterial = draws[i].material;
+                }
+                const PoolMesh& mesh = pool.meshes[draws[i].mesh];
+                shader.setMat4("model", draws[i].model);
+                shader.setInt("materialIndex", (int)draws[i].material);
+                glDrawElementsBaseVertex(GL_TRIANGLES, mesh.indexCount, GL_UNSIGNED_INT,
+                    (void*)(mesh.firstIndex * sizeof(unsigned int)), mesh.baseVertex);
+                submitCount++;
+            }
+        }
+};
+
+#endif
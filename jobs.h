@@ -0,0 +1,335 @@
+#ifndef JOBS_H
+#define JOBS_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Work stealing job system.
+// Every thread (the main thread is thread 0, the workers come after it) owns a Chase-Lev deque: it pushes and
+// pops its own jobs at the bottom (LIFO, still hot in cache) while idle threads steal from the top of the others
+// (FIFO, the biggest pieces of work). Jobs can have children, a job only counts as finished once all of its
+// children are, so wait() on a root job waits for the whole tree. wait() runs other jobs instead of blocking.
+//
+// usage:
+//   jobSystem.start();                                   // once, from the main thread
+//   jobSystem.parallelFor(count, 64, [&](unsigned int begin, unsigned int end){ ... });
+//   Job* job = jobSystem.create([&](){ ... }); jobSystem.run(job); ... jobSystem.wait(job);
+//
+// Only the main thread and the workers can create/run/wait on jobs. Jobs come out of a per thread ring of
+// JOB_POOL_SIZE slots that skips the ones still running, so creating a job never takes a lock or allocates.
+
+#define JOB_POOL_SIZE 4096 // per thread, power of two
+#define JOB_DATA_SIZE 48   // bytes of lambda capture a job can hold
+
+struct Job {
+    void (*function)(Job*);
+    Job* parent;
+    std::atomic<int> unfinished{0}; // itself + unfinished children, 0 = the slot is free
+    alignas(16) unsigned char data[JOB_DATA_SIZE];
+};
+
+// the Chase-Lev deque with the C11 memory orderings of Le et al. 2013, fixed size
+class JobDeque {
+    public:
+        JobDeque() : jobs(new std::atomic<Job*>[JOB_POOL_SIZE]) {}
+
+        // owner only
+        void push(Job* job){
+            int64_t b = bottom.load(std::memory_order_relaxed);
+            jobs[b & (JOB_POOL_SIZE - 1)].store(job, std::memory_order_relaxed);
+            bottom.store(b + 1, std::memory_order_release); //publishes the job to thieves
+        }
+
+        // owner only
+        Job* pop(){
+            int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+            bottom.store(b, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            int64_t t = top.load(std::memory_order_relaxed);
+            if(t > b){
+                bottom.store(b + 1, std::memory_order_relaxed);
+                return nullptr; //empty
+            }
+            Job* job = jobs[b & (JOB_POOL_SIZE - 1)].load(std::memory_order_relaxed);
+            if(t == b){
+                //last one, race the thieves for it
+                if(!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                    job = nullptr;
+                bottom.store(b + 1, std::memory_order_relaxed);
+            }
+            return job;
+        }
+
+        // any thread
+        Job* steal(){
+            int64_t t = top.load(std::memory_order_acquire);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            int64_t b = bottom.load(std::memory_order_acquire);
+            if(t >= b)
+                return nullptr;
+            Job* job = jobs[t & (JOB_POOL_SIZE - 1)].load(std::memory_order_relaxed);
+            if(!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                return nullptr; //somebody else got it
+            return job;
+        }
+
+    private:
+        //top and bottom on their own cache lines, thieves hammer top while the owner works on bottom
+        alignas(64) std::atomic<int64_t> top{0};
+        alignas(64) std::atomic<int64_t> bottom{0};
+        std::unique_ptr<std::atomic<Job*>[]> jobs;
+};
+
+// index of the calling thread inside the job system, ~0u for threads that aren't part of it
+inline thread_local unsigned int jobThreadIndex = ~0u;
+
+class JobSystem {
+    public:
+        // statistics since start()
+        std::atomic<unsigned int> stolen{0};
+
+        // workers = 0 runs everything on the main thread, the default leaves one core for the main thread
+        void start(unsigned int workers = defaultWorkerCount()){
+            if(running)
+                return;
+            running = true;
+            quit = false;
+            stolen = 0;
+            threads.clear();
+            for(unsigned int i = 0; i <= workers; i++)
+                threads.push_back(std::unique_ptr<ThreadData>(new ThreadData()));
+            jobThreadIndex = 0;
+            for(unsigned int i = 1; i <= workers; i++)
+                threads[i]->thread = std::thread([this, i](){ workerLoop(i); });
+        }
+
+        void stop(){
+            if(!running)
+                return;
+            quit = true;
+            wake.notify_all();
+            for(unsigned int i = 1; i < threads.size(); i++)
+                threads[i]->thread.join();
+            threads.clear();
+            jobThreadIndex = ~0u;
+            running = false;
+        }
+
+        // main thread + workers
+        unsigned int threadCount() const{
+            return running ? (unsigned int)threads.size() : 1;
+        }
+
+        static unsigned int defaultWorkerCount(){
+            unsigned int cores = std::thread::hardware_concurrency();
+            return cores > 1 ? cores - 1 : 0;
+        }
+
+        // f() is copied into the job, it has to fit in JOB_DATA_SIZE (capture by reference or pointers)
+        template<typename F>
+        Job* create(const F& f){
+            return createChild(nullptr, f);
+        }
+
+        // the parent doesn't finish before this job did
+        template<typename F>
+        Job* createChild(Job* parent, const F& f){
+            static_assert(sizeof(F) <= JOB_DATA_SIZE, "job capture too big, capture by reference");
+            static_assert(std::is_trivially_destructible<F>::value, "job captures are never destroyed");
+            Job* job = allocate();
+            job->function = [](Job* self){ (*(F*)self->data)(); };
+            job->parent = parent;
+            job->unfinished.store(1, std::memory_order_relaxed);
+            new (job->data) F(f);
+            if(parent)
+                parent->unfinished.fetch_add(1, std::memory_order_relaxed);
+            return job;
+        }
+
+        void run(Job* job){
+            if(!running){
+                execute(job); //no workers, run it right away
+                return;
+            }
+            threads[jobThreadIndex]->deque.push(job);
+            if(sleeping.load(std::memory_order_relaxed) > 0)
+                wake.notify_one();
+        }
+
+        // runs other jobs until job and all of its children are done
+        void wait(const Job* job){
+            while(job->unfinished.load(std::memory_order_acquire) > 0){
+                Job* next = running ? findJob(jobThreadIndex) : nullptr;
+                if(next)
+                    execute(next);
+                else
+                    std::this_thread::yield();
+            }
+        }
+
+        // blocks until future is ready. A job thread keeps running jobs meanwhile, what the future waits for may
+        // sit in its own deque and nobody else might ever take it from there
+        template<typename T>
+        void waitFor(const std::future<T>& future){
+            if(!onJobThread()){
+                future.wait();
+                return;
+            }
+            while(future.wait_for(std::chrono::seconds(0)) != std::future_status::ready){
+                Job* next = findJob(jobThreadIndex);
+                if(next)
+                    execute(next);
+                else
+                    std::this_thread::yield();
+            }
+        }
+
+        // true on the main thread and the workers while the system runs
+        bool onJobThread() const{
+            return running && jobThreadIndex != ~0u;
+        }
+
+        // f(begin, end) over [0, count) in batches of at least batchSize, returns when everything ran.
+        // The range is split in halves recursively so thieves always take the biggest remaining piece.
+        // Safe from any thread: outside of the job system (or before start()) it's just f(0, count).
+        template<typename F>
+        void parallelFor(unsigned int count, unsigned int batchSize, const F& f){
+            if(count == 0)
+                return;
+            if(!onJobThread()){
+                f(0, count);
+                return;
+            }
+            if(batchSize == 0)
+                batchSize = 1;
+            Job* root = createRange(nullptr, &f, 0, count, batchSize);
+            run(root);
+            wait(root);
+        }
+
+    private:
+        struct ThreadData {
+            JobDeque deque;
+            std::unique_ptr<Job[]> pool = std::unique_ptr<Job[]>(new Job[JOB_POOL_SIZE]);
+            unsigned int allocated = 0;
+            std::thread thread;
+        };
+
+        std::vector<std::unique_ptr<ThreadData>> threads;
+        std::atomic<bool> quit{false};
+        bool running = false;
+
+        std::mutex sleepMutex;
+        std::condition_variable wake;
+        std::atomic<int> sleeping{0};
+
+        // main thread only when nothing runs, so a single fallback pool is enough
+        std::unique_ptr<Job[]> inlinePool = std::unique_ptr<Job[]>(new Job[JOB_POOL_SIZE]);
+        unsigned int inlineAllocated = 0;
+
+        // next free slot of the calling thread's ring, normally the very next one
+        Job* allocate(){
+            Job* pool = running ? threads[jobThreadIndex]->pool.get() : inlinePool.get();
+            unsigned int& allocated = running ? threads[jobThreadIndex]->allocated : inlineAllocated;
+            for(unsigned int tries = 1; ; tries++){
+                Job* job = &pool[allocated++ & (JOB_POOL_SIZE - 1)];
+                if(job->unfinished.load(std::memory_order_acquire) == 0)
+                    return job;
+                //a whole lap of running jobs, help finishing some
+                if(tries % JOB_POOL_SIZE == 0 && running){
+                    Job* other = findJob(jobThreadIndex);
+                    if(other)
+                        execute(other);
+                }
+            }
+        }
+
+        template<typename F>
+        struct Range {
+            const F* f;
+            unsigned int begin;
+            unsigned int end;
+            unsigned int batchSize;
+            JobSystem* system;
+            Job* self;
+
+            void operator()() const{
+                if(end - begin <= batchSize){
+                    (*f)(begin, end);
+                    return;
+                }
+                unsigned int middle = begin + (end - begin) / 2;
+                system->run(system->createRange(self, f, begin, middle, batchSize));
+                system->run(system->createRange(self, f, middle, end, batchSize));
+            }
+        };
+
+        template<typename F>
+        Job* createRange(Job* parent, const F* f, unsigned int begin, unsigned int end, unsigned int batchSize){
+            Job* job = createChild(parent, Range<F>{f, begin, end, batchSize, this, nullptr});
+            ((Range<F>*)job->data)->self = job;
+            return job;
+        }
+
+        void execute(Job* job){
+            job->function(job);
+            finish(job);
+        }
+
+        void finish(Job* job){
+            //once unfinished hits 0 the slot can be handed out again, parent has to be read before that
+            Job* parent = job->parent;
+            if(job->unfinished.fetch_sub(1, std::memory_order_acq_rel) == 1 && parent)
+                finish(parent);
+        }
+
+        Job* findJob(unsigned int index){
+            Job* job = threads[index]->deque.pop();
+            if(job)
+                return job;
+            //start with a different victim on every thread so they don't all hit the same deque
+            unsigned int count = (unsigned int)threads.size();
+            for(unsigned int i = 1; i < count; i++){
+                job = threads[(index + i) % count]->deque.steal();
+                if(job){
+                    stolen.fetch_add(1, std::memory_order_relaxed);
+                    return job;
+                }
+            }
+            return nullptr;
+        }
+
+        void workerLoop(unsigned int index){
+            jobThreadIndex = index;
+            unsigned int idle = 0;
+            while(!quit.load(std::memory_order_relaxed)){
+                Job* job = findJob(index);
+                if(job){
+                    execute(job);
+                    idle = 0;
+                }else if(++idle < 64){
+                    std::this_thread::yield();
+                }else{
+                    //nothing to do for a while, sleep until run() pushes something (or 1ms, pushes can race the check)
+                    std::unique_lock<std::mutex> lock(sleepMutex);
+                    sleeping.fetch_add(1);
+                    wake.wait_for(lock, std::chrono::milliseconds(1));
+                    sleeping.fetch_sub(1);
+                    idle = 0;
+                }
+            }
+        }
+};
+
+inline JobSystem jobSystem;
+
+#endif
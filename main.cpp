@@ -11,28 +11,94 @@
 #include <glm/ext.hpp>
 
 #include "stb_image.h"
+#include "gl_ext.h"
+#include "ring_buffer.h"
 #include "shader.h"
+#include "shader_reload.h"
 #include "camera.h"
 #include "model.h"
+#include "indirect.h"
+#include "material.h"
+#include "texture_cooker.h"
+#include "ecs.h"
+#include "scene.h"
+#include "simulation.h"
+#include "frame_pacing.h"
+#include "render_target.h"
+#include "depth_prepass.h"
+#include "occlusion.h"
+#include "software_occlusion.h"
+#include "oit.h"
+#include "foliage.h"
+#include "outline.h"
+#include "render_graph.h"
+#include "dynamic_resolution.h"
+#include "shadows.h"
 
 using namespace std;
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void mouse_callback(GLFWwindow* window, double xpos, double ypos);
 void processInput(GLFWwindow *window);
-unsigned int loadTexture(char const * path);
+unsigned int uploadTexture(const CookedTexture& texture);
+vector<Vertex> toVertices(const float* data, unsigned int floatCount);
+vector<glm::vec3> toPositions(const float* data, unsigned int floatCount);
+vector<unsigned int> sequentialIndices(unsigned int count);
 
 // settings
 const unsigned int SCR_WIDTH = 800;
 const unsigned int SCR_HEIGHT = 600;
+int framebufferWidth = SCR_WIDTH; //kept up to date by framebuffer_size_callback
+int framebufferHeight = SCR_HEIGHT;
 
 //Camera
 //these vectors represent the axis of the camera, and they are represented in world coordinates
 glm::vec3 V = glm::vec3(0.0f, 1.0f, 0.0f); //Up
 glm::vec3 N = glm::vec3(0.0f, 0.0f, 1.0f); //direction (Not such a great name since it points opposite to the side the camera is facing)
-Camera camera(glm::vec3(0.0f, 0.0f, 3.0f), V, N);
+//the camera itself lives on the simulation thread, input goes through simulation.setInput/addMouseMovement
+Simulation simulation(Camera(glm::vec3(0.0f, 0.0f, 3.0f), V, N));
 bool flashLightPress = false;
-bool flashLightOn = true;
+
+//Frame pacing, V cycles the swap interval, 1/2/3 set the frames in flight
+FramePacer framePacer;
+bool vsyncPress = false;
+
+//Opaque pass, P toggles the depth pre-pass, O the overdraw statistics in the title
+DepthPrepass depthPrepass;
+OverdrawStats overdrawStats;
+bool prepassPress = false;
+bool overdrawPress = false;
+
+//Culling, C cycles the occlusion culling: occluder meshes rasterized on the cpu -> depth of the previous frames
+//read back from the gpu -> off (frustum culling is always on)
+enum OcclusionMode { OCCLUSION_CPU, OCCLUSION_GPU, OCCLUSION_OFF };
+OcclusionMode occlusionMode = OCCLUSION_CPU;
+bool occlusionPress = false;
+
+//Transparency, T switches between sorted alpha blending and weighted blended order independent transparency
+enum TransparencyMode { TRANSPARENCY_SORTED, TRANSPARENCY_OIT };
+TransparencyMode transparencyMode = TRANSPARENCY_SORTED;
+bool transparencyPress = false;
+
+//Selection, L outlines the next selectable object (0 = nothing selected)
+unsigned int selection = 0;
+bool selectionPress = false;
+
+//Post, B toggles bloom, X toggles fxaa, G prints the compiled render graph
+bool bloomEnabled = true;
+bool bloomPress = false;
+bool fxaaEnabled = true;
+bool fxaaPress = false;
+bool graphDumpRequested = false;
+bool graphDumpPress = false;
+
+//Dynamic resolution, R toggles it. The scene renders below the window resolution when the gpu runs over budget
+DynamicResolution dynamicResolution;
+bool dynamicResolutionPress = false;
+
+//Shadows, H toggles the cascaded shadow maps of the directional light
+CascadedShadowMaps shadowMaps;
+bool shadowsPress = false;
 
 //Perspective
 float FOV = 45.0f;
@@ -42,12 +108,9 @@ float lastX = SCR_WIDTH / 2.0f;
 float lastY = SCR_HEIGHT / 2.0f;
 bool firstMouse = true;
 
-// timing
-float deltaTime = 0.0f;	// time between current frame and last frame
-float lastFrame = 0.0f; 
-
 // lighting
 glm::vec3 lightPos(1.2f, 1.0f, 2.0f);
+glm::vec3 sunDirection(-0.2f, -1.0f, -0.3f); //the directional light, the shadow maps follow it
 
 int main()
 {
@@ -77,9 +140,48 @@ int main()
     
     //Load GLAD to configure for OpenGL
     gladLoadGL();
+    loadGLExtensions();
+    //without KHR_parallel_shader_compile the driver compiles on the calling thread, so give it one of its own
+    if(!glExt.parallelShaderCompile)
+        shaderCompileThread.start(window);
+
+    //vsync with two frames in flight, 1 frame in flight trades some throughput for a frame less of latency
+    framePacer.swapInterval = 1;
+    framePacer.maxFramesInFlight = 2;
+    framePacer.targetFps = 0.0;
+    framePacer.init();
+    double lastTitleUpdate = 0.0;
+
+    //the scene is drawn offscreen so we pick the depth format, the window's own depth buffer goes unused
+    glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+    RenderTarget sceneTarget;
+    sceneTarget.create(framebufferWidth, framebufferHeight);
+    WeightedOIT oit;
+    oit.create(framebufferWidth, framebufferHeight, sceneTarget.depthStencil);
+    SelectionOutline selectionOutline;
+    selectionOutline.create(framebufferWidth, framebufferHeight, sceneTarget.depthStencil);
 
     //the z value is stored for each fragment and if the fragment wasnt to output its color, its z value must be above the current one
     glEnable(GL_DEPTH_TEST);  
+    //reversed-Z: depth 1 at the near plane going to 0 at infinity, stored as a 32 bit float. Needs the clip space
+    //depth range to be [0, 1] (GL 4.5 / ARB_clip_control, not on macOS), without it keep the standard projection
+    bool reversedZ = glExt.clipControl;
+    if(reversedZ){
+        glExt.ClipControl(GL_LOWER_LEFT, GL_ZERO_TO_ONE);
+        glDepthFunc(GL_GREATER);
+        glClearDepth(0.0);
+    }
+    depthPrepass.depthFunc = reversedZ ? GL_GREATER : GL_LESS;
+    shadowMaps.sceneDepthFunc = depthPrepass.depthFunc;
+    shadowMaps.zeroToOneDepth = reversedZ;
+    shadowMaps.create();
+    overdrawStats.init();
+    dynamicResolution.init();
+    HiZReadback hizReadback;
+    hizReadback.init();
+    HiZBuffer hiz;
+    SoftwareOcclusion softwareOcclusion;
+    CullStats cullStats;
     glEnable(GL_CULL_FACE);  //remove clockwise winded triangles from the camera view from being rendered
     glCullFace(GL_BACK);
     glFrontFace(GL_CW);  
@@ -88,64 +190,103 @@ int main()
     glEnable(GL_BLEND);
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);  
 
+    //one worker per core for the frame's cpu work (transforms, culling, asset cooking), the main thread helps out
+    jobSystem.start();
+
+    //decoding, mip generation and block compression run as jobs while the shaders compile
+    MaterialTable materialTable;
+    materialTable.prefetch("textures/marble.jpg");
+    materialTable.prefetch("textures/metal.png");
+    std::future<CookedTexture> windowCook = cookTextureAsync("textures/window.png", runtimeCookOptions());
+    std::future<CookedTexture> grassCook = cookTextureAsync("textures/grass.png", runtimeCookOptions());
+
     //build and compile shaders
-    Shader shader("shaders/blending.vs", "shaders/blending.fs");
+    //the opaque pass pulls its per draw data from an ssbo with gl_DrawID when multi draw indirect is available
+    //all of them compile in the background while the textures and meshes load, the first use() waits for the rest
+    //every flashlight/shadow variant is started now so pressing F or H never has to wait for a compile
+    const char* sceneVertexShader = DrawList::supported() ? "shaders/indirect.vs" : "shaders/indirectFallback.vs";
+    ShaderVariants sceneShaders(sceneVertexShader, "shaders/scene.fs");
+    sceneShaders.prepare({ShaderDefines(), {"FLASHLIGHT"}, {"SHADOWS"}, {"FLASHLIGHT", "SHADOWS"}});
+    //the pre-pass has to share the scene's vertex shader, see depth_prepass.h, the shadow maps use it too
+    ShaderVariants depthShaders(sceneVertexShader, "shaders/depth.fs");
+    depthShaders.prepare({ShaderDefines()});
+    Shader coverShader("shaders/fullscreen.vs", "shaders/shaderSingleColor.fs");
+    Shader hizShader("shaders/fullscreen.vs", "shaders/hiz.fs");
+    Shader instancedShader("shaders/blendingInstanced.vs", "shaders/blending.fs");
+    Shader oitShader("shaders/blendingInstanced.vs", "shaders/oit.fs");
+    Shader oitCompositeShader("shaders/fullscreen.vs", "shaders/oitComposite.fs");
+    //cutout foliage, alpha tested unless the scene target is ever multisampled, see foliage.h
+    ShaderVariants foliageShaders("shaders/foliage.vs", "shaders/foliage.fs");
+    foliageShaders.prepare({ShaderDefines()});
+    //selection outline: stencil mask of the selected meshes, then a jump flood in screen space, see outline.h
+    Shader outlineMaskShader("shaders/shaderSingleColor.vs", "shaders/shaderSingleColor.fs");
+    Shader outlineSeedShader("shaders/fullscreen.vs", "shaders/outlineSeed.fs");
+    Shader jumpFloodShader("shaders/fullscreen.vs", "shaders/jumpFlood.fs");
+    Shader outlineShader("shaders/fullscreen.vs", "shaders/outline.fs");
+    //post passes
+    Shader bloomBrightShader("shaders/fullscreen.vs", "shaders/bloomBright.fs");
+    Shader blurShader("shaders/fullscreen.vs", "shaders/blur.fs");
+    ShaderVariants tonemapShaders("shaders/fullscreen.vs", "shaders/tonemap.fs");
+    tonemapShaders.prepare({ShaderDefines(), {"BLOOM"}});
+    Shader fxaaShader("shaders/fullscreen.vs", "shaders/fxaa.fs");
+    Shader upscaleShader("shaders/fullscreen.vs", "shaders/upscale.fs");
 
 // set up vertex data (and buffer(s)) and configure vertex attributes
     // ------------------------------------------------------------------
     float cubeVertices[] = {
+        // positions          // normals           // texture Coords
         // Back face
-        -0.5f, -0.5f, -0.5f,  0.0f, 0.0f, // Bottom-left
-        0.5f,  0.5f, -0.5f,  1.0f, 1.0f, // top-right
-        0.5f, -0.5f, -0.5f,  1.0f, 0.0f, // bottom-right         
-        0.5f,  0.5f, -0.5f,  1.0f, 1.0f, // top-right
-        -0.5f, -0.5f, -0.5f,  0.0f, 0.0f, // bottom-left
-        -0.5f,  0.5f, -0.5f,  0.0f, 1.0f, // top-left
+        -0.5f, -0.5f, -0.5f,   0.0f,  0.0f, -1.0f,   0.0f,  0.0f, // Bottom-left
+         0.5f,  0.5f, -0.5f,   0.0f,  0.0f, -1.0f,   1.0f,  1.0f, // top-right
+         0.5f, -0.5f, -0.5f,   0.0f,  0.0f, -1.0f,   1.0f,  0.0f, // bottom-right
+         0.5f,  0.5f, -0.5f,   0.0f,  0.0f, -1.0f,   1.0f,  1.0f, // top-right
+        -0.5f, -0.5f, -0.5f,   0.0f,  0.0f, -1.0f,   0.0f,  0.0f, // bottom-left
+        -0.5f,  0.5f, -0.5f,   0.0f,  0.0f, -1.0f,   0.0f,  1.0f, // top-left
         // Front face
-        -0.5f, -0.5f,  0.5f,  0.0f, 0.0f, // bottom-left
-        0.5f, -0.5f,  0.5f,  1.0f, 0.0f, // bottom-right
-        0.5f,  0.5f,  0.5f,  1.0f, 1.0f, // top-right
-        0.5f,  0.5f,  0.5f,  1.0f, 1.0f, // top-right
-        -0.5f,  0.5f,  0.5f,  0.0f, 1.0f, // top-left
-        -0.5f, -0.5f,  0.5f,  0.0f, 0.0f, // bottom-left
+        -0.5f, -0.5f,  0.5f,   0.0f,  0.0f,  1.0f,   0.0f,  0.0f, // bottom-left
+         0.5f, -0.5f,  0.5f,   0.0f,  0.0f,  1.0f,   1.0f,  0.0f, // bottom-right
+         0.5f,  0.5f,  0.5f,   0.0f,  0.0f,  1.0f,   1.0f,  1.0f, // top-right
+         0.5f,  0.5f,  0.5f,   0.0f,  0.0f,  1.0f,   1.0f,  1.0f, // top-right
+        -0.5f,  0.5f,  0.5f,   0.0f,  0.0f,  1.0f,   0.0f,  1.0f, // top-left
+        -0.5f, -0.5f,  0.5f,   0.0f,  0.0f,  1.0f,   0.0f,  0.0f, // bottom-left
         // Left face
-        -0.5f,  0.5f,  0.5f,  1.0f, 0.0f, // top-right
-        -0.5f,  0.5f, -0.5f,  1.0f, 1.0f, // top-left
-        -0.5f, -0.5f, -0.5f,  0.0f, 1.0f, // bottom-left
-        -0.5f, -0.5f, -0.5f,  0.0f, 1.0f, // bottom-left
-        -0.5f, -0.5f,  0.5f,  0.0f, 0.0f, // bottom-right
-        -0.5f,  0.5f,  0.5f,  1.0f, 0.0f, // top-right
+        -0.5f,  0.5f,  0.5f,  -1.0f,  0.0f,  0.0f,   1.0f,  0.0f, // top-right
+        -0.5f,  0.5f, -0.5f,  -1.0f,  0.0f,  0.0f,   1.0f,  1.0f, // top-left
+        -0.5f, -0.5f, -0.5f,  -1.0f,  0.0f,  0.0f,   0.0f,  1.0f, // bottom-left
+        -0.5f, -0.5f, -0.5f,  -1.0f,  0.0f,  0.0f,   0.0f,  1.0f, // bottom-left
+        -0.5f, -0.5f,  0.5f,  -1.0f,  0.0f,  0.0f,   0.0f,  0.0f, // bottom-right
+        -0.5f,  0.5f,  0.5f,  -1.0f,  0.0f,  0.0f,   1.0f,  0.0f, // top-right
         // Right face
-        0.5f,  0.5f,  0.5f,  1.0f, 0.0f, // top-left
-        0.5f, -0.5f, -0.5f,  0.0f, 1.0f, // bottom-right
-        0.5f,  0.5f, -0.5f,  1.0f, 1.0f, // top-right         
-        0.5f, -0.5f, -0.5f,  0.0f, 1.0f, // bottom-right
-        0.5f,  0.5f,  0.5f,  1.0f, 0.0f, // top-left
-        0.5f, -0.5f,  0.5f,  0.0f, 0.0f, // bottom-left     
+         0.5f,  0.5f,  0.5f,   1.0f,  0.0f,  0.0f,   1.0f,  0.0f, // top-left
+         0.5f, -0.5f, -0.5f,   1.0f,  0.0f,  0.0f,   0.0f,  1.0f, // bottom-right
+         0.5f,  0.5f, -0.5f,   1.0f,  0.0f,  0.0f,   1.0f,  1.0f, // top-right
+         0.5f, -0.5f, -0.5f,   1.0f,  0.0f,  0.0f,   0.0f,  1.0f, // bottom-right
+         0.5f,  0.5f,  0.5f,   1.0f,  0.0f,  0.0f,   1.0f,  0.0f, // top-left
+         0.5f, -0.5f,  0.5f,   1.0f,  0.0f,  0.0f,   0.0f,  0.0f, // bottom-left
         // Bottom face
-        -0.5f, -0.5f, -0.5f,  0.0f, 1.0f, // top-right
-        0.5f, -0.5f, -0.5f,  1.0f, 1.0f, // top-left
-        0.5f, -0.5f,  0.5f,  1.0f, 0.0f, // bottom-left
-        0.5f, -0.5f,  0.5f,  1.0f, 0.0f, // bottom-left
-        -0.5f, -0.5f,  0.5f,  0.0f, 0.0f, // bottom-right
-        -0.5f, -0.5f, -0.5f,  0.0f, 1.0f, // top-right
+        -0.5f, -0.5f, -0.5f,   0.0f, -1.0f,  0.0f,   0.0f,  1.0f, // top-right
+         0.5f, -0.5f, -0.5f,   0.0f, -1.0f,  0.0f,   1.0f,  1.0f, // top-left
+         0.5f, -0.5f,  0.5f,   0.0f, -1.0f,  0.0f,   1.0f,  0.0f, // bottom-left
+         0.5f, -0.5f,  0.5f,   0.0f, -1.0f,  0.0f,   1.0f,  0.0f, // bottom-left
+        -0.5f, -0.5f,  0.5f,   0.0f, -1.0f,  0.0f,   0.0f,  0.0f, // bottom-right
+        -0.5f, -0.5f, -0.5f,   0.0f, -1.0f,  0.0f,   0.0f,  1.0f, // top-right
         // Top face
-        -0.5f,  0.5f, -0.5f,  0.0f, 1.0f, // top-left
-        0.5f,  0.5f,  0.5f,  1.0f, 0.0f, // bottom-right
-        0.5f,  0.5f, -0.5f,  1.0f, 1.0f, // top-right     
-        0.5f,  0.5f,  0.5f,  1.0f, 0.0f, // bottom-right
-        -0.5f,  0.5f, -0.5f,  0.0f, 1.0f, // top-left
-        -0.5f,  0.5f,  0.5f,  0.0f, 0.0f  // bottom-left        
+        -0.5f,  0.5f, -0.5f,   0.0f,  1.0f,  0.0f,   0.0f,  1.0f, // top-left
+         0.5f,  0.5f,  0.5f,   0.0f,  1.0f,  0.0f,   1.0f,  0.0f, // bottom-right
+         0.5f,  0.5f, -0.5f,   0.0f,  1.0f,  0.0f,   1.0f,  1.0f, // top-right
+         0.5f,  0.5f,  0.5f,   0.0f,  1.0f,  0.0f,   1.0f,  0.0f, // bottom-right
+        -0.5f,  0.5f, -0.5f,   0.0f,  1.0f,  0.0f,   0.0f,  1.0f, // top-left
+        -0.5f,  0.5f,  0.5f,   0.0f,  1.0f,  0.0f,   0.0f,  0.0f // bottom-left
     };
     float planeVertices[] = {
-        // positions          // texture Coords (note we set these higher than 1 (together with GL_REPEAT as texture wrapping mode). this will cause the floor texture to repeat)
-         5.0f, -0.5f,  5.0f,  2.0f, 0.0f,
-        -5.0f, -0.5f,  5.0f,  0.0f, 0.0f,
-        -5.0f, -0.5f, -5.0f,  0.0f, 2.0f,
-
-         5.0f, -0.5f,  5.0f,  2.0f, 0.0f,
-        -5.0f, -0.5f, -5.0f,  0.0f, 2.0f,
-         5.0f, -0.5f, -5.0f,  2.0f, 2.0f								
+        // positions          // normals          // texture Coords (note we set these higher than 1 (together with GL_REPEAT as texture wrapping mode). this will cause the floor texture to repeat)
+         5.0f, -0.5f,  5.0f,   0.0f,  1.0f,  0.0f,   2.0f,  0.0f,
+        -5.0f, -0.5f,  5.0f,   0.0f,  1.0f,  0.0f,   0.0f,  0.0f,
+        -5.0f, -0.5f, -5.0f,   0.0f,  1.0f,  0.0f,   0.0f,  2.0f,
+
+         5.0f, -0.5f,  5.0f,   0.0f,  1.0f,  0.0f,   2.0f,  0.0f,
+        -5.0f, -0.5f, -5.0f,   0.0f,  1.0f,  0.0f,   0.0f,  2.0f,
+         5.0f, -0.5f, -5.0f,   0.0f,  1.0f,  0.0f,   2.0f,  2.0f
     };
     float transparentVertices[] = {
         // positions         // texture Coords (swapped y coordinates because texture is flipped upside down)
@@ -158,31 +299,14 @@ int main()
         1.0f,  0.5f,  0.0f,  1.0f,  0.0f
     };
 
-    // cube VAO
-    unsigned int cubeVAO, cubeVBO;
-    glGenVertexArrays(1, &cubeVAO);
-    glGenBuffers(1, &cubeVBO);
-    glBindVertexArray(cubeVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, cubeVBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(cubeVertices), &cubeVertices, GL_STATIC_DRAW);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
-    glBindVertexArray(0);
-
-    // plane VAO
-    unsigned int planeVAO, planeVBO;
-    glGenVertexArrays(1, &planeVAO);
-    glGenBuffers(1, &planeVBO);
-    glBindVertexArray(planeVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, planeVBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(planeVertices), &planeVertices, GL_STATIC_DRAW);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
-    glBindVertexArray(0);
+    //the opaque geometry shares one buffer so the whole opaque pass can go out as multi draws
+    MeshPool scenePool;
+    unsigned int cubeMesh = scenePool.add(toVertices(cubeVertices, sizeof(cubeVertices) / sizeof(float)), sequentialIndices(36));
+    unsigned int planeMesh = scenePool.add(toVertices(planeVertices, sizeof(planeVertices) / sizeof(float)), sequentialIndices(6));
+    scenePool.upload();
+    //the same shapes as occluders for the cpu rasterizer, real scenes would use a few simplified meshes here
+    unsigned int cubeOccluder = softwareOcclusion.addMesh(toPositions(cubeVertices, sizeof(cubeVertices) / sizeof(float)), sequentialIndices(36));
+    unsigned int planeOccluder = softwareOcclusion.addMesh(toPositions(planeVertices, sizeof(planeVertices) / sizeof(float)), sequentialIndices(6));
 
     //window VAO
     unsigned int windowVAO, windowVBO;
@@ -195,106 +319,464 @@ int main()
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
     glEnableVertexAttribArray(1);
     glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
+    //per instance model matrix, a mat4 attribute takes 4 vec4 slots
+    //the pointers themselves are set every frame since the matrices live in the stream buffer
+    for(unsigned int i = 0; i < 4; i++){
+        glEnableVertexAttribArray(2 + i);
+        glVertexAttribDivisor(2 + i, 1);
+    }
     glBindVertexArray(0);
 
+    //per frame data (instance transforms etc) is streamed through here instead of a GL_STATIC_DRAW buffer
+    RingBuffer streamBuffer(64 * 1024);
+
     // load textures
     // -------------
-    unsigned int cubeTexture  = loadTexture("textures/marble.jpg");
-    unsigned int floorTexture = loadTexture("textures/metal.png");
-    //unsigned int grassTexture = loadTexture("textures/grass.png");
-    unsigned int windowTexture = loadTexture("textures/window.png");
-
-    vector<glm::vec3> windows;
-    windows.push_back(glm::vec3(-1.5f,  0.0f, -0.48f));
-    windows.push_back(glm::vec3( 1.5f,  0.0f,  0.51f));
-    windows.push_back(glm::vec3( 0.0f,  0.0f,  0.7f));
-    windows.push_back(glm::vec3(-0.3f,  0.0f, -2.3f));
-    windows.push_back(glm::vec3( 0.5f,  0.0f, -0.6f)); 
-
-    map<float, glm::vec3> sorted;
-    for (unsigned int i = 0; i < windows.size(); i++)
-    {
-        float distance = glm::length(camera.camPos - windows[i]);
-        sorted[distance] = windows[i];
-    } 
+    //textures of the opaque pass are packed into texture arrays, a draw only needs its material index
+    const unsigned int CUBE_MATERIAL = materialTable.addMaterial(materialTable.addTexture("textures/marble.jpg"));
+    const unsigned int FLOOR_MATERIAL = materialTable.addMaterial(materialTable.addTexture("textures/metal.png"));
+    materialTable.build();
+    jobSystem.waitFor(windowCook);
+    unsigned int windowTexture = uploadTexture(windowCook.get());
+    //grass on the floor, drawn unsorted with the opaque pass
+    FoliageField foliage;
+    jobSystem.waitFor(grassCook);
+    foliage.texture = uploadTexture(grassCook.get());
+    foliage.scatter(glm::vec3(0.0f, -0.5f, 0.0f), 5.0f, 100000, 0.1f, 0.3f);
+
+    // scene
+    // -----
+    World world;
+    // floor and cubes
+    world.create(makeTransform(glm::vec3(0.0f)), WorldTransform(), MeshRenderer{planeMesh, FLOOR_MATERIAL}, Occluder{planeOccluder});
+    world.create(makeTransform(glm::vec3(-1.0f, 0.0f, -1.0f)), WorldTransform(), MeshRenderer{cubeMesh, CUBE_MATERIAL}, Occluder{cubeOccluder}, Selectable{false});
+    world.create(makeTransform(glm::vec3( 2.0f, 0.0f,  0.0f)), WorldTransform(), MeshRenderer{cubeMesh, CUBE_MATERIAL}, Occluder{cubeOccluder}, Selectable{false});
+    // point lights
+    world.create(makeTransform(glm::vec3( 0.7f,  0.2f,  2.0f)), WorldTransform(), makePointLight(glm::vec3(0.8f)));
+    world.create(makeTransform(glm::vec3( 2.3f, -3.3f, -4.0f)), WorldTransform(), makePointLight(glm::vec3(0.8f)));
+    world.create(makeTransform(glm::vec3(-4.0f,  2.0f, -12.0f)), WorldTransform(), makePointLight(glm::vec3(0.8f)));
+    world.create(makeTransform(glm::vec3( 0.0f,  0.0f, -3.0f)), WorldTransform(), makePointLight(glm::vec3(0.8f)));
+    // windows
+    world.create(makeTransform(glm::vec3(-1.5f,  0.0f, -0.48f)), WorldTransform(), Transparent{windowTexture});
+    world.create(makeTransform(glm::vec3( 1.5f,  0.0f,  0.51f)), WorldTransform(), Transparent{windowTexture});
+    world.create(makeTransform(glm::vec3( 0.0f,  0.0f,  0.7f)), WorldTransform(), Transparent{windowTexture});
+    world.create(makeTransform(glm::vec3(-0.3f,  0.0f, -2.3f)), WorldTransform(), Transparent{windowTexture});
+    world.create(makeTransform(glm::vec3( 0.5f,  0.0f, -0.6f)), WorldTransform(), Transparent{windowTexture});
+
+    DrawList opaqueDraws;
+    vector<TransparentDraw> transparentDraws;
 
     // shader configuration
     // --------------------
-    shader.use();
-    shader.setInt("texture1", 0);
+    //save any file in shaders/ while the program runs and the programs using it are rebuilt
+    ShaderReloader shaderReloader;
+    shaderReloader.start();
+    std::function<void(Shader&)> setupSceneShader = [&materialTable](Shader& shader){
+        materialTable.setupShader(shader);
+        shadowMaps.setupShader(shader);
+    };
+    sceneShaders.onBuild = [&](Shader& shader){
+        setupSceneShader(shader);
+        shaderReloader.watch(shader, setupSceneShader);
+    };
+    std::function<void(Shader&)> setupInstancedShader = [](Shader& shader){
+        shader.use();
+        shader.setInt("texture1", 0);
+    };
+    setupInstancedShader(instancedShader);
+    shaderReloader.watch(instancedShader, setupInstancedShader);
+    setupInstancedShader(oitShader);
+    shaderReloader.watch(oitShader, setupInstancedShader);
+    std::function<void(Shader&)> setupOITCompositeShader = [](Shader& shader){
+        shader.use();
+        shader.setInt("accumulation", 0);
+        shader.setInt("weights", 1);
+    };
+    setupOITCompositeShader(oitCompositeShader);
+    shaderReloader.watch(oitCompositeShader, setupOITCompositeShader);
+    depthShaders.onBuild = [&](Shader& shader){
+        shaderReloader.watch(shader);
+    };
+    foliageShaders.onBuild = [&](Shader& shader){
+        setupInstancedShader(shader);
+        shaderReloader.watch(shader, setupInstancedShader);
+    };
+    shaderReloader.watch(coverShader);
+    std::function<void(Shader&)> setupHiZShader = [](Shader& shader){
+        shader.use();
+        shader.setInt("depthTexture", 0);
+    };
+    setupHiZShader(hizShader);
+    shaderReloader.watch(hizShader, setupHiZShader);
+    std::function<void(Shader&)> setupSeedsShader = [](Shader& shader){
+        shader.use();
+        shader.setInt("seeds", 0);
+    };
+    setupSeedsShader(jumpFloodShader);
+    shaderReloader.watch(jumpFloodShader, setupSeedsShader);
+    setupSeedsShader(outlineShader);
+    shaderReloader.watch(outlineShader, setupSeedsShader);
+    shaderReloader.watch(outlineMaskShader);
+    shaderReloader.watch(outlineSeedShader);
+    std::function<void(Shader&)> setupSourceShader = [](Shader& shader){
+        shader.use();
+        shader.setInt("source", 0);
+    };
+    setupSourceShader(bloomBrightShader);
+    shaderReloader.watch(bloomBrightShader, setupSourceShader);
+    setupSourceShader(blurShader);
+    shaderReloader.watch(blurShader, setupSourceShader);
+    setupSourceShader(fxaaShader);
+    shaderReloader.watch(fxaaShader, setupSourceShader);
+    setupSourceShader(upscaleShader);
+    shaderReloader.watch(upscaleShader, setupSourceShader);
+    std::function<void(Shader&)> setupTonemapShader = [](Shader& shader){
+        shader.use();
+        shader.setInt("scene", 0);
+        shader.setInt("bloom", 1);
+    };
+    tonemapShaders.onBuild = [&](Shader& shader){
+        setupTonemapShader(shader);
+        shaderReloader.watch(shader, setupTonemapShader);
+    };
+
+    //fullscreen passes draw one triangle without attributes, see shaders/fullscreen.vs
+    unsigned int fullscreenVAO;
+    glGenVertexArrays(1, &fullscreenVAO);
+    auto drawFullscreen = [fullscreenVAO](){
+        glDisable(GL_DEPTH_TEST);
+        glDisable(GL_BLEND);
+        glBindVertexArray(fullscreenVAO);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+        glBindVertexArray(0);
+        glEnable(GL_BLEND);
+        glEnable(GL_DEPTH_TEST);
+    };
+    RenderGraph frameGraph;
+
+    //from here on the scene's Transforms belong to the simulation thread, it ticks at a fixed rate while we render
+    //the render side copy of the camera, keeps its matrices cached until the simulation moves it
+    Camera camera = simulation.camera;
+    camera.setReversedZ(reversedZ);
+    simulation.fov = FOV;
+    simulation.start(world);
 
     // render loop
     // -----------
     while(!glfwWindowShouldClose(window))
     {
-        // per-frame time logic
-        // --------------------
-        float currentFrame = static_cast<float>(glfwGetTime());
-        deltaTime = currentFrame - lastFrame;
-        lastFrame = currentFrame;
+        //cap the frames in flight / frame rate, then sample input as late as possible
+        framePacer.beginFrame();
+        glfwPollEvents();
+        framePacer.inputSampled();
 
         // input
         // -----
         processInput(window);
 
+        //swap in shaders that were edited and finished compiling, never waits for a compile
+        shaderReloader.update();
+
+        //wait for the gpu to release the stream buffer region we are about to write
+        streamBuffer.beginFrame();
+
         // render
         // ------
-        glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        //everything up to the upscale runs at the dynamic resolution, the targets only change in whole scale steps
+        int renderWidth, renderHeight;
+        dynamicResolution.renderSize(framebufferWidth, framebufferHeight, renderWidth, renderHeight);
+        sceneTarget.resize(renderWidth, renderHeight);
+        oit.resize(renderWidth, renderHeight);
+        selectionOutline.resize(renderWidth, renderHeight);
+
+        //blend the two newest simulation ticks, everything below draws from this and never touches the simulation's state
+        simulation.interpolate(world);
+        simulation.interpolateCamera(camera);
+        bool flashLightOn = simulation.flashLight();
 
-        //must set shaders in this order
-        shader.use();
-        glm::mat4 model = glm::mat4(1.0f);
         glm::mat4 view = camera.worldToCamMatrix();
-        glm::mat4 projection = camera.camToProjMatrix(FOV, (float) SCR_WIDTH, (float) SCR_HEIGHT, 0.1f, 100.0f);
-        shader.setMat4("view", view);
-        shader.setMat4("projection", projection);
-
-        // floor
-        glBindVertexArray(planeVAO);
-        glBindTexture(GL_TEXTURE_2D, floorTexture);
-        shader.setMat4("model", glm::mat4(1.0f));
-        glDrawArrays(GL_TRIANGLES, 0, 6);//we can still draw since stencil buffer is set to 0
-        glBindVertexArray(0);
+        glm::mat4 projection = camera.camToProjMatrix(FOV, (float) framebufferWidth, (float) framebufferHeight, 0.1f, 100.0f);
+        //flashlight is compiled in or out instead of checking a uniform bool for every fragment
+        ShaderDefines sceneDefines;
+        if(flashLightOn)
+            sceneDefines.push_back("FLASHLIGHT");
+        if(shadowMaps.enabled)
+            sceneDefines.push_back("SHADOWS");
+        Shader& sceneShader = sceneShaders.get(sceneDefines);
+        sceneShader.use();
+        sceneShader.setMat4("view", view);
+        sceneShader.setMat4("projection", projection);
+        sceneShader.setVec3("viewPos", camera.camPos);
+
+        // directional light
+        sceneShader.setVec3("dirLight.direction", sunDirection);
+        sceneShader.setVec3("dirLight.ambient", 0.05f, 0.05f, 0.05f);
+        sceneShader.setVec3("dirLight.diffuse", 0.4f, 0.4f, 0.4f);
+        sceneShader.setVec3("dirLight.specular", 0.5f, 0.5f, 0.5f);
+        // point lights, NR_POINT_LIGHTS in the shader
+        setPointLights(world, sceneShader, 4);
+        // spotLight
+        if(flashLightOn){
+            sceneShader.setVec3("flashLight.position", camera.camPos);
+            sceneShader.setVec3("flashLight.direction", -camera.direction);
+            sceneShader.setVec3("flashLight.ambient", 0.0f, 0.0f, 0.0f);
+            sceneShader.setVec3("flashLight.diffuse", 1.0f, 1.0f, 1.0f);
+            sceneShader.setVec3("flashLight.specular", 1.0f, 1.0f, 1.0f);
+            sceneShader.setFloat("flashLight.constant", 1.0f);
+            sceneShader.setFloat("flashLight.linear", 0.09f);
+            sceneShader.setFloat("flashLight.quadratic", 0.032f);
+            sceneShader.setFloat("flashLight.cutOff", glm::cos(glm::radians(12.5f)));
+            sceneShader.setFloat("flashLight.outerCutOff", glm::cos(glm::radians(15.0f)));
+        }
 
-        // cubes
-        glBindVertexArray(cubeVAO);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, cubeTexture); 	
-        model = glm::translate(model, glm::vec3(-1.0f, 0.0f, -1.0f));
-        shader.setMat4("model", model);
-        glDrawArrays(GL_TRIANGLES, 0, 36);
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(2.0f, 0.0f, 0.0f));
-        shader.setMat4("model", model);
-        glDrawArrays(GL_TRIANGLES, 0, 36);
-
-        //draw window
-        glBindVertexArray(windowVAO);
-        glBindTexture(GL_TEXTURE_2D, windowTexture);
-
-        //draw in reverse order (farthest to nearest)  
-        for(std::map<float,glm::vec3>::reverse_iterator it = sorted.rbegin(); it != sorted.rend(); ++it) 
-        {
-            model = glm::mat4(1.0f);
-            model = glm::translate(model, it->second);				
-            shader.setMat4("model", model);
-            glDrawArrays(GL_TRIANGLES, 0, 6);
-        }  
-
-
-        // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
-        // -------------------------------------------------------------------------------
+        bool oitPass = transparencyMode == TRANSPARENCY_OIT;
+        unsigned int selectable = 0;
+        world.each<Selectable>([&](Entity, Selectable& object){
+            object.selected = ++selectable == selection;
+        });
+        if(selection > selectable)
+            selection = 0;
+
+        //the frame is a render graph rebuilt every frame, passes that are switched off aren't declared or get culled
+        //because nothing reads what they write, see render_graph.h. G prints the compiled graph
+        frameGraph.reset();
+        RenderGraph::Handle sceneColor = frameGraph.importTexture("sceneColor", sceneTarget.color, sceneTarget.width, sceneTarget.height, GL_RGBA16F);
+        RenderGraph::Handle sceneDepth = frameGraph.importTexture("sceneDepth", sceneTarget.depthStencil, sceneTarget.width, sceneTarget.height, GL_DEPTH32F_STENCIL8);
+        RenderGraph::Handle backbuffer = frameGraph.importBackbuffer("backbuffer", framebufferWidth, framebufferHeight);
+        RenderGraph::Handle shadowMap = frameGraph.importExternal("shadowMap", shadowMaps.texture, shadowMaps.size, shadowMaps.size, GL_DEPTH_COMPONENT32F);
+
+        //the near cascades every frame, the far ones only when they went out of date, see shadows.h
+        if(shadowMaps.enabled){
+            shadowMaps.update(world, scenePool, camera, FOV, (float)framebufferWidth / (float)framebufferHeight, 0.1f, sunDirection);
+            frameGraph.addPass("shadows", {}, {shadowMap}, [&](){
+                shadowMaps.render(scenePool, depthShaders.get(ShaderDefines()), streamBuffer);
+            });
+        }
+
+        std::vector<RenderGraph::Handle> opaqueInputs;
+        if(shadowMaps.enabled)
+            opaqueInputs.push_back(shadowMap);
+        frameGraph.addPass("opaque", opaqueInputs, {sceneColor, sceneDepth}, [&](){
+            glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+
+            // floor and cubes
+            //whatever the frustum or the occluders rule out never reaches the draw list
+            hizReadback.fetch(hiz);
+            if(occlusionMode != OCCLUSION_GPU && hiz.valid())
+                hiz = HiZBuffer(); //don't cull with a stale pyramid when the gpu mode comes back
+            const HiZBuffer* occluders = nullptr;
+            if(occlusionMode == OCCLUSION_CPU){
+                rasterizeOccluders(world, softwareOcclusion, camera.worldToProjMatrix(), reversedZ);
+                occluders = &softwareOcclusion.depthPyramid();
+            }else if(occlusionMode == OCCLUSION_GPU){
+                occluders = &hiz;
+            }
+            opaqueDraws.clear();
+            collectVisibleDraws(world, scenePool, camera.frustumPlanes(), occluders, opaqueDraws, cullStats);
+            materialTable.bind();
+            //depth only first, then shade with GL_EQUAL so scene.fs runs once per covered pixel
+            if(depthPrepass.beginDepth()){
+                Shader& depthShader = depthShaders.get(ShaderDefines());
+                depthShader.use();
+                depthShader.setMat4("view", view);
+                depthShader.setMat4("projection", projection);
+                opaqueDraws.submit(scenePool, depthShader, streamBuffer);
+            }
+            depthPrepass.beginShading();
+            if(shadowMaps.enabled)
+                shadowMaps.apply();
+            overdrawStats.beginShading();
+            opaqueDraws.submit(scenePool, sceneShader, streamBuffer);
+            overdrawStats.endShading();
+            depthPrepass.end();
+            overdrawStats.countVisible(coverShader);
+
+            //grass, after the opaque draws so the early depth test already rejects what they hide
+            Shader& foliageShader = foliageShaders.get(foliage.alphaToCoverage() ? ShaderDefines{"ALPHA_TO_COVERAGE"} : ShaderDefines());
+            foliageShader.use();
+            foliageShader.setMat4("view", view);
+            foliageShader.setMat4("projection", projection);
+            foliage.draw(camera.frustumPlanes(), occluders);
+
+            //the opaque depth is the occluder set of the next frames, the windows don't hide anything
+            if(occlusionMode == OCCLUSION_GPU)
+                hizReadback.capture(sceneTarget.depthStencil, sceneTarget.width, sceneTarget.height, camera.worldToProjMatrix(), reversedZ, hizShader);
+        });
+
+        frameGraph.addPass("transparent", {sceneColor, sceneDepth}, {sceneColor, sceneDepth}, [&](){
+            //draw windows
+            //sorted blending needs them farthest to nearest every frame since the camera moves, oit takes any order
+            collectTransparent(world, camera.camPos, transparentDraws, !oitPass);
+
+            //write the model matrices in draw order, instances are rasterized in order so sorted blending still works
+            RingAllocation windowInstances = streamBuffer.allocate(transparentDraws.size() * sizeof(glm::mat4));
+            if(windowInstances.ptr && !transparentDraws.empty()){
+                glm::mat4* instanceModels = (glm::mat4*)windowInstances.ptr;
+                for(unsigned int i = 0; i < transparentDraws.size(); i++)
+                    instanceModels[i] = transparentDraws[i].model;
+                streamBuffer.flush();
+
+                Shader& windowShader = oitPass ? oitShader : instancedShader;
+                windowShader.use();
+                windowShader.setMat4("view", view);
+                windowShader.setMat4("projection", projection);
+                if(oitPass)
+                    oit.begin();
+                glBindVertexArray(windowVAO);
+                glBindBuffer(GL_ARRAY_BUFFER, windowInstances.buffer);
+                //one instanced draw per run of the same texture, the order between runs has to stay intact
+                unsigned int start = 0;
+                while(start < transparentDraws.size()){
+                    unsigned int end = start + 1;
+                    while(end < transparentDraws.size() && transparentDraws[end].texture == transparentDraws[start].texture)
+                        end++;
+                    for(unsigned int i = 0; i < 4; i++){
+                        glVertexAttribPointer(2 + i, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(windowInstances.offset + start * sizeof(glm::mat4) + i * sizeof(glm::vec4)));
+                    }
+                    glBindTexture(GL_TEXTURE_2D, transparentDraws[start].texture);
+                    glDrawArraysInstanced(GL_TRIANGLES, 0, 6, (GLsizei)(end - start));
+                    start = end;
+                }
+                glBindVertexArray(0);
+                if(oitPass){
+                    sceneTarget.bind();
+                    oit.composite(oitCompositeShader);
+                }
+            }
+        });
+
+        frameGraph.addPass("outline", {sceneColor, sceneDepth}, {sceneColor, sceneDepth}, [&](){
+            //outline around the selection, costs the same whatever the selected meshes look like
+            selectionOutline.draw(world, scenePool, view, projection, sceneTarget, outlineMaskShader, outlineSeedShader, jumpFloodShader, outlineShader);
+        });
+
+        //post: bloom at half resolution, tonemap to 8 bit, fxaa
+        int bloomWidth = sceneTarget.width / 2;
+        int bloomHeight = sceneTarget.height / 2;
+        RenderGraph::Handle bloomBright = frameGraph.createTexture("bloomBright", bloomWidth, bloomHeight, GL_R11F_G11F_B10F);
+        RenderGraph::Handle bloomBlurX = frameGraph.createTexture("bloomBlurX", bloomWidth, bloomHeight, GL_R11F_G11F_B10F);
+        RenderGraph::Handle bloomBlurY = frameGraph.createTexture("bloomBlurY", bloomWidth, bloomHeight, GL_R11F_G11F_B10F);
+        frameGraph.addPass("bloomBright", {sceneColor}, {bloomBright}, [&](){
+            bloomBrightShader.use();
+            bloomBrightShader.setFloat("threshold", 1.0f);
+            glBindTexture(GL_TEXTURE_2D, frameGraph.texture(sceneColor));
+            drawFullscreen();
+        });
+        frameGraph.addPass("bloomBlurX", {bloomBright}, {bloomBlurX}, [&](){
+            blurShader.use();
+            blurShader.setVec2("direction", 1.0f, 0.0f);
+            glBindTexture(GL_TEXTURE_2D, frameGraph.texture(bloomBright));
+            drawFullscreen();
+        });
+        frameGraph.addPass("bloomBlurY", {bloomBlurX}, {bloomBlurY}, [&](){
+            blurShader.use();
+            blurShader.setVec2("direction", 0.0f, 1.0f);
+            glBindTexture(GL_TEXTURE_2D, frameGraph.texture(bloomBlurX));
+            drawFullscreen();
+        });
+
+        //below the window resolution the last pass at render resolution writes lowResColor and upscale takes it to
+        //the window, at full resolution they write the window directly
+        bool upscale = sceneTarget.width != framebufferWidth || sceneTarget.height != framebufferHeight;
+        RenderGraph::Handle lowResColor = upscale ? frameGraph.createTexture("lowResColor", sceneTarget.width, sceneTarget.height, GL_RGBA8) : backbuffer;
+        RenderGraph::Handle ldrColor = fxaaEnabled ? frameGraph.createTexture("ldrColor", sceneTarget.width, sceneTarget.height, GL_RGBA8) : lowResColor;
+        std::vector<RenderGraph::Handle> tonemapInputs = {sceneColor};
+        if(bloomEnabled)
+            tonemapInputs.push_back(bloomBlurY);
+        frameGraph.addPass("tonemap", tonemapInputs, {ldrColor}, [&](){
+            Shader& tonemapShader = tonemapShaders.get(bloomEnabled ? ShaderDefines{"BLOOM"} : ShaderDefines());
+            tonemapShader.use();
+            tonemapShader.setFloat("exposure", 1.0f);
+            glBindTexture(GL_TEXTURE_2D, frameGraph.texture(sceneColor));
+            if(bloomEnabled){
+                tonemapShader.setFloat("bloomStrength", 0.3f);
+                glActiveTexture(GL_TEXTURE1);
+                glBindTexture(GL_TEXTURE_2D, frameGraph.texture(bloomBlurY));
+                glActiveTexture(GL_TEXTURE0);
+            }
+            drawFullscreen();
+        });
+        if(fxaaEnabled){
+            frameGraph.addPass("fxaa", {ldrColor}, {lowResColor}, [&](){
+                fxaaShader.use();
+                glBindTexture(GL_TEXTURE_2D, frameGraph.texture(ldrColor));
+                drawFullscreen();
+            });
+        }
+        if(upscale){
+            frameGraph.addPass("upscale", {lowResColor}, {backbuffer}, [&](){
+                upscaleShader.use();
+                upscaleShader.setFloat("sharpness", 0.5f);
+                glBindTexture(GL_TEXTURE_2D, frameGraph.texture(lowResColor));
+                drawFullscreen();
+            });
+        }
+
+        frameGraph.setOutput(backbuffer);
+        dynamicResolution.beginFrame();
+        if(frameGraph.compile())
+            frameGraph.execute();
+        else
+            sceneTarget.blitToScreen(framebufferWidth, framebufferHeight);
+        dynamicResolution.endFrame();
+        if(graphDumpRequested){
+            std::cout << frameGraph.dump();
+            graphDumpRequested = false;
+        }
+
+        //everything reading from this frame's region has been submitted
+        streamBuffer.endFrame();
+
+        // glfw: swap buffers (IO events are polled at the top of the frame)
+        // -----------------------------------------------------------------
         glfwSwapBuffers(window);
-        glfwPollEvents();
+        framePacer.endFrame();
+
+        if(glfwGetTime() - lastTitleUpdate > 0.5){
+            std::string title = "LearnOpenGL | " + framePacer.summary() + (depthPrepass.enabled ? " | pre-pass" : "");
+            title += " | draws " + std::to_string(cullStats.submitted) + "/" + std::to_string(cullStats.objects);
+            if(occlusionMode != OCCLUSION_OFF)
+                title += " (" + std::to_string(cullStats.occluded) + (occlusionMode == OCCLUSION_CPU ? " occluded, cpu)" : " occluded, gpu)");
+            title += " | " + dynamicResolution.summary();
+            title += " | grass " + std::to_string(foliage.visibleInstances);
+            if(shadowMaps.enabled)
+                title += " | " + shadowMaps.summary();
+            if(oitPass)
+                title += " | oit";
+            if(overdrawStats.enabled)
+                title += " | " + overdrawStats.summary();
+            glfwSetWindowTitle(window, title.c_str());
+            lastTitleUpdate = glfwGetTime();
+        }
     }
 
     // optional: de-allocate all resources once they've outlived their purpose:
     // ------------------------------------------------------------------------
-    glDeleteVertexArrays(1, &cubeVAO);
-    glDeleteVertexArrays(1, &planeVAO);
-    glDeleteBuffers(1, &cubeVBO);
-    glDeleteBuffers(1, &planeVBO);
+    simulation.stop();
+    scenePool.release();
+    materialTable.release();
+    shaderReloader.stop();
+    sceneShaders.release();
+    depthShaders.release();
+    overdrawStats.release();
+    dynamicResolution.release();
+    shadowMaps.release();
+    hizReadback.release();
+    glDeleteVertexArrays(1, &windowVAO);
+    glDeleteBuffers(1, &windowVBO);
+    streamBuffer.release();
+    foliage.release();
+    glDeleteTextures(1, &foliage.texture);
+    frameGraph.release();
+    glDeleteVertexArrays(1, &fullscreenVAO);
+    tonemapShaders.release();
+    selectionOutline.release();
+    oit.release();
+    sceneTarget.release();
+    framePacer.release();
+    shaderCompileThread.stop();
+    jobSystem.stop();
 
     glfwTerminate();
     return 0;
@@ -307,23 +789,118 @@ void processInput(GLFWwindow *window)
     if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
         glfwSetWindowShouldClose(window, true);
 
-    if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
-        camera.ProcessKeyboard(FORWARD, deltaTime);
-    if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
-        camera.ProcessKeyboard(BACKWARD, deltaTime);
-    if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS)
-        camera.ProcessKeyboard(LEFT, deltaTime);
-    if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
-        camera.ProcessKeyboard(RIGHT, deltaTime);
+    //movement is applied by the simulation thread every tick with the fixed step
+    SimInput input;
+    input.forward = glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS;
+    input.backward = glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS;
+    input.left = glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS;
+    input.right = glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS;
+    simulation.setInput(input);
 
     if (glfwGetKey(window, GLFW_KEY_F) == GLFW_PRESS){
         if(!flashLightPress){
-            flashLightOn = !flashLightOn;
+            simulation.toggleFlashLight();
             flashLightPress = true;
         }
     }else if(glfwGetKey(window, GLFW_KEY_F) == GLFW_RELEASE){
         flashLightPress = false;
     }
+
+    if (glfwGetKey(window, GLFW_KEY_V) == GLFW_PRESS){
+        if(!vsyncPress){
+            framePacer.cycleSwapInterval();
+            vsyncPress = true;
+        }
+    }else if(glfwGetKey(window, GLFW_KEY_V) == GLFW_RELEASE){
+        vsyncPress = false;
+    }
+
+    if (glfwGetKey(window, GLFW_KEY_P) == GLFW_PRESS){
+        if(!prepassPress){
+            depthPrepass.enabled = !depthPrepass.enabled;
+            prepassPress = true;
+        }
+    }else if(glfwGetKey(window, GLFW_KEY_P) == GLFW_RELEASE){
+        prepassPress = false;
+    }
+    if (glfwGetKey(window, GLFW_KEY_O) == GLFW_PRESS){
+        if(!overdrawPress){
+            overdrawStats.enabled = !overdrawStats.enabled;
+            overdrawPress = true;
+        }
+    }else if(glfwGetKey(window, GLFW_KEY_O) == GLFW_RELEASE){
+        overdrawPress = false;
+    }
+    if (glfwGetKey(window, GLFW_KEY_C) == GLFW_PRESS){
+        if(!occlusionPress){
+            occlusionMode = (OcclusionMode)((occlusionMode + 1) % 3);
+            occlusionPress = true;
+        }
+    }else if(glfwGetKey(window, GLFW_KEY_C) == GLFW_RELEASE){
+        occlusionPress = false;
+    }
+    if (glfwGetKey(window, GLFW_KEY_T) == GLFW_PRESS){
+        if(!transparencyPress){
+            transparencyMode = transparencyMode == TRANSPARENCY_SORTED ? TRANSPARENCY_OIT : TRANSPARENCY_SORTED;
+            transparencyPress = true;
+        }
+    }else if(glfwGetKey(window, GLFW_KEY_T) == GLFW_RELEASE){
+        transparencyPress = false;
+    }
+    if (glfwGetKey(window, GLFW_KEY_L) == GLFW_PRESS){
+        if(!selectionPress){
+            selection++;
+            selectionPress = true;
+        }
+    }else if(glfwGetKey(window, GLFW_KEY_L) == GLFW_RELEASE){
+        selectionPress = false;
+    }
+    if (glfwGetKey(window, GLFW_KEY_B) == GLFW_PRESS){
+        if(!bloomPress){
+            bloomEnabled = !bloomEnabled;
+            bloomPress = true;
+        }
+    }else if(glfwGetKey(window, GLFW_KEY_B) == GLFW_RELEASE){
+        bloomPress = false;
+    }
+    if (glfwGetKey(window, GLFW_KEY_X) == GLFW_PRESS){
+        if(!fxaaPress){
+            fxaaEnabled = !fxaaEnabled;
+            fxaaPress = true;
+        }
+    }else if(glfwGetKey(window, GLFW_KEY_X) == GLFW_RELEASE){
+        fxaaPress = false;
+    }
+    if (glfwGetKey(window, GLFW_KEY_G) == GLFW_PRESS){
+        if(!graphDumpPress){
+            graphDumpRequested = true;
+            graphDumpPress = true;
+        }
+    }else if(glfwGetKey(window, GLFW_KEY_G) == GLFW_RELEASE){
+        graphDumpPress = false;
+    }
+    if (glfwGetKey(window, GLFW_KEY_R) == GLFW_PRESS){
+        if(!dynamicResolutionPress){
+            dynamicResolution.enabled = !dynamicResolution.enabled;
+            dynamicResolutionPress = true;
+        }
+    }else if(glfwGetKey(window, GLFW_KEY_R) == GLFW_RELEASE){
+        dynamicResolutionPress = false;
+    }
+    if (glfwGetKey(window, GLFW_KEY_H) == GLFW_PRESS){
+        if(!shadowsPress){
+            shadowMaps.enabled = !shadowMaps.enabled;
+            shadowsPress = true;
+        }
+    }else if(glfwGetKey(window, GLFW_KEY_H) == GLFW_RELEASE){
+        shadowsPress = false;
+    }
+    if (glfwGetKey(window, GLFW_KEY_1) == GLFW_PRESS)
+        framePacer.maxFramesInFlight = 1;
+    if (glfwGetKey(window, GLFW_KEY_2) == GLFW_PRESS)
+        framePacer.maxFramesInFlight = 2;
+    if (glfwGetKey(window, GLFW_KEY_3) == GLFW_PRESS)
+        framePacer.maxFramesInFlight = 3;
         
 }
 
@@ -334,6 +911,11 @@ void framebuffer_size_callback(GLFWwindow* window, int width, int height)
     // make sure the viewport matches the new window dimensions; note that width and 
     // height will be significantly larger than specified on retina displays.
     glViewport(0, 0, width, height);
+    //minimized windows report 0x0, keep the last aspect ratio
+    if(width > 0 && height > 0){
+        framebufferWidth = width;
+        framebufferHeight = height;
+    }
 }
 
 // glfw: whenever the mouse moves, this callback is called
@@ -359,52 +941,69 @@ void mouse_callback(GLFWwindow* window, double xposIn, double yposIn)
     lastX = xpos;
     lastY = ypos;
 
-    camera.ProcessMouseMovement(xoffset, yoffset, FOV);
+    simulation.addMouseMovement(xoffset, yoffset);
 }
 
-// utility function for loading a 2D texture from file
-// ---------------------------------------------------
-unsigned int loadTexture(char const *path)
+// utility function for uploading a 2D texture that was already cooked, e.g. by cookTextureAsync
+// ----------------------------------------------------------------------------------------------
+unsigned int uploadTexture(const CookedTexture& texture)
 {
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-
-    int width, height, nrComponents;
-    unsigned char *data = stbi_load(path, &width, &height, &nrComponents, 0);
-    if (data)
+    if(!texture.valid())
     {
-        //sets the format of the texture ex: RGB, RGBA (Images with Transparency or Translucency)
-        GLenum format;
-        if (nrComponents == 1)
-            format = GL_RED;
-        else if (nrComponents == 3)
-            format = GL_RGB;
-        else if (nrComponents == 4)
-            format = GL_RGBA;
-
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        //we dont want the transparent part of the texture to repeat into a colored area, so we clamp it to the edge
-        if(format == GL_RGBA){
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        }else{
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        }
+        unsigned int textureID;
+        glGenTextures(1, &textureID);
+        return textureID;
+    }
 
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    unsigned int textureID = uploadCookedTexture(texture);
 
-        stbi_image_free(data);
+    //we dont want the transparent part of the texture to repeat into a colored area, so we clamp it to the edge
+    if(texture.hasAlpha){
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    }else{
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
     }
-    else
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    return textureID;
+}
+
+// turns an interleaved position(3)/normal(3)/texCoord(2) float array into Vertex structs
+// ---------------------------------------------------------------------------------------
+vector<Vertex> toVertices(const float* data, unsigned int floatCount)
+{
+    vector<Vertex> vertices;
+    for(unsigned int i = 0; i + 8 <= floatCount; i += 8)
     {
-        std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
+        Vertex vertex;
+        vertex.Position = glm::vec3(data[i], data[i + 1], data[i + 2]);
+        vertex.Normal = glm::vec3(data[i + 3], data[i + 4], data[i + 5]);
+        vertex.TexCoords = glm::vec2(data[i + 6], data[i + 7]);
+        vertices.push_back(vertex);
     }
+    return vertices;
+}
 
-    return textureID;
-}
\ No newline at end of file
+// just the positions of the same layout, for the occluder meshes
+// -----------------------------------------------------------------------
+vector<glm::vec3> toPositions(const float* data, unsigned int floatCount)
+{
+    vector<glm::vec3> positions;
+    for(unsigned int i = 0; i + 8 <= floatCount; i += 8)
+        positions.push_back(glm::vec3(data[i], data[i + 1], data[i + 2]));
+    return positions;
+}
+
+// index buffer for geometry that was written out as a plain triangle list
+// -----------------------------------------------------------------------
+vector<unsigned int> sequentialIndices(unsigned int count)
+{
+    vector<unsigned int> indices(count);
+    for(unsigned int i = 0; i < count; i++)
+        indices[i] = i;
+    return indices;
+}
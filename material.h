@@ -0,0 +1,226 @@
+#ifndef MATERIAL_H
+#define MATERIAL_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include "shader.h"
+#include "texture_cooker.h"
+
+#include <future>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// has to match MAX_TEXTURE_ARRAYS / MAX_MATERIALS in shaders/include/materials.glsl
+#define MAX_TEXTURE_ARRAYS 8
+#define MAX_MATERIALS 256
+
+// binding point of the Materials uniform block
+#define MATERIAL_UBO_BINDING 1
+
+// where a texture ended up: which array and which layer inside of it
+struct TextureRef {
+    int array = -1;
+    int layer = 0;
+};
+
+// std140 layout of one entry of the Materials block (ivec4 + vec4)
+struct MaterialData {
+    GLint diffuseArray;
+    GLint diffuseLayer;
+    GLint specularArray; //-1 if the material has no specular map
+    GLint specularLayer;
+    float shininess;
+    float pad[3];
+};
+
+// Every texture is cooked (see texture_cooker.h) and packed into a GL_TEXTURE_2D_ARRAY together with the other
+// textures of the same size and format, and every material is an entry in one uniform buffer. All arrays are
+// bound to fixed texture units once per frame, so drawing something only needs its material index (an ssbo
+// field with multi draw, a single int uniform otherwise) instead of glBindTexture + sampler name lookups per draw.
+//
+// usage: prefetch() as early as possible, addTexture()/addMaterial() while loading, build() once, then bind() + setupShader()
+class MaterialTable {
+    public:
+        std::vector<MaterialData> materials;
+
+        // starts cooking on a worker thread, the matching addTexture() picks the result up instead of cooking it again
+        void prefetch(const std::string& path, bool srgb = false){
+            for(unsigned int i = 0; i < pending.size(); i++){
+                if(pending[i].path == path && pending[i].srgb == srgb)
+                    return;
+            }
+            pending.push_back({path, srgb, cookTextureAsync(path, runtimeCookOptions(srgb))});
+        }
+
+        // cooks (or loads from the cache) right away so we know which array it belongs in, the upload happens in build()
+        TextureRef addTexture(const std::string& path, bool srgb = false){
+            for(unsigned int i = 0; i < loaded.size(); i++){
+                //the same file as srgb color and as linear data are two different layers
+                if(loaded[i].path == path && loaded[i].srgb == srgb)
+                    return loaded[i].ref;
+            }
+
+            TextureRef ref;
+            CookedTexture texture;
+            bool prefetched = false;
+            for(unsigned int i = 0; i < pending.size(); i++){
+                if(pending[i].path == path && pending[i].srgb == srgb){
+                    jobSystem.waitFor(pending[i].result);
+                    texture = pending[i].result.get();
+                    pending.erase(pending.begin() + i);
+                    prefetched = true;
+                    break;
+                }
+            }
+            if(!prefetched)
+                texture = cookTexture(path, runtimeCookOptions(srgb));
+            if(!texture.valid())
+                return ref;
+
+            int array = -1;
+            for(unsigned int i = 0; i < arrays.size(); i++){
+                if(arrays[i].width == texture.width && arrays[i].height == texture.height && arrays[i].internalFormat == texture.internalFormat()){
+                    array = i;
+                    break;
+                }
+            }
+            if(array < 0){
+                if(arrays.size() == MAX_TEXTURE_ARRAYS){
+                    std::cout << "ERROR::MATERIAL_TABLE::TOO_MANY_TEXTURE_ARRAYS " << path << std::endl;
+                    return ref;
+                }
+                TextureArray newArray;
+                newArray.width = texture.width;
+                newArray.height = texture.height;
+                newArray.internalFormat = texture.internalFormat();
+                arrays.push_back(newArray);
+                array = (int)arrays.size() - 1;
+            }
+
+            ref.array = array;
+            ref.layer = (int)arrays[array].layers.size();
+            arrays[array].layers.push_back(texture);
+            loaded.push_back({path, srgb, ref});
+            return ref;
+        }
+
+        // returns the material index that goes into DrawList::add / Mesh::materialIndex
+        unsigned int addMaterial(TextureRef diffuse, TextureRef specular = TextureRef(), float shininess = 32.0f){
+            if(materials.size() == MAX_MATERIALS){
+                std::cout << "ERROR::MATERIAL_TABLE::TOO_MANY_MATERIALS" << std::endl;
+                return 0;
+            }
+            MaterialData material = {diffuse.array, diffuse.layer, specular.array, specular.layer, shininess, {0.0f, 0.0f, 0.0f}};
+            materials.push_back(material);
+            return (unsigned int)materials.size() - 1;
+        }
+
+        // uploads every array with all of its cooked mip levels and the material buffer, the cpu copies are dropped afterwards
+        void build(){
+            for(unsigned int i = 0; i < arrays.size(); i++){
+                TextureArray& array = arrays[i];
+                if(array.layers.empty())
+                    continue;
+                if(array.id == 0)
+                    glGenTextures(1, &array.id);
+                glBindTexture(GL_TEXTURE_2D_ARRAY, array.id);
+
+                const CookedTexture& first = array.layers[0];
+                GLsizei layerCount = (GLsizei)array.layers.size();
+                int width = array.width, height = array.height;
+                for(unsigned int level = 0; level < first.levels.size(); level++){
+                    GLsizei levelSize = (GLsizei)first.levels[level].size();
+                    if(first.compressed())
+                        glCompressedTexImage3D(GL_TEXTURE_2D_ARRAY, level, array.internalFormat, width, height, layerCount, 0, levelSize * layerCount, NULL);
+                    else
+                        glTexImage3D(GL_TEXTURE_2D_ARRAY, level, array.internalFormat, width, height, layerCount, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+                    for(GLsizei layer = 0; layer < layerCount; layer++){
+                        const std::vector<uint8_t>& data = array.layers[layer].levels[level];
+                        if(first.compressed())
+                            glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, layer, width, height, 1, array.internalFormat, (GLsizei)data.size(), data.data());
+                        else
+                            glTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, layer, width, height, 1, GL_RGBA, GL_UNSIGNED_BYTE, data.data());
+                    }
+                    width = std::max(width / 2, 1);
+                    height = std::max(height / 2, 1);
+                }
+                glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, (GLint)first.levels.size() - 1);
+                array.layers.clear();
+
+                glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+                glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+                glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+                glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            }
+            glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+            if(ubo == 0)
+                glGenBuffers(1, &ubo);
+            glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+            glBufferData(GL_UNIFORM_BUFFER, MAX_MATERIALS * sizeof(MaterialData), NULL, GL_STATIC_DRAW);
+            glBufferSubData(GL_UNIFORM_BUFFER, 0, materials.size() * sizeof(MaterialData), materials.data());
+            glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        }
+
+        // array i goes to texture unit firstUnit + i
+        void bind(unsigned int firstUnit = 0){
+            for(unsigned int i = 0; i < arrays.size(); i++){
+                glActiveTexture(GL_TEXTURE0 + firstUnit + i);
+                glBindTexture(GL_TEXTURE_2D_ARRAY, arrays[i].id);
+            }
+            glActiveTexture(GL_TEXTURE0);
+            glBindBufferBase(GL_UNIFORM_BUFFER, MATERIAL_UBO_BINDING, ubo);
+        }
+
+        // points the shader's samplers and uniform block at what bind() binds, only needed once per program
+        void setupShader(Shader& shader, unsigned int firstUnit = 0){
+            shader.use();
+            for(unsigned int i = 0; i < MAX_TEXTURE_ARRAYS; i++){
+                shader.setInt("textureArrays[" + std::to_string(i) + "]", firstUnit + i);
+            }
+            unsigned int blockIndex = glGetUniformBlockIndex(shader.shaderProgram, "Materials");
+            if(blockIndex != GL_INVALID_INDEX)
+                glUniformBlockBinding(shader.shaderProgram, blockIndex, MATERIAL_UBO_BINDING);
+        }
+
+        void release(){
+            for(unsigned int i = 0; i < arrays.size(); i++){
+                glDeleteTextures(1, &arrays[i].id);
+                arrays[i].id = 0;
+            }
+            if(ubo)
+                glDeleteBuffers(1, &ubo);
+            ubo = 0;
+        }
+
+    private:
+        struct TextureArray {
+            unsigned int id = 0;
+            int width;
+            int height;
+            GLenum internalFormat;
+            std::vector<CookedTexture> layers; //pending uploads
+        };
+
+        struct LoadedTexture {
+            std::string path;
+            bool srgb;
+            TextureRef ref;
+        };
+
+        struct PendingTexture {
+            std::string path;
+            bool srgb;
+            std::future<CookedTexture> result;
+        };
+
+        std::vector<TextureArray> arrays;
+        std::vector<LoadedTexture> loaded;
+        std::vector<PendingTexture> pending;
+        unsigned int ubo = 0;
+};
+
+#endif
@@ -30,6 +30,8 @@ class Mesh {
         std::vector<unsigned int> indices;
         std::vector<Texture> textures;
         unsigned int VAO;
+        int materialIndex = -1; //entry in a MaterialTable, -1 means the mesh binds its own textures
+
 
         Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, std::vector<Texture> textures){
             this->vertices = vertices;
@@ -37,29 +39,28 @@ class Mesh {
             this->textures = textures;
 
             setupMesh();
+            setupSamplerNames();
         }
 
         //render mesh
         void Draw(Shader &shader) 
         {
-            // bind appropriate textures
-            unsigned int diffuseNr  = 1;
-            unsigned int specularNr = 1;
-            for(unsigned int i = 0; i < textures.size(); i++)
+            if(materialIndex >= 0)
             {
-                glActiveTexture(GL_TEXTURE0 + i); // active proper texture unit before binding
-                // retrieve texture number (the N in diffuse_textureN)
-                std::string number;
-                std::string name = textures[i].type;
-                if(name == "texture_diffuse")
-                    number = std::to_string(diffuseNr++);
-                else if(name == "texture_specular")
-                    number = std::to_string(specularNr++); // transfer unsigned int to string
-                
-                // now set the sampler to the correct texture unit
-                shader.setInt((name + number).c_str(), i);
-                // and finally bind the texture
-                glBindTexture(GL_TEXTURE_2D, textures[i].id);
+                // textures live in the MaterialTable's arrays which are already bound, the shader looks them up itself
+                shader.setInt("materialIndex", materialIndex);
+            }
+            else
+            {
+                // bind appropriate textures
+                for(unsigned int i = 0; i < textures.size(); i++)
+                {
+                    glActiveTexture(GL_TEXTURE0 + i); // active proper texture unit before binding
+                    // now set the sampler to the correct texture unit
+                    shader.setInt(samplerNames[i], i);
+                    // and finally bind the texture
+                    glBindTexture(GL_TEXTURE_2D, textures[i].id);
+                }
             }
             
             // draw mesh
@@ -74,6 +75,24 @@ class Mesh {
     private:
         // render data 
         unsigned int VBO, EBO;
+        std::vector<std::string> samplerNames; // texture_diffuseN etc, built once instead of every draw
+
+        // retrieve texture number (the N in diffuse_textureN) for every texture
+        void setupSamplerNames()
+        {
+            unsigned int diffuseNr  = 1;
+            unsigned int specularNr = 1;
+            for(unsigned int i = 0; i < textures.size(); i++)
+            {
+                std::string number;
+                std::string name = textures[i].type;
+                if(name == "texture_diffuse")
+                    number = std::to_string(diffuseNr++);
+                else if(name == "texture_specular")
+                    number = std::to_string(specularNr++); // transfer unsigned int to string
+                samplerNames.push_back(name + number);
+            }
+        }
 
         // initializes all the buffer objects/arrays
         void setupMesh()
@@ -0,0 +1,263 @@
+#ifndef MIPMAP_H
+#define MIPMAP_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define MIPMAP_SSE
+#if defined(__GNUC__) || defined(__clang__)
+#include <immintrin.h>
+#define MIPMAP_AVX
+#endif
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define MIPMAP_NEON
+#endif
+
+// CPU mip chain generator, replaces glGenerateMipmap (a box filter in whatever space the texture is stored in).
+//  - every level is filtered from the float copy of the previous one with a separable 8 tap Kaiser windowed sinc,
+//    so there is no blur build up and no rounding error build up from level to level
+//  - sRGB textures are filtered in linear space, otherwise dark texels win and the smaller levels get darker
+//  - color is weighted by alpha while filtering so fully transparent texels don't bleed their (usually black) color
+//  - for cutout textures the alpha of every level is rescaled so the same fraction of texels passes the alpha test,
+//    otherwise grass/leaves thin out and disappear in the distance
+// The inner loops work on whole pixels (SSE/NEON) and whole rows (AVX on cpus that have it), see the MIPMAP_* paths.
+
+struct MipOptions {
+    bool srgb = false;
+    bool wrap = true;          // repeat at the edges instead of clamping
+    float alphaCutoff = 0.0f;  // alpha test threshold to preserve coverage for, 0 = don't touch alpha
+};
+
+inline float srgbToLinear(float c)
+{
+    return c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+}
+
+inline float linearToSrgb(float c)
+{
+    return c <= 0.0031308f ? c * 12.92f : 1.055f * std::pow(c, 1.0f / 2.4f) - 0.055f;
+}
+
+// filter weights and the linear -> sRGB table, built once (function statics are thread safe to initialize)
+struct MipTables {
+    float weights[8];       // 8 taps at source offsets -3.5 .. 3.5 around the output texel center, sum to 1
+    float toSrgb[4097];     // 4096 steps keeps every output within one step of the exact curve
+
+    MipTables(){
+        //Kaiser window, beta 4 (same trade off between sharpness and ringing as nvtt's default)
+        auto besselI0 = [](float x){
+            float sum = 1.0f, term = 1.0f;
+            for(int k = 1; k < 16; k++){
+                term *= (x / (2.0f * k)) * (x / (2.0f * k));
+                sum += term;
+            }
+            return sum;
+        };
+        const float beta = 4.0f, width = 2.0f; //filter half width in destination texels
+        float total = 0.0f;
+        for(int k = 0; k < 8; k++){
+            float t = (k - 3.5f) / 2.0f; //in destination texels
+            float sinc = std::sin(3.14159265f * t) / (3.14159265f * t);
+            float r = t / width;
+            float window = r * r < 1.0f ? besselI0(beta * std::sqrt(1.0f - r * r)) / besselI0(beta) : 0.0f;
+            weights[k] = sinc * window;
+            total += weights[k];
+        }
+        for(int k = 0; k < 8; k++)
+            weights[k] /= total;
+
+        for(int i = 0; i <= 4096; i++)
+            toSrgb[i] = linearToSrgb(i / 4096.0f);
+    }
+};
+
+inline const MipTables& mipTables()
+{
+    static const MipTables tables;
+    return tables;
+}
+
+inline int mipSampleIndex(int i, int size, bool wrap)
+{
+    if(wrap)
+        return ((i % size) + size) % size;
+    return std::min(std::max(i, 0), size - 1);
+}
+
+#if defined(MIPMAP_AVX)
+// compiled for avx whatever the build flags, only called when the cpu has it
+inline const bool mipHasAVX = (__builtin_cpu_init(), __builtin_cpu_supports("avx"));
+
+// the multiples of 8 of mipAccumulate, returns how many floats it did
+__attribute__((target("avx")))
+inline int mipAccumulateAVX(float* out, const float* in, float weight, int count)
+{
+    __m256 w8 = _mm256_set1_ps(weight);
+    int i = 0;
+    for(; i + 8 <= count; i += 8)
+        _mm256_storeu_ps(out + i, _mm256_add_ps(_mm256_loadu_ps(out + i), _mm256_mul_ps(_mm256_loadu_ps(in + i), w8)));
+    return i;
+}
+#endif
+
+// out += weight * in over count floats
+inline void mipAccumulate(float* out, const float* in, float weight, int count)
+{
+    int i = 0;
+#if defined(MIPMAP_AVX)
+    if(mipHasAVX)
+        i = mipAccumulateAVX(out, in, weight, count);
+#endif
+#if defined(MIPMAP_SSE)
+    __m128 w4 = _mm_set1_ps(weight);
+    for(; i + 4 <= count; i += 4)
+        _mm_storeu_ps(out + i, _mm_add_ps(_mm_loadu_ps(out + i), _mm_mul_ps(_mm_loadu_ps(in + i), w4)));
+#elif defined(MIPMAP_NEON)
+    float32x4_t w4 = vdupq_n_f32(weight);
+    for(; i + 4 <= count; i += 4)
+        vst1q_f32(out + i, vmlaq_f32(vld1q_f32(out + i), vld1q_f32(in + i), w4));
+#endif
+    for(; i < count; i++)
+        out[i] += in[i] * weight;
+}
+
+// one rgba pixel of a horizontal 2:1 downsample, 8 taps
+inline void mipFilterPixel(const float* row, int width, int x, bool wrap, const float* weights, float* out)
+{
+    int first = 2 * x - 3;
+#if defined(MIPMAP_SSE)
+    __m128 sum = _mm_setzero_ps();
+    for(int k = 0; k < 8; k++)
+        sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(row + 4 * mipSampleIndex(first + k, width, wrap)), _mm_set1_ps(weights[k])));
+    _mm_storeu_ps(out, sum);
+#elif defined(MIPMAP_NEON)
+    float32x4_t sum = vdupq_n_f32(0.0f);
+    for(int k = 0; k < 8; k++)
+        sum = vmlaq_n_f32(sum, vld1q_f32(row + 4 * mipSampleIndex(first + k, width, wrap)), weights[k]);
+    vst1q_f32(out, sum);
+#else
+    for(int c = 0; c < 4; c++)
+        out[c] = 0.0f;
+    for(int k = 0; k < 8; k++){
+        const float* p = row + 4 * mipSampleIndex(first + k, width, wrap);
+        for(int c = 0; c < 4; c++)
+            out[c] += p[c] * weights[k];
+    }
+#endif
+}
+
+// float rgba (premultiplied, linear) -> next level, a dimension that is already 1 is copied instead of filtered
+inline std::vector<float> mipDownsample(const std::vector<float>& src, int width, int height, int& outWidth, int& outHeight, bool wrap)
+{
+    const float* weights = mipTables().weights;
+    outWidth = std::max(width / 2, 1);
+    outHeight = std::max(height / 2, 1);
+
+    //horizontal pass: outWidth x height
+    std::vector<float> tmp((size_t)outWidth * height * 4);
+    for(int y = 0; y < height; y++){
+        const float* row = &src[(size_t)y * width * 4];
+        float* out = &tmp[(size_t)y * outWidth * 4];
+        for(int x = 0; x < outWidth; x++){
+            if(width == 1)
+                std::copy(row, row + 4, out);
+            else
+                mipFilterPixel(row, width, x, wrap, weights, out + 4 * x);
+        }
+    }
+    if(height == 1)
+        return tmp;
+
+    //vertical pass works on whole rows at a time
+    std::vector<float> dst((size_t)outWidth * outHeight * 4, 0.0f);
+    int rowFloats = outWidth * 4;
+    for(int y = 0; y < outHeight; y++){
+        float* out = &dst[(size_t)y * rowFloats];
+        for(int k = 0; k < 8; k++)
+            mipAccumulate(out, &tmp[(size_t)mipSampleIndex(2 * y - 3 + k, height, wrap) * rowFloats], weights[k], rowFloats);
+    }
+    return dst;
+}
+
+// fraction of texels whose alpha (times scale) passes the cutoff
+inline float alphaCoverage(const std::vector<float>& level, float cutoff, float scale)
+{
+    size_t passed = 0, count = level.size() / 4;
+    for(size_t i = 0; i < count; i++){
+        if(level[i * 4 + 3] * scale > cutoff)
+            passed++;
+    }
+    return (float)passed / (float)count;
+}
+
+// binary search for the alpha scale that gives back the coverage of level 0
+inline float alphaCoverageScale(const std::vector<float>& level, float cutoff, float targetCoverage)
+{
+    float low = 0.0f, high = 4.0f, scale = 1.0f;
+    for(int i = 0; i < 12; i++){
+        scale = 0.5f * (low + high);
+        if(alphaCoverage(level, cutoff, scale) < targetCoverage)
+            low = scale;
+        else
+            high = scale;
+    }
+    return scale;
+}
+
+// float level -> rgba8, undoing the premultiplication and the linear conversion
+inline std::vector<uint8_t> mipQuantize(const std::vector<float>& level, bool srgb, float alphaScale)
+{
+    const float* srgbTable = mipTables().toSrgb;
+    std::vector<uint8_t> out(level.size());
+    size_t count = level.size() / 4;
+    for(size_t i = 0; i < count; i++){
+        const float* p = &level[i * 4];
+        float alpha = std::min(std::max(p[3], 0.0f), 1.0f);
+        for(int c = 0; c < 3; c++){
+            float v = alpha > 1.0f / 512.0f ? p[c] / alpha : 0.0f;
+            v = std::min(std::max(v, 0.0f), 1.0f); //the negative lobes of the filter can overshoot
+            if(srgb)
+                v = srgbTable[(int)(v * 4096.0f + 0.5f)];
+            out[i * 4 + c] = (uint8_t)(v * 255.0f + 0.5f);
+        }
+        out[i * 4 + 3] = (uint8_t)(std::min(alpha * alphaScale, 1.0f) * 255.0f + 0.5f);
+    }
+    return out;
+}
+
+// rgba8 level 0 -> every level down to 1x1 (level 0 included, untouched)
+inline std::vector<std::vector<uint8_t>> generateMipChain(const uint8_t* rgba, int width, int height, const MipOptions& options)
+{
+    std::vector<std::vector<uint8_t>> levels;
+    levels.push_back(std::vector<uint8_t>(rgba, rgba + (size_t)width * height * 4));
+
+    float linearTable[256];
+    for(int i = 0; i < 256; i++)
+        linearTable[i] = options.srgb ? srgbToLinear(i / 255.0f) : i / 255.0f;
+
+    //premultiplied linear floats
+    std::vector<float> level((size_t)width * height * 4);
+    for(size_t i = 0; i < level.size(); i += 4){
+        float alpha = rgba[i + 3] / 255.0f;
+        for(int c = 0; c < 3; c++)
+            level[i + c] = linearTable[rgba[i + c]] * alpha;
+        level[i + 3] = alpha;
+    }
+
+    float targetCoverage = options.alphaCutoff > 0.0f ? alphaCoverage(level, options.alphaCutoff, 1.0f) : 0.0f;
+    while(width > 1 || height > 1){
+        level = mipDownsample(level, width, height, width, height, options.wrap);
+        float alphaScale = 1.0f;
+        if(options.alphaCutoff > 0.0f)
+            alphaScale = alphaCoverageScale(level, options.alphaCutoff, targetCoverage);
+        levels.push_back(mipQuantize(level, options.srgb, alphaScale));
+    }
+    return levels;
+}
+
+#endif
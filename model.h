@@ -13,6 +13,9 @@
 #include "stb_image.h"
 #include "shader.h"
 #include "mesh.h"
+#include "indirect.h"
+#include "material.h"
+#include "texture_cooker.h"
 
 #include <string>
 #include <vector>
@@ -26,19 +29,44 @@ class Model{
         std::vector<Mesh> meshes;
         std::string directory;
         bool gammaCorrection;
+        std::vector<unsigned int> poolMeshes; //handles of the meshes once they have been copied into a MeshPool
+        MaterialTable* materialTable = nullptr;
 
         //constructor expects filepath to 3D model
         Model(std::string const &path, bool gamma = false) : gammaCorrection(gamma){
             loadModel(path);
         }
 
+        //textures go into the table's arrays and every mesh gets a material index instead of its own textures
+        Model(std::string const &path, MaterialTable &materialTable, bool gamma = false) : gammaCorrection(gamma), materialTable(&materialTable){
+            loadModel(path);
+        }
+
         //draws all the meshes
         void Draw(Shader &shader){
             for(unsigned int i = 0; i < meshes.size(); i++){
                 meshes[i].Draw(shader);
             }
         }
+
+        //copies every mesh into the shared pool so the whole model can be drawn through a DrawList
+        void addToPool(MeshPool& pool){
+            poolMeshes.clear();
+            for(unsigned int i = 0; i < meshes.size(); i++){
+                poolMeshes.push_back(pool.add(meshes[i].vertices, meshes[i].indices));
+            }
+        }
+
+        //queues all the meshes instead of drawing them one by one, needs addToPool first
+        void Draw(DrawList& drawList, const glm::mat4& model){
+            for(unsigned int i = 0; i < poolMeshes.size(); i++){
+                int material = meshes[i].materialIndex;
+                drawList.add(poolMeshes[i], model, material < 0 ? 0 : material);
+            }
+        }
     private:
+        std::vector<std::pair<aiMaterial*, unsigned int>> materials_loaded;
+
         void loadModel(std::string path){
             Assimp::Importer importer;
             const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
@@ -112,6 +140,12 @@ class Model{
 
             //process textures
             aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];    
+            if(materialTable){
+                Mesh result(vertices, indices, textures);
+                result.materialIndex = (int)loadMaterial(material);
+                return result;
+            }
+
             // we assume a convention for sampler names in the shaders. Each diffuse texture should be named
             // as 'texture_diffuseN' where N is a sequential number ranging from 1 to MAX_SAMPLER_NUMBER. 
             // Same applies to other texture as the following list summarizes:
@@ -130,6 +164,31 @@ class Model{
             return Mesh(vertices, indices, textures);
         }
         
+        //adds the first diffuse/specular map of the material to the table (assimp materials are shared between meshes so cache them)
+        unsigned int loadMaterial(aiMaterial* mat){
+            for(unsigned int i = 0; i < materials_loaded.size(); i++){
+                if(materials_loaded[i].first == mat)
+                    return materials_loaded[i].second;
+            }
+
+            TextureRef diffuse, specular;
+            aiString str;
+            if(mat->GetTextureCount(aiTextureType_DIFFUSE) > 0){
+                mat->GetTexture(aiTextureType_DIFFUSE, 0, &str);
+                diffuse = materialTable->addTexture(directory + '/' + str.C_Str(), gammaCorrection);
+            }
+            if(mat->GetTextureCount(aiTextureType_SPECULAR) > 0){
+                mat->GetTexture(aiTextureType_SPECULAR, 0, &str);
+                specular = materialTable->addTexture(directory + '/' + str.C_Str());
+            }
+            float shininess = 32.0f;
+            mat->Get(AI_MATKEY_SHININESS, shininess);
+
+            unsigned int index = materialTable->addMaterial(diffuse, specular, shininess);
+            materials_loaded.push_back(std::make_pair(mat, index));
+            return index;
+        }
+
         //helper to retrieve texture file location, loads, generates, and stores them in a Vertex Struct
         std::vector<Texture> loadMaterialTextures(aiMaterial* mat, aiTextureType type, std::string typeName){
             std::vector<Texture> textures;
@@ -168,35 +227,20 @@ unsigned int TextureFromFile(const char *path, const std::string &directory, boo
     filename = directory + '/' + filename;
 
     unsigned int textureID;
-    glGenTextures(1, &textureID);
-    
-    int width, height, nrComponents;
-    unsigned char *data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
-    if (data)
+    CookedTexture texture = cookTexture(filename, runtimeCookOptions(gamma));
+    if (texture.valid())
     {
-        GLenum format;
-        if (nrComponents == 1)
-            format = GL_RED;
-        else if (nrComponents == 3)
-            format = GL_RGB;
-        else if (nrComponents == 4)
-            format = GL_RGBA;
-
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
+        // every mip level comes precomputed (and usually block compressed) from the cooker
+        textureID = uploadCookedTexture(texture);
 
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        stbi_image_free(data);
     }
     else
     {
-        std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
+        glGenTextures(1, &textureID);
     }
 
     return textureID;
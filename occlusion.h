@@ -0,0 +1,321 @@
+#ifndef OCCLUSION_H
+#define OCCLUSION_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include "ecs.h"
+#include "indirect.h"
+#include "scene.h"
+#include "shader.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+// Hierarchical-Z occlusion culling on the cpu, before anything goes into the DrawList.
+// HiZBuffer is a max depth pyramid (min with reversed-Z): every texel holds the farthest depth of the pixels
+// below it, so one texel read tells whether a box is behind everything in that area. A box is tested by
+// projecting its corners, picking the level where its screen rect covers at most 2x2 texels and comparing its
+// nearest depth against the farthest depth there.
+//
+// The depth comes from the gpu's previous frames (HiZReadback), so it lags the camera by a couple of frames and
+// is tested with the view projection it was rendered with: an object hidden from where the camera was can pop
+// in a frame or two late after a fast turn, it never goes missing for longer. build() takes any float depth
+// buffer, so a cpu rasterized occluder buffer can feed the same tests.
+
+struct CullStats {
+    unsigned int objects = 0;
+    unsigned int frustumCulled = 0;
+    unsigned int occluded = 0;
+    unsigned int submitted = 0;
+};
+
+class HiZBuffer {
+    public:
+        bool reversedZ = false;
+        glm::mat4 viewProjection = glm::mat4(1.0f); // what the depth was rendered with, boxes are projected with it
+
+        bool valid() const{
+            return !levels.empty();
+        }
+
+        // depth is width x height floats with row 0 at the bottom (glReadPixels order). uvScale is how many level 0
+        // texels one screen spans, width/height unless a texel covers a block of pixels that doesn't divide the
+        // screen evenly
+        void build(const float* depth, int width, int height, glm::vec2 uvScale, const glm::mat4& matrix, bool reversed){
+            reversedZ = reversed;
+            viewProjection = matrix;
+            scale = uvScale;
+
+            unsigned int count = 1;
+            for(int w = width, h = height; w > 1 || h > 1; w = (w + 1) / 2, h = (h + 1) / 2)
+                count++;
+            levels.resize(count);
+            widths.resize(count);
+            heights.resize(count);
+
+            widths[0] = width;
+            heights[0] = height;
+            levels[0].assign(depth, depth + width * height);
+            for(unsigned int l = 1; l < count; l++){
+                int sourceWidth = widths[l - 1], sourceHeight = heights[l - 1];
+                int w = (sourceWidth + 1) / 2, h = (sourceHeight + 1) / 2;
+                widths[l] = w;
+                heights[l] = h;
+                levels[l].resize(w * h);
+                const float* source = levels[l - 1].data();
+                float* destination = levels[l].data();
+                for(int y = 0; y < h; y++){
+                    //odd sizes: the last texel takes the edge twice, which can only make it more conservative
+                    int y0 = y * 2, y1 = std::min(y * 2 + 1, sourceHeight - 1);
+                    for(int x = 0; x < w; x++){
+                        int x0 = x * 2, x1 = std::min(x * 2 + 1, sourceWidth - 1);
+                        destination[y * w + x] = farthest(farthest(source[y0 * sourceWidth + x0], source[y0 * sourceWidth + x1]),
+                                                          farthest(source[y1 * sourceWidth + x0], source[y1 * sourceWidth + x1]));
+                    }
+                }
+            }
+        }
+
+        // world space box, true when it is completely behind what was drawn
+        bool isOccluded(glm::vec3 boxMin, glm::vec3 boxMax) const{
+            if(levels.empty())
+                return false;
+
+            glm::vec2 lo(1e30f), hi(-1e30f);
+            float nearest = reversedZ ? 0.0f : 1.0f;
+            for(int i = 0; i < 8; i++){
+                glm::vec3 corner((i & 1) ? boxMax.x : boxMin.x, (i & 2) ? boxMax.y : boxMin.y, (i & 4) ? boxMax.z : boxMin.z);
+                glm::vec4 clip = viewProjection * glm::vec4(corner, 1.0f);
+                if(clip.w <= 1e-5f)
+                    return false; //reaches behind the camera
+                glm::vec3 ndc = glm::vec3(clip) / clip.w;
+                lo = glm::min(lo, glm::vec2(ndc.x, ndc.y));
+                hi = glm::max(hi, glm::vec2(ndc.x, ndc.y));
+                float depth = reversedZ ? ndc.z : ndc.z * 0.5f + 0.5f;
+                nearest = reversedZ ? std::max(nearest, depth) : std::min(nearest, depth);
+            }
+            if(reversedZ ? nearest >= 1.0f : nearest <= 0.0f)
+                return false; //crosses the near plane
+
+            glm::vec2 minTexel = glm::clamp(lo * 0.5f + 0.5f, 0.0f, 1.0f) * scale;
+            glm::vec2 maxTexel = glm::clamp(hi * 0.5f + 0.5f, 0.0f, 1.0f) * scale;
+            float size = std::max(maxTexel.x - minTexel.x, maxTexel.y - minTexel.y);
+            int level = size <= 1.0f ? 0 : (int)std::ceil(std::log2(size));
+            level = std::min(level, (int)levels.size() - 1);
+
+            int w = widths[level], h = heights[level];
+            int x0 = std::min((int)minTexel.x >> level, w - 1), x1 = std::min((int)maxTexel.x >> level, w - 1);
+            int y0 = std::min((int)minTexel.y >> level, h - 1), y1 = std::min((int)maxTexel.y >> level, h - 1);
+            const float* texels = levels[level].data();
+            float occluder = reversedZ ? 1.0f : 0.0f;
+            for(int y = y0; y <= y1; y++){
+                for(int x = x0; x <= x1; x++)
+                    occluder = farthest(occluder, texels[y * w + x]);
+            }
+            return reversedZ ? nearest < occluder : nearest > occluder;
+        }
+
+    private:
+        std::vector<std::vector<float>> levels;
+        std::vector<int> widths;
+        std::vector<int> heights;
+        glm::vec2 scale = glm::vec2(0.0f);
+
+        float farthest(float a, float b) const{
+            return reversedZ ? std::min(a, b) : std::max(a, b);
+        }
+};
+
+// world space bounds of a transformed object space box
+inline void transformBounds(glm::vec3 localMin, glm::vec3 localMax, const glm::mat4& matrix, glm::vec3& boxMin, glm::vec3& boxMax)
+{
+    glm::vec3 center = glm::vec3(matrix * glm::vec4((localMin + localMax) * 0.5f, 1.0f));
+    glm::vec3 extent = (localMax - localMin) * 0.5f;
+    glm::vec3 worldExtent = glm::abs(glm::vec3(matrix[0])) * extent.x + glm::abs(glm::vec3(matrix[1])) * extent.y + glm::abs(glm::vec3(matrix[2])) * extent.z;
+    boxMin = center - worldExtent;
+    boxMax = center + worldExtent;
+}
+
+// planes as returned by Camera::frustumPlanes(), tests the box corner farthest along each normal
+inline bool boxInFrustum(const glm::vec4* planes, glm::vec3 boxMin, glm::vec3 boxMax)
+{
+    for(int i = 0; i < 6; i++){
+        glm::vec3 positive(planes[i].x >= 0.0f ? boxMax.x : boxMin.x, planes[i].y >= 0.0f ? boxMax.y : boxMin.y, planes[i].z >= 0.0f ? boxMax.z : boxMin.z);
+        if(glm::dot(glm::vec3(planes[i]), positive) + planes[i].w < 0.0f)
+            return false;
+    }
+    return true;
+}
+
+// every MeshRenderer into drawList, minus what the frustum and (when hiz is set and has data) the occluders rule out
+inline void collectVisibleDraws(World& world, const MeshPool& pool, const glm::vec4* frustum, const HiZBuffer* hiz, DrawList& drawList, CullStats& stats)
+{
+    stats = CullStats();
+    bool occlusion = hiz && hiz->valid();
+    world.eachChunk<WorldTransform, MeshRenderer>([&](unsigned int count, const Entity*, WorldTransform* worlds, MeshRenderer* renderers){
+        for(unsigned int i = 0; i < count; i++){
+            stats.objects++;
+            const PoolMesh& mesh = pool.meshes[renderers[i].mesh];
+            glm::vec3 boxMin, boxMax;
+            transformBounds(mesh.boundsMin, mesh.boundsMax, worlds[i].matrix, boxMin, boxMax);
+            if(frustum && !boxInFrustum(frustum, boxMin, boxMax)){
+                stats.frustumCulled++;
+                continue;
+            }
+            if(occlusion && hiz->isOccluded(boxMin, boxMax)){
+                stats.occluded++;
+                continue;
+            }
+            drawList.add(renderers[i].mesh, worlds[i].matrix, renderers[i].material);
+            stats.submitted++;
+        }
+    });
+}
+
+#define HIZ_READBACK_FRAMES 3
+#define HIZ_READBACK_WIDTH 256
+
+// Gets the depth buffer of a frame to the cpu without stalling: shaders/hiz.fs reduces it on the gpu to about
+// HIZ_READBACK_WIDTH texels across (each the farthest depth of a square block of pixels), glReadPixels copies
+// that into a pixel pack buffer and a fence marks when it landed. fetch() maps the newest finished one,
+// normally the one from two frames ago.
+//
+// usage: capture() after the opaque pass (it leaves its own framebuffer bound), fetch() before culling
+class HiZReadback {
+    public:
+        unsigned int captures = 0;
+        unsigned int skipped = 0; // every buffer was still in flight
+
+        void init(){
+            glGenFramebuffers(1, &fbo);
+            glGenTextures(1, &texture);
+            glGenBuffers(HIZ_READBACK_FRAMES, pbos);
+            glGenVertexArrays(1, &emptyVAO);
+            for(unsigned int i = 0; i < HIZ_READBACK_FRAMES; i++)
+                frames[i].fence = 0;
+        }
+
+        void release(){
+            if(fbo == 0)
+                return;
+            for(unsigned int i = 0; i < HIZ_READBACK_FRAMES; i++){
+                if(frames[i].fence)
+                    glDeleteSync(frames[i].fence);
+                frames[i].fence = 0;
+            }
+            glDeleteFramebuffers(1, &fbo);
+            glDeleteTextures(1, &texture);
+            glDeleteBuffers(HIZ_READBACK_FRAMES, pbos);
+            glDeleteVertexArrays(1, &emptyVAO);
+            fbo = 0;
+        }
+
+        // reduceShader is shaders/fullscreen.vs + shaders/hiz.fs with depthTexture on unit 0
+        void capture(GLuint depthTexture, int screenWidth, int screenHeight, const glm::mat4& viewProjection, bool reversedZ, Shader& reduceShader){
+            Frame& frame = frames[slot];
+            if(frame.fence){
+                skipped++;
+                return;
+            }
+
+            int footprint = (screenWidth + HIZ_READBACK_WIDTH - 1) / HIZ_READBACK_WIDTH;
+            int w = (screenWidth + footprint - 1) / footprint;
+            int h = (screenHeight + footprint - 1) / footprint;
+            if(w != width || h != height){
+                width = w;
+                height = h;
+                glBindTexture(GL_TEXTURE_2D, texture);
+                glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, w, h, 0, GL_RED, GL_FLOAT, NULL);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+                glBindTexture(GL_TEXTURE_2D, 0);
+                glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+                glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
+            }
+
+            glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+            glViewport(0, 0, w, h);
+            GLboolean depthTest = glIsEnabled(GL_DEPTH_TEST);
+            GLboolean blend = glIsEnabled(GL_BLEND);
+            glDisable(GL_DEPTH_TEST);
+            glDisable(GL_BLEND);
+
+            reduceShader.use();
+            reduceShader.setInt("footprint", footprint);
+            reduceShader.setBool("reversedZ", reversedZ);
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D, depthTexture);
+            glBindVertexArray(emptyVAO);
+            glDrawArrays(GL_TRIANGLES, 0, 3);
+            glBindVertexArray(0);
+
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, pbos[slot]);
+            glBufferData(GL_PIXEL_PACK_BUFFER, w * h * sizeof(float), NULL, GL_STREAM_READ);
+            glReadPixels(0, 0, w, h, GL_RED, GL_FLOAT, (void*)0);
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+            frame.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            frame.width = w;
+            frame.height = h;
+            frame.uvScale = glm::vec2(screenWidth / (float)footprint, screenHeight / (float)footprint);
+            frame.viewProjection = viewProjection;
+            frame.reversedZ = reversedZ;
+            slot = (slot + 1) % HIZ_READBACK_FRAMES;
+            captures++;
+
+            if(depthTest)
+                glEnable(GL_DEPTH_TEST);
+            if(blend)
+                glEnable(GL_BLEND);
+        }
+
+        // never waits, rebuilds hiz from the newest capture the gpu finished and returns whether there was one
+        bool fetch(HiZBuffer& hiz){
+            int newest = -1;
+            for(unsigned int i = 0; i < HIZ_READBACK_FRAMES; i++){
+                unsigned int s = (slot + i) % HIZ_READBACK_FRAMES; //oldest first
+                if(!frames[s].fence)
+                    continue;
+                if(glClientWaitSync(frames[s].fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+                    break;
+                glDeleteSync(frames[s].fence);
+                frames[s].fence = 0;
+                newest = (int)s;
+            }
+            if(newest < 0)
+                return false;
+
+            const Frame& frame = frames[newest];
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, pbos[newest]);
+            const float* depth = (const float*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, frame.width * frame.height * sizeof(float), GL_MAP_READ_BIT);
+            if(depth){
+                hiz.build(depth, frame.width, frame.height, frame.uvScale, frame.viewProjection, frame.reversedZ);
+                glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+            }
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+            return depth != nullptr;
+        }
+
+    private:
+        struct Frame {
+            GLsync fence;
+            int width;
+            int height;
+            glm::vec2 uvScale;
+            glm::mat4 viewProjection;
+            bool reversedZ;
+        };
+
+        unsigned int fbo = 0;
+        unsigned int texture = 0;
+        unsigned int emptyVAO = 0;
+        GLuint pbos[HIZ_READBACK_FRAMES];
+        Frame frames[HIZ_READBACK_FRAMES];
+        unsigned int slot = 0;
+        int width = 0;
+        int height = 0;
+};
+
+#endif
@@ -0,0 +1,131 @@
+#ifndef OIT_H
+#define OIT_H
+
+#include <glad/glad.h>
+
+#include "shader.h"
+
+#include <iostream>
+
+// Weighted blended order independent transparency (McGuire & Bavoil 2013).
+// Instead of sorting and blending back to front, every transparent fragment adds its premultiplied color times a
+// depth based weight into an accumulation target and multiplies its (1 - alpha) into a revealage value, in any
+// order. A fullscreen composite then divides the sum by the summed weights and lays it over the opaque image with
+// 1 - revealage as coverage. Exact for a single layer, an approximation (nearer layers win through the weight)
+// for several, but it never flickers when objects intersect or swap order and costs no cpu sort.
+//
+// 3.3 has no per target blend functions (glBlendFunci is 4.0), so both targets share
+// glBlendFuncSeparate(ONE, ONE, ZERO, ONE_MINUS_SRC_ALPHA):
+//   target 0 (RGBA16F): rgb += color * alpha * weight, a = a * (1 - alpha)  -> accumulated color, revealage
+//   target 1 (R16F):    r += alpha * weight                                  -> summed weight
+// shaders/oit.fs writes them, shaders/oitComposite.fs resolves them.
+//
+// usage: resize() with the scene target every frame -> begin() -> transparent draws -> composite()
+class WeightedOIT {
+    public:
+        unsigned int fbo = 0;
+        unsigned int accumulation = 0; // GL_RGBA16F
+        unsigned int weights = 0;      // GL_R16F
+        int width = 0;
+        int height = 0;
+
+        // depthStencil is the opaque pass' depth texture, transparent fragments are depth tested against it
+        bool create(int w, int h, unsigned int depthStencil){
+            width = w;
+            height = h;
+            glGenFramebuffers(1, &fbo);
+            glGenTextures(1, &accumulation);
+            glGenTextures(1, &weights);
+            glGenVertexArrays(1, &emptyVAO);
+            allocate();
+
+            glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, accumulation, 0);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, weights, 0);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, depthStencil, 0);
+            const GLenum buffers[2] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1};
+            glDrawBuffers(2, buffers);
+            GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+            if(status != GL_FRAMEBUFFER_COMPLETE){
+                std::cout << "ERROR::OIT::INCOMPLETE 0x" << std::hex << status << std::dec << std::endl;
+                return false;
+            }
+            return true;
+        }
+
+        // the depth texture keeps its name when RenderTarget resizes, so only our own targets need new storage
+        void resize(int w, int h){
+            if(w == width && h == height)
+                return;
+            if(w <= 0 || h <= 0)
+                return;
+            width = w;
+            height = h;
+            allocate();
+        }
+
+        // binds the targets, clears them and sets the blend/depth state for the transparent draws
+        void begin(){
+            glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+            glViewport(0, 0, width, height);
+            const float clearAccumulation[4] = {0.0f, 0.0f, 0.0f, 1.0f}; //alpha is revealage, nothing covers yet
+            const float clearWeights[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+            glClearBufferfv(GL_COLOR, 0, clearAccumulation);
+            glClearBufferfv(GL_COLOR, 1, clearWeights);
+
+            glEnable(GL_BLEND);
+            glBlendFuncSeparate(GL_ONE, GL_ONE, GL_ZERO, GL_ONE_MINUS_SRC_ALPHA);
+            glDepthMask(GL_FALSE); //tested against the opaque depth but they must not hide each other
+        }
+
+        // draws over target (already bound by the caller, e.g. RenderTarget::bind()) and restores the usual
+        // alpha blending and depth writes. compositeShader is shaders/fullscreen.vs + shaders/oitComposite.fs
+        void composite(Shader& compositeShader){
+            glDepthMask(GL_TRUE);
+            GLboolean depthTest = glIsEnabled(GL_DEPTH_TEST);
+            glDisable(GL_DEPTH_TEST);
+            glBlendFunc(GL_ONE_MINUS_SRC_ALPHA, GL_SRC_ALPHA); //the shader outputs revealage as alpha
+
+            compositeShader.use();
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D, accumulation);
+            glActiveTexture(GL_TEXTURE1);
+            glBindTexture(GL_TEXTURE_2D, weights);
+            glBindVertexArray(emptyVAO);
+            glDrawArrays(GL_TRIANGLES, 0, 3);
+            glBindVertexArray(0);
+            glActiveTexture(GL_TEXTURE0);
+
+            glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+            if(depthTest)
+                glEnable(GL_DEPTH_TEST);
+        }
+
+        void release(){
+            if(fbo == 0)
+                return;
+            glDeleteFramebuffers(1, &fbo);
+            glDeleteTextures(1, &accumulation);
+            glDeleteTextures(1, &weights);
+            glDeleteVertexArrays(1, &emptyVAO);
+            fbo = accumulation = weights = emptyVAO = 0;
+        }
+
+    private:
+        unsigned int emptyVAO = 0;
+
+        void allocate(){
+            glBindTexture(GL_TEXTURE_2D, accumulation);
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, width, height, 0, GL_RGBA, GL_HALF_FLOAT, NULL);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+            glBindTexture(GL_TEXTURE_2D, weights);
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_R16F, width, height, 0, GL_RED, GL_HALF_FLOAT, NULL);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+            glBindTexture(GL_TEXTURE_2D, 0);
+        }
+};
+
+#endif
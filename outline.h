@@ -0,0 +1,251 @@
+#ifndef OUTLINE_H
+#define OUTLINE_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include "ecs.h"
+#include "indirect.h"
+#include "occlusion.h"
+#include "render_target.h"
+#include "scene.h"
+#include "shader.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+// entities that can be outlined, only the ones with selected set are. Only the render thread writes it (see the
+// ownership list in simulation.h), so it can flip it while the simulation runs
+struct Selectable {
+    bool selected;
+};
+
+#define OUTLINE_NO_SEED 0xFFFF
+
+// Selection outline with a screen space jump flood.
+// The selected meshes are drawn once more, but only into the stencil (shaderSingleColor with color writes off).
+// Everything after that is fullscreen work inside the selection's screen rectangle: the stencilled pixels become
+// seeds that store their own position, a few jump flood passes (steps k, k/2, .. 1) spread the nearest seed
+// position to the pixels around them, and the composite draws the outline color wherever the nearest seed is
+// closer than thickness, outside the stencil. So a 100k triangle mesh costs one stencil draw, not one per
+// outline layer or a scaled second copy, and the width is exact in pixels whatever the distance.
+// The seed targets are RG16UI, positions are exact up to 65534 pixels.
+//
+// usage: create() with the scene's depth/stencil, resize() every frame, draw() with the scene target bound
+// after the scene is done
+class SelectionOutline {
+    public:
+        float thickness = 4.0f; // pixels
+        glm::vec3 color = glm::vec3(0.04f, 0.28f, 0.26f); // the one in shaders/shaderSingleColor.fs
+
+        // last draw()
+        unsigned int selectedCount = 0;
+        unsigned int jumpPasses = 0;
+
+        // depthStencil is the scene's depth/stencil texture, the seed pass tests the mask in it
+        bool create(int w, int h, unsigned int depthStencil){
+            width = w;
+            height = h;
+            glGenFramebuffers(2, fbo);
+            glGenTextures(2, seeds);
+            glGenVertexArrays(1, &emptyVAO);
+            allocate();
+
+            for(unsigned int i = 0; i < 2; i++){
+                glBindFramebuffer(GL_FRAMEBUFFER, fbo[i]);
+                glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, seeds[i], 0);
+                //only the seed pass needs the stencil, the jump passes never test it
+                if(i == 0)
+                    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, depthStencil, 0);
+                GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+                if(status != GL_FRAMEBUFFER_COMPLETE){
+                    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+                    std::cout << "ERROR::OUTLINE::INCOMPLETE 0x" << std::hex << status << std::dec << std::endl;
+                    return false;
+                }
+            }
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+            return true;
+        }
+
+        void resize(int w, int h){
+            if(w == width && h == height)
+                return;
+            if(w <= 0 || h <= 0)
+                return;
+            width = w;
+            height = h;
+            allocate();
+        }
+
+        // maskShader:      shaders/shaderSingleColor.vs + .fs, per draw model uniform
+        // seedShader:      shaders/fullscreen.vs + shaders/outlineSeed.fs
+        // jumpShader:      shaders/fullscreen.vs + shaders/jumpFlood.fs
+        // compositeShader: shaders/fullscreen.vs + shaders/outline.fs
+        // the stencil is cleared and left with the mask, the depth test is left on
+        void draw(World& world, const MeshPool& pool, const glm::mat4& view, const glm::mat4& projection, RenderTarget& target,
+            Shader& maskShader, Shader& seedShader, Shader& jumpShader, Shader& compositeShader){
+            selectedCount = 0;
+            jumpPasses = 0;
+            masks.clear();
+            world.each<WorldTransform, MeshRenderer, Selectable>([&](Entity, WorldTransform& transform, MeshRenderer& renderer, Selectable& selectable){
+                if(selectable.selected)
+                    masks.push_back({renderer.mesh, transform.matrix});
+            });
+            if(masks.empty())
+                return;
+            selectedCount = (unsigned int)masks.size();
+
+            int rect[4];
+            if(!screenRect(pool, projection * view, rect))
+                return;
+
+            //1. stencil mask of the selected meshes, depth test off so hidden parts still get outlined
+            glDisable(GL_DEPTH_TEST);
+            glDepthMask(GL_FALSE);
+            glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+            glEnable(GL_STENCIL_TEST);
+            glStencilMask(0xFF);
+            glClear(GL_STENCIL_BUFFER_BIT);
+            glStencilFunc(GL_ALWAYS, 1, 0xFF);
+            glStencilOp(GL_KEEP, GL_KEEP, GL_REPLACE);
+            maskShader.use();
+            maskShader.setMat4("view", view);
+            maskShader.setMat4("projection", projection);
+            glBindVertexArray(pool.VAO);
+            for(unsigned int i = 0; i < masks.size(); i++){
+                const PoolMesh& mesh = pool.meshes[masks[i].mesh];
+                maskShader.setMat4("model", masks[i].model);
+                glDrawElementsBaseVertex(GL_TRIANGLES, mesh.indexCount, GL_UNSIGNED_INT,
+                    (void*)(mesh.firstIndex * sizeof(unsigned int)), mesh.baseVertex);
+            }
+            glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+
+            //from here on only the selection's rectangle is touched
+            glEnable(GL_SCISSOR_TEST);
+            glScissor(rect[0], rect[1], rect[2], rect[3]);
+            glDisable(GL_BLEND);
+            glBindVertexArray(emptyVAO);
+
+            //2. every stencilled pixel stores its own position, the rest nothing
+            glBindFramebuffer(GL_FRAMEBUFFER, fbo[0]);
+            glViewport(0, 0, width, height);
+            const GLuint noSeed[4] = {OUTLINE_NO_SEED, OUTLINE_NO_SEED, 0, 0};
+            glClearBufferuiv(GL_COLOR, 0, noSeed);
+            glStencilFunc(GL_EQUAL, 1, 0xFF);
+            glStencilOp(GL_KEEP, GL_KEEP, GL_KEEP);
+            seedShader.use();
+            glDrawArrays(GL_TRIANGLES, 0, 3);
+            glDisable(GL_STENCIL_TEST);
+
+            //3. jump flood, steps k .. 1 reach up to 2k - 1 pixels
+            int step = 1;
+            while(2 * step - 1 < (int)std::ceil(thickness))
+                step *= 2;
+            unsigned int source = 0;
+            jumpShader.use();
+            //outside the rectangle the targets hold old frames, the lookups must not reach there
+            jumpShader.setVec4("bounds", (float)rect[0], (float)rect[1], (float)(rect[0] + rect[2]), (float)(rect[1] + rect[3]));
+            glActiveTexture(GL_TEXTURE0);
+            for(; step >= 1; step /= 2){
+                glBindFramebuffer(GL_FRAMEBUFFER, fbo[1 - source]);
+                glBindTexture(GL_TEXTURE_2D, seeds[source]);
+                jumpShader.setInt("step", step);
+                glDrawArrays(GL_TRIANGLES, 0, 3);
+                source = 1 - source;
+                jumpPasses++;
+            }
+
+            //4. outline color around the seeds, never on the selected pixels themselves
+            target.bind();
+            glEnable(GL_BLEND);
+            glEnable(GL_STENCIL_TEST);
+            glStencilFunc(GL_NOTEQUAL, 1, 0xFF);
+            compositeShader.use();
+            compositeShader.setFloat("thickness", thickness);
+            compositeShader.setVec3("color", color);
+            glBindTexture(GL_TEXTURE_2D, seeds[source]);
+            glDrawArrays(GL_TRIANGLES, 0, 3);
+            glBindVertexArray(0);
+
+            glDisable(GL_STENCIL_TEST);
+            glDisable(GL_SCISSOR_TEST);
+            glDepthMask(GL_TRUE);
+            glEnable(GL_DEPTH_TEST);
+        }
+
+        void release(){
+            if(emptyVAO == 0)
+                return;
+            glDeleteFramebuffers(2, fbo);
+            glDeleteTextures(2, seeds);
+            glDeleteVertexArrays(1, &emptyVAO);
+            emptyVAO = 0;
+        }
+
+    private:
+        struct Mask {
+            unsigned int mesh;
+            glm::mat4 model;
+        };
+
+        unsigned int fbo[2] = {0, 0};
+        unsigned int seeds[2] = {0, 0}; // GL_RG16UI, nearest seed position per pixel
+        unsigned int emptyVAO = 0;
+        int width = 0;
+        int height = 0;
+        std::vector<Mask> masks;
+
+        void allocate(){
+            for(unsigned int i = 0; i < 2; i++){
+                glBindTexture(GL_TEXTURE_2D, seeds[i]);
+                glTexImage2D(GL_TEXTURE_2D, 0, GL_RG16UI, width, height, 0, GL_RG_INTEGER, GL_UNSIGNED_SHORT, NULL);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST); //integer textures can't filter
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+            }
+            glBindTexture(GL_TEXTURE_2D, 0);
+        }
+
+        // pixel rectangle (x, y, w, h) around the selected bounds plus the outline, the whole target when a box
+        // reaches behind the camera. false when it's entirely off screen
+        bool screenRect(const MeshPool& pool, const glm::mat4& viewProjection, int* rect){
+            glm::vec2 lo(1e30f);
+            glm::vec2 hi(-1e30f);
+            bool behind = false;
+            for(unsigned int i = 0; i < masks.size() && !behind; i++){
+                const PoolMesh& mesh = pool.meshes[masks[i].mesh];
+                glm::vec3 boxMin, boxMax;
+                transformBounds(mesh.boundsMin, mesh.boundsMax, masks[i].model, boxMin, boxMax);
+                for(int c = 0; c < 8; c++){
+                    glm::vec4 clip = viewProjection * glm::vec4(c & 1 ? boxMax.x : boxMin.x, c & 2 ? boxMax.y : boxMin.y, c & 4 ? boxMax.z : boxMin.z, 1.0f);
+                    if(clip.w <= 0.0f){
+                        behind = true;
+                        break;
+                    }
+                    glm::vec2 ndc = glm::clamp(glm::vec2(clip.x / clip.w, clip.y / clip.w), glm::vec2(-4.0f), glm::vec2(4.0f));
+                    lo = glm::min(lo, ndc);
+                    hi = glm::max(hi, ndc);
+                }
+            }
+            int x0 = 0, y0 = 0, x1 = width, y1 = height;
+            if(!behind){
+                int margin = (int)std::ceil(thickness) + 1;
+                x0 = std::max((int)std::floor((lo.x * 0.5f + 0.5f) * width) - margin, 0);
+                y0 = std::max((int)std::floor((lo.y * 0.5f + 0.5f) * height) - margin, 0);
+                x1 = std::min((int)std::ceil((hi.x * 0.5f + 0.5f) * width) + margin, width);
+                y1 = std::min((int)std::ceil((hi.y * 0.5f + 0.5f) * height) + margin, height);
+            }
+            if(x1 <= x0 || y1 <= y0)
+                return false;
+            rect[0] = x0;
+            rect[1] = y0;
+            rect[2] = x1 - x0;
+            rect[3] = y1 - y0;
+            return true;
+        }
+};
+
+#endif
@@ -0,0 +1,514 @@
+#ifndef RENDER_GRAPH_H
+#define RENDER_GRAPH_H
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+// Frame graph: the passes of a frame are declared with the textures they read and write, then compiled and run.
+// compile()
+//  - culls: walking back from the output, a pass survives only if something later (or the output) reads what it
+//    writes. Passes writing a texture in place (the transparent pass on top of the opaque one) all stay.
+//  - orders: dependencies come from the declaration order, a read must have an earlier writer or be imported,
+//    anything else is reported and the graph doesn't run.
+//  - aliases: transient textures (createTexture) only live from their first to their last use, two of the same
+//    size and format whose lifetimes don't overlap get the same gl texture. The textures and the framebuffers
+//    over them are kept between frames, so a graph rebuilt every frame allocates nothing once it settled.
+// Imported textures (the scene target, the window) are owned by someone else and never aliased.
+// dump() prints the compiled graph and how much memory the transients take with and without aliasing.
+//
+// usage, every frame:
+//   graph.reset();
+//   RenderGraph::Handle color = graph.importTexture("sceneColor", sceneTarget.color, w, h, GL_RGBA16F);
+//   RenderGraph::Handle bright = graph.createTexture("bloomBright", w / 2, h / 2, GL_R11F_G11F_B10F);
+//   graph.addPass("bloomBright", {color}, {bright}, [&](){ ... glBindTexture(GL_TEXTURE_2D, graph.texture(color)) ... });
+//   graph.setOutput(...);
+//   if(graph.compile())
+//       graph.execute();
+// a pass runs with a framebuffer over its writes bound (colors in order, a depth format as the depth attachment)
+// and the viewport set to the first of them, it can still bind anything else itself. A pass whose framebuffer is
+// incomplete is reported once, when that framebuffer is made, and skipped by execute() for as long as it stays cached
+class RenderGraph {
+    public:
+        typedef unsigned int Handle;
+        typedef std::function<void()> Execute;
+
+        void reset(){
+            resources.clear();
+            passes.clear();
+            order.clear();
+            output = ~0u;
+            compiled = false;
+        }
+
+        Handle importTexture(const std::string& name, unsigned int texture, int width, int height, GLenum format){
+            Resource resource = makeResource(name, width, height, format);
+            resource.imported = true;
+            resource.texture = texture;
+            resources.push_back(resource);
+            return (Handle)resources.size() - 1;
+        }
+
+        // the default framebuffer, a pass writing it can't write anything else
+        Handle importBackbuffer(const std::string& name, int width, int height){
+            Resource resource = makeResource(name, width, height, GL_RGBA8);
+            resource.imported = true;
+            resource.external = true;
+            resources.push_back(resource);
+            return (Handle)resources.size() - 1;
+        }
+
+        // a texture its pass renders into through its own framebuffers (layers of an array, faces of a cube), the
+        // graph only orders and culls around it. Like the backbuffer it has to be the pass's only write, the pass
+        // runs with the default framebuffer bound
+        Handle importExternal(const std::string& name, unsigned int texture, int width, int height, GLenum format){
+            Resource resource = makeResource(name, width, height, format);
+            resource.imported = true;
+            resource.external = true;
+            resource.texture = texture;
+            resources.push_back(resource);
+            return (Handle)resources.size() - 1;
+        }
+
+        Handle createTexture(const std::string& name, int width, int height, GLenum format){
+            resources.push_back(makeResource(name, std::max(width, 1), std::max(height, 1), format));
+            return (Handle)resources.size() - 1;
+        }
+
+        void addPass(const std::string& name, const std::vector<Handle>& reads, const std::vector<Handle>& writes, Execute execute){
+            Pass pass;
+            pass.name = name;
+            pass.reads = reads;
+            pass.writes = writes;
+            pass.execute = execute;
+            passes.push_back(pass);
+        }
+
+        void setOutput(Handle handle){
+            output = handle;
+        }
+
+        // gl texture behind a handle, valid after compile()
+        unsigned int texture(Handle handle) const{
+            return resources[handle].texture;
+        }
+
+        bool compile(){
+            compiled = false;
+            if(output >= resources.size()){
+                std::cout << "ERROR::RENDER_GRAPH::NO_OUTPUT" << std::endl;
+                return false;
+            }
+
+            //cull, back to front
+            std::vector<bool> needed(resources.size(), false);
+            needed[output] = true;
+            for(int p = (int)passes.size() - 1; p >= 0; p--){
+                Pass& pass = passes[p];
+                pass.alive = false;
+                for(Handle write : pass.writes)
+                    pass.alive = pass.alive || needed[write];
+                if(pass.alive){
+                    for(Handle read : pass.reads)
+                        needed[read] = true;
+                }
+            }
+
+            //order and check that every read has something to read
+            order.clear();
+            std::vector<bool> written(resources.size(), false);
+            for(unsigned int p = 0; p < passes.size(); p++){
+                if(!passes[p].alive)
+                    continue;
+                for(Handle read : passes[p].reads){
+                    if(!written[read] && !resources[read].imported){
+                        std::cout << "ERROR::RENDER_GRAPH::READ_BEFORE_WRITE " << passes[p].name << " reads " << resources[read].name << std::endl;
+                        return false;
+                    }
+                }
+                for(Handle write : passes[p].writes)
+                    written[write] = true;
+                order.push_back(p);
+            }
+
+            //lifetimes of the transients, in positions of order
+            for(Resource& resource : resources){
+                resource.firstUse = -1;
+                resource.lastUse = -1;
+            }
+            for(unsigned int i = 0; i < order.size(); i++){
+                const Pass& pass = passes[order[i]];
+                for(Handle read : pass.reads)
+                    use(resources[read], (int)i);
+                for(Handle write : pass.writes)
+                    use(resources[write], (int)i);
+            }
+
+            allocateTransients();
+
+            //a framebuffer per pass over what it writes
+            for(unsigned int i = 0; i < order.size(); i++){
+                Pass& pass = passes[order[i]];
+                pass.fbo = 0;
+                pass.skip = false;
+                pass.width = 0;
+                pass.height = 0;
+                if(pass.writes.empty())
+                    continue;
+                const Resource& first = resources[pass.writes[0]];
+                pass.width = first.width;
+                pass.height = first.height;
+                if(first.external)
+                    continue;
+                if(!framebufferFor(pass))
+                    return false;
+            }
+            compiled = true;
+            return true;
+        }
+
+        void execute(){
+            if(!compiled)
+                return;
+            for(unsigned int i = 0; i < order.size(); i++){
+                Pass& pass = passes[order[i]];
+                if(pass.skip)
+                    continue;
+                glBindFramebuffer(GL_FRAMEBUFFER, pass.fbo);
+                if(pass.width > 0)
+                    glViewport(0, 0, pass.width, pass.height);
+                pass.execute();
+            }
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        }
+
+        // transient memory of the compiled graph, every texture on its own vs what is actually allocated
+        size_t transientBytes() const{
+            size_t bytes = 0;
+            for(const Resource& resource : resources){
+                if(!resource.imported && resource.firstUse >= 0)
+                    bytes += textureBytes(resource.width, resource.height, resource.format);
+            }
+            return bytes;
+        }
+
+        size_t aliasedBytes() const{
+            size_t bytes = 0;
+            for(const Physical& physical : physicals)
+                bytes += textureBytes(physical.width, physical.height, physical.format);
+            return bytes;
+        }
+
+        std::string dump() const{
+            std::string text;
+            char line[256];
+            std::snprintf(line, sizeof(line), "render graph: %u passes, %u culled\n", (unsigned int)passes.size(), (unsigned int)(passes.size() - order.size()));
+            text += line;
+            for(unsigned int i = 0; i < order.size(); i++){
+                const Pass& pass = passes[order[i]];
+                std::snprintf(line, sizeof(line), "  %2u %-14s %s -> %s%s\n", i, pass.name.c_str(), names(pass.reads).c_str(), names(pass.writes).c_str(),
+                    pass.skip ? "  skipped, incomplete framebuffer" : "");
+                text += line;
+            }
+            for(const Pass& pass : passes){
+                if(!pass.alive){
+                    std::snprintf(line, sizeof(line), "  -- %-14s culled\n", pass.name.c_str());
+                    text += line;
+                }
+            }
+            text += "resources:\n";
+            for(const Resource& resource : resources){
+                if(resource.imported){
+                    std::snprintf(line, sizeof(line), "  %-14s %5dx%-5d %-16s imported\n", resource.name.c_str(), resource.width, resource.height, formatName(resource.format));
+                }else if(resource.firstUse < 0){
+                    std::snprintf(line, sizeof(line), "  %-14s %5dx%-5d %-16s unused\n", resource.name.c_str(), resource.width, resource.height, formatName(resource.format));
+                }else{
+                    std::snprintf(line, sizeof(line), "  %-14s %5dx%-5d %-16s %6.2f MB  passes %d-%d  texture %d\n", resource.name.c_str(), resource.width, resource.height,
+                        formatName(resource.format), textureBytes(resource.width, resource.height, resource.format) / (1024.0 * 1024.0), resource.firstUse, resource.lastUse, resource.physical);
+                }
+                text += line;
+            }
+            std::snprintf(line, sizeof(line), "transient memory: %.2f MB without aliasing, %.2f MB in %u textures\n",
+                transientBytes() / (1024.0 * 1024.0), aliasedBytes() / (1024.0 * 1024.0), (unsigned int)physicals.size());
+            text += line;
+            return text;
+        }
+
+        void release(){
+            for(std::map<std::vector<unsigned int>, unsigned int>::iterator it = framebuffers.begin(); it != framebuffers.end(); ++it)
+                glDeleteFramebuffers(1, &it->second);
+            framebuffers.clear();
+            incomplete.clear();
+            for(Physical& physical : physicals)
+                glDeleteTextures(1, &physical.texture);
+            physicals.clear();
+            reset();
+        }
+
+    private:
+        struct Resource {
+            std::string name;
+            int width;
+            int height;
+            GLenum format;
+            bool imported;
+            bool external; // the backbuffer or importExternal(), the pass binds it itself
+            unsigned int texture;
+            int firstUse;
+            int lastUse;
+            int physical; // index into physicals, transients only
+        };
+
+        struct Pass {
+            std::string name;
+            std::vector<Handle> reads;
+            std::vector<Handle> writes;
+            Execute execute;
+            bool alive = false;
+            bool skip = false; // its framebuffer is incomplete
+            unsigned int fbo = 0;
+            int width = 0;
+            int height = 0;
+        };
+
+        // a gl texture transients are placed in, kept between frames
+        struct Physical {
+            int width;
+            int height;
+            GLenum format;
+            unsigned int texture;
+            int busyUntil; // last use of the transient currently in it, this compile
+            bool used;
+        };
+
+        std::vector<Resource> resources;
+        std::vector<Pass> passes;
+        std::vector<unsigned int> order; // alive passes, in execution order
+        std::vector<Physical> physicals;
+        std::map<std::vector<unsigned int>, unsigned int> framebuffers; // attachments -> fbo
+        std::set<unsigned int> incomplete; // cached fbos glCheckFramebufferStatus rejected, already reported
+        Handle output = ~0u;
+        bool compiled = false;
+
+        static Resource makeResource(const std::string& name, int width, int height, GLenum format){
+            Resource resource;
+            resource.name = name;
+            resource.width = width;
+            resource.height = height;
+            resource.format = format;
+            resource.imported = false;
+            resource.external = false;
+            resource.texture = 0;
+            resource.firstUse = -1;
+            resource.lastUse = -1;
+            resource.physical = -1;
+            return resource;
+        }
+
+        static void use(Resource& resource, int position){
+            if(resource.firstUse < 0)
+                resource.firstUse = position;
+            resource.lastUse = position;
+        }
+
+        static bool isDepth(GLenum format){
+            return format == GL_DEPTH32F_STENCIL8 || format == GL_DEPTH24_STENCIL8 || format == GL_DEPTH_COMPONENT32F
+                || format == GL_DEPTH_COMPONENT24 || format == GL_DEPTH_COMPONENT16;
+        }
+
+        static bool hasStencil(GLenum format){
+            return format == GL_DEPTH32F_STENCIL8 || format == GL_DEPTH24_STENCIL8;
+        }
+
+        static size_t bytesPerPixel(GLenum format){
+            switch(format){
+                case GL_RGBA16F:            return 8;
+                case GL_DEPTH32F_STENCIL8:  return 8;
+                case GL_RG16F:              return 4;
+                case GL_R16F:               return 2;
+                case GL_DEPTH_COMPONENT16:  return 2;
+                case GL_DEPTH_COMPONENT24:  return 4;
+                default:                    return 4; // RGBA8, R11F_G11F_B10F, DEPTH24_STENCIL8, DEPTH_COMPONENT32F
+            }
+        }
+
+        static size_t textureBytes(int width, int height, GLenum format){
+            return (size_t)width * (size_t)height * bytesPerPixel(format);
+        }
+
+        static const char* formatName(GLenum format){
+            switch(format){
+                case GL_RGBA8:              return "RGBA8";
+                case GL_RGBA16F:            return "RGBA16F";
+                case GL_R11F_G11F_B10F:     return "R11F_G11F_B10F";
+                case GL_RG16F:              return "RG16F";
+                case GL_R16F:               return "R16F";
+                case GL_DEPTH32F_STENCIL8:  return "DEPTH32F_STENCIL8";
+                case GL_DEPTH24_STENCIL8:   return "DEPTH24_STENCIL8";
+                case GL_DEPTH_COMPONENT32F: return "DEPTH32F";
+                case GL_DEPTH_COMPONENT24:  return "DEPTH24";
+                case GL_DEPTH_COMPONENT16:  return "DEPTH16";
+                default:                    return "?";
+            }
+        }
+
+        std::string names(const std::vector<Handle>& handles) const{
+            if(handles.empty())
+                return "-";
+            std::string text;
+            for(unsigned int i = 0; i < handles.size(); i++){
+                if(i > 0)
+                    text += ", ";
+                text += resources[handles[i]].name;
+            }
+            return text;
+        }
+
+        // first fit over the kept textures by first use, new ones only when nothing of the right size is free
+        void allocateTransients(){
+            for(Physical& physical : physicals){
+                physical.busyUntil = -1;
+                physical.used = false;
+            }
+            std::vector<Handle> transients;
+            for(unsigned int i = 0; i < resources.size(); i++){
+                if(!resources[i].imported && resources[i].firstUse >= 0)
+                    transients.push_back(i);
+            }
+            std::stable_sort(transients.begin(), transients.end(), [this](Handle a, Handle b){
+                return resources[a].firstUse < resources[b].firstUse;
+            });
+            for(Handle handle : transients){
+                Resource& resource = resources[handle];
+                int found = -1;
+                for(unsigned int p = 0; p < physicals.size() && found < 0; p++){
+                    const Physical& physical = physicals[p];
+                    if(physical.width == resource.width && physical.height == resource.height && physical.format == resource.format
+                        && physical.busyUntil < resource.firstUse)
+                        found = (int)p;
+                }
+                if(found < 0){
+                    physicals.push_back(createPhysical(resource.width, resource.height, resource.format));
+                    found = (int)physicals.size() - 1;
+                }
+                physicals[found].busyUntil = resource.lastUse;
+                physicals[found].used = true;
+                resource.physical = found;
+            }
+
+            //whatever this frame didn't need goes, along with every framebuffer that might point at it
+            bool removed = false;
+            for(unsigned int p = 0; p < physicals.size(); p++){
+                if(!physicals[p].used){
+                    glDeleteTextures(1, &physicals[p].texture);
+                    removed = true;
+                }
+            }
+            if(removed){
+                std::vector<Physical> kept;
+                std::vector<int> remap(physicals.size(), -1);
+                for(unsigned int p = 0; p < physicals.size(); p++){
+                    if(physicals[p].used){
+                        remap[p] = (int)kept.size();
+                        kept.push_back(physicals[p]);
+                    }
+                }
+                physicals = kept;
+                for(Handle handle : transients)
+                    resources[handle].physical = remap[resources[handle].physical];
+                for(std::map<std::vector<unsigned int>, unsigned int>::iterator it = framebuffers.begin(); it != framebuffers.end(); ++it)
+                    glDeleteFramebuffers(1, &it->second);
+                framebuffers.clear();
+            }
+            for(Handle handle : transients)
+                resources[handle].texture = physicals[resources[handle].physical].texture;
+        }
+
+        static Physical createPhysical(int width, int height, GLenum format){
+            Physical physical;
+            physical.width = width;
+            physical.height = height;
+            physical.format = format;
+            physical.busyUntil = -1;
+            physical.used = false;
+            GLenum pixelFormat = GL_RGBA;
+            GLenum type = GL_UNSIGNED_BYTE;
+            switch(format){
+                case GL_RGBA16F:            type = GL_HALF_FLOAT; break;
+                case GL_R11F_G11F_B10F:     pixelFormat = GL_RGB; type = GL_FLOAT; break;
+                case GL_RG16F:              pixelFormat = GL_RG; type = GL_HALF_FLOAT; break;
+                case GL_R16F:               pixelFormat = GL_RED; type = GL_HALF_FLOAT; break;
+                case GL_DEPTH32F_STENCIL8:  pixelFormat = GL_DEPTH_STENCIL; type = GL_FLOAT_32_UNSIGNED_INT_24_8_REV; break;
+                case GL_DEPTH24_STENCIL8:   pixelFormat = GL_DEPTH_STENCIL; type = GL_UNSIGNED_INT_24_8; break;
+                case GL_DEPTH_COMPONENT32F:
+                case GL_DEPTH_COMPONENT24:
+                case GL_DEPTH_COMPONENT16:  pixelFormat = GL_DEPTH_COMPONENT; type = GL_FLOAT; break;
+                default: break;
+            }
+            glGenTextures(1, &physical.texture);
+            glBindTexture(GL_TEXTURE_2D, physical.texture);
+            glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, pixelFormat, type, NULL);
+            GLint filter = isDepth(format) ? GL_NEAREST : GL_LINEAR;
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            glBindTexture(GL_TEXTURE_2D, 0);
+            return physical;
+        }
+
+        // false only for a pass that can't have a framebuffer at all, an incomplete one just marks the pass skipped
+        bool framebufferFor(Pass& pass){
+            std::vector<unsigned int> key;
+            for(Handle write : pass.writes){
+                if(resources[write].external){
+                    std::cout << "ERROR::RENDER_GRAPH::EXTERNAL_WITH_TEXTURES " << pass.name << std::endl;
+                    return false;
+                }
+                key.push_back(resources[write].texture);
+            }
+            std::map<std::vector<unsigned int>, unsigned int>::iterator found = framebuffers.find(key);
+            if(found != framebuffers.end()){
+                pass.fbo = found->second;
+                pass.skip = incomplete.count(pass.fbo) > 0;
+                return true;
+            }
+
+            glGenFramebuffers(1, &pass.fbo);
+            glBindFramebuffer(GL_FRAMEBUFFER, pass.fbo);
+            std::vector<GLenum> drawBuffers;
+            for(Handle write : pass.writes){
+                const Resource& resource = resources[write];
+                GLenum attachment;
+                if(isDepth(resource.format)){
+                    attachment = hasStencil(resource.format) ? GL_DEPTH_STENCIL_ATTACHMENT : GL_DEPTH_ATTACHMENT;
+                }else{
+                    attachment = GL_COLOR_ATTACHMENT0 + (GLenum)drawBuffers.size();
+                    drawBuffers.push_back(attachment);
+                }
+                glFramebufferTexture2D(GL_FRAMEBUFFER, attachment, GL_TEXTURE_2D, resource.texture, 0);
+            }
+            if(drawBuffers.empty())
+                glDrawBuffer(GL_NONE);
+            else
+                glDrawBuffers((GLsizei)drawBuffers.size(), drawBuffers.data());
+            GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+            framebuffers[key] = pass.fbo;
+            if(status != GL_FRAMEBUFFER_COMPLETE){
+                std::cout << "ERROR::RENDER_GRAPH::INCOMPLETE " << pass.name << " 0x" << std::hex << status << std::dec << std::endl;
+                incomplete.insert(pass.fbo);
+                pass.skip = true;
+            }
+            return true;
+        }
+};
+
+#endif
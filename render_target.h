@@ -0,0 +1,97 @@
+#ifndef RENDER_TARGET_H
+#define RENDER_TARGET_H
+
+#include <glad/glad.h>
+
+#include <iostream>
+
+// Offscreen framebuffer the scene is drawn into, the render graph's post passes take it to the window from there
+// (blitToScreen() does it without any).
+// The default framebuffer's depth format is whatever the platform hands out (almost always 24 bit unorm), owning
+// the target gets us a GL_DEPTH32F_STENCIL8 depth/stencil that reversed-Z needs, and both attachments are
+// textures so later passes can sample them. Color is half float so lighting can go past 1, the post passes in
+// main.cpp (bloom, tonemap) bring it back into range.
+//
+// usage: create(w, h) once, resize() from the framebuffer size every frame (no-op if unchanged), bind() ->
+// draw -> post passes or blitToScreen()
+class RenderTarget {
+    public:
+        unsigned int fbo = 0;
+        unsigned int color = 0;        // GL_RGBA16F texture
+        unsigned int depthStencil = 0; // GL_DEPTH32F_STENCIL8 texture
+        int width = 0;
+        int height = 0;
+
+        bool create(int w, int h){
+            width = w;
+            height = h;
+            glGenFramebuffers(1, &fbo);
+            glGenTextures(1, &color);
+            glGenTextures(1, &depthStencil);
+            allocate();
+
+            glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, color, 0);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, depthStencil, 0);
+            GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+            if(status != GL_FRAMEBUFFER_COMPLETE){
+                std::cout << "ERROR::RENDER_TARGET::INCOMPLETE 0x" << std::hex << status << std::dec << std::endl;
+                return false;
+            }
+            return true;
+        }
+
+        // reallocates the attachments in place, the fbo keeps pointing at the same texture names
+        void resize(int w, int h){
+            if(w == width && h == height)
+                return;
+            if(w <= 0 || h <= 0)
+                return;
+            width = w;
+            height = h;
+            allocate();
+        }
+
+        void bind(){
+            glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+            glViewport(0, 0, width, height);
+        }
+
+        // color only, the window's depth buffer is never used
+        void blitToScreen(int screenWidth, int screenHeight){
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, fbo);
+            glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+            glBlitFramebuffer(0, 0, width, height, 0, 0, screenWidth, screenHeight, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        }
+
+        void release(){
+            if(fbo == 0)
+                return;
+            glDeleteFramebuffers(1, &fbo);
+            glDeleteTextures(1, &color);
+            glDeleteTextures(1, &depthStencil);
+            fbo = color = depthStencil = 0;
+        }
+
+    private:
+        void allocate(){
+            glBindTexture(GL_TEXTURE_2D, color);
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, width, height, 0, GL_RGBA, GL_HALF_FLOAT, NULL);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+            glBindTexture(GL_TEXTURE_2D, depthStencil);
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH32F_STENCIL8, width, height, 0, GL_DEPTH_STENCIL, GL_FLOAT_32_UNSIGNED_INT_24_8_REV, NULL);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            glBindTexture(GL_TEXTURE_2D, 0);
+        }
+};
+
+#endif
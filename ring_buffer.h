@@ -0,0 +1,163 @@
+#ifndef RING_BUFFER_H
+#define RING_BUFFER_H
+
+#include <glad/glad.h>
+
+#include "gl_ext.h"
+
+#include <cstdint>
+#include <iostream>
+
+// a piece of the ring that is only valid for the frame it was allocated in
+struct RingAllocation {
+    void* ptr;         // where the cpu writes (nullptr if the ring ran out of space)
+    GLuint buffer;     // buffer object to bind for drawing
+    GLintptr offset;   // byte offset of ptr inside buffer
+    GLsizeiptr size;
+};
+
+// Triple buffered streaming buffer for data that changes every frame (instance transforms, particles, ui...).
+// The buffer is split into FRAMES regions, each frame writes into its own region while the gpu is still
+// reading the previous ones. A fence is placed at the end of every frame and we only wait on it when we
+// wrap back around to that region, so normally the cpu never stalls.
+//
+// With ARB_buffer_storage the whole buffer is mapped once (persistent + coherent) and allocations are just
+// pointer bumps. On plain 3.3 we map the region with GL_MAP_UNSYNCHRONIZED_BIT instead (the fences already do
+// the synchronization) and unmap it in flush(), since a 3.3 buffer can't be drawn from while it's mapped.
+//
+// usage per frame: beginFrame() -> allocate()... -> flush() -> draw -> endFrame()
+class RingBuffer {
+    public:
+        static const unsigned int FRAMES = 3;
+
+        unsigned int buffer;
+        bool persistent;
+
+        // number of times beginFrame() actually had to wait for the gpu (the ring is too small or the gpu is behind)
+        unsigned int stalls = 0;
+
+        RingBuffer(GLsizeiptr frameSize) : frameSize(frameSize){
+            GLsizeiptr totalSize = frameSize * FRAMES;
+            persistent = glExt.bufferStorage;
+
+            glGenBuffers(1, &buffer);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+            if(persistent){
+                GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+                glExt.BufferStorage(GL_COPY_WRITE_BUFFER, totalSize, NULL, flags);
+                base = (uint8_t*)glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, totalSize, flags);
+                if(base == nullptr){
+                    std::cout << "ERROR::RING_BUFFER::PERSISTENT_MAP_FAILED" << std::endl;
+                    persistent = false;
+                    //immutable storage can't be resized, so start over with a mutable buffer
+                    glDeleteBuffers(1, &buffer);
+                    glGenBuffers(1, &buffer);
+                    glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+                }
+            }
+            if(!persistent){
+                glBufferData(GL_COPY_WRITE_BUFFER, totalSize, NULL, GL_STREAM_DRAW);
+            }
+            glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+            for(unsigned int i = 0; i < FRAMES; i++)
+                fences[i] = 0;
+        }
+
+        // like the other gl objects in this repo nothing is freed automatically, call this before glfwTerminate()
+        void release(){
+            if(buffer == 0)
+                return;
+            for(unsigned int i = 0; i < FRAMES; i++){
+                if(fences[i])
+                    glDeleteSync(fences[i]);
+                fences[i] = 0;
+            }
+            if(persistent){
+                glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+                glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+                glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+            }
+            glDeleteBuffers(1, &buffer);
+            buffer = 0;
+        }
+
+        RingBuffer(const RingBuffer&) = delete;
+        RingBuffer& operator=(const RingBuffer&) = delete;
+
+        // wait until the gpu is done with the region we are about to overwrite
+        void beginFrame(){
+            if(fences[frame]){
+                GLenum result = glClientWaitSync(fences[frame], 0, 0);
+                if(result == GL_TIMEOUT_EXPIRED){
+                    stalls++;
+                    //first wait flushes so the fence is guaranteed to eventually signal
+                    do {
+                        result = glClientWaitSync(fences[frame], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000); //1ms
+                    } while(result == GL_TIMEOUT_EXPIRED);
+                }
+                glDeleteSync(fences[frame]);
+                fences[frame] = 0;
+            }
+            head = frame * frameSize;
+        }
+
+        // alignment has to be a power of two, use GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT for ubo ranges
+        RingAllocation allocate(GLsizeiptr size, GLsizeiptr alignment = 16){
+            RingAllocation allocation = {nullptr, buffer, 0, size};
+            GLintptr offset = (head + alignment - 1) & ~(GLintptr)(alignment - 1);
+            GLintptr frameEnd = (frame + 1) * frameSize;
+            if(offset + size > frameEnd){
+                std::cout << "ERROR::RING_BUFFER::OUT_OF_SPACE requested " << size << " bytes" << std::endl;
+                return allocation;
+            }
+
+            if(!persistent && mapped == nullptr){
+                //map everything that is left in this frame's region, we never read so the old contents can go
+                glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+                mapped = (uint8_t*)glMapBufferRange(GL_COPY_WRITE_BUFFER, offset, frameEnd - offset,
+                    GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_FLUSH_EXPLICIT_BIT);
+                glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+                mapOffset = offset;
+                if(mapped == nullptr){
+                    std::cout << "ERROR::RING_BUFFER::MAP_FAILED" << std::endl;
+                    return allocation;
+                }
+            }
+
+            allocation.ptr = persistent ? base + offset : mapped + (offset - mapOffset);
+            allocation.offset = offset;
+            head = offset + size;
+            return allocation;
+        }
+
+        // make everything allocated so far visible to the gpu, must be called before drawing from the allocations
+        void flush(){
+            if(persistent || mapped == nullptr)
+                return;
+            glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+            glFlushMappedBufferRange(GL_COPY_WRITE_BUFFER, 0, head - mapOffset);
+            glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+            mapped = nullptr;
+        }
+
+        // fence the region once every draw that reads from it has been submitted
+        void endFrame(){
+            flush();
+            fences[frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            frame = (frame + 1) % FRAMES;
+        }
+
+    private:
+        GLsizeiptr frameSize;
+        unsigned int frame = 0;
+        GLintptr head = 0;
+        GLsync fences[FRAMES];
+
+        uint8_t* base = nullptr;     // persistent mapping of the whole buffer
+        uint8_t* mapped = nullptr;   // fallback mapping of [mapOffset, end of frame region)
+        GLintptr mapOffset = 0;
+};
+
+#endif
@@ -0,0 +1,172 @@
+#ifndef SCENE_H
+#define SCENE_H
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "ecs.h"
+#include "indirect.h"
+#include "jobs.h"
+#include "shader.h"
+#include "simd_math.h"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+// Components of the scene and the systems that run over them, see ecs.h for the storage.
+// An entity is whatever set of these it has: a cube is Transform + WorldTransform + MeshRenderer, a window is
+// Transform + WorldTransform + Transparent, a lamp is Transform + WorldTransform + Light (+ MeshRenderer if it
+// should be visible). With a Simulation running, Transform belongs to the simulation thread and the render side
+// only reads WorldTransform, see simulation.h.
+
+struct Transform {
+    glm::vec3 position;
+    glm::quat rotation;
+    glm::vec3 scale;
+};
+
+// written by Simulation::interpolate() (or updateWorldTransforms() without a simulation) from Transform,
+// everything that draws reads this one
+struct WorldTransform {
+    glm::mat4 matrix;
+};
+
+// opaque geometry out of a MeshPool, drawn through a DrawList
+struct MeshRenderer {
+    unsigned int mesh;
+    unsigned int material;
+};
+
+// point light at the entity's position, same parameters as PointLight in shaders/include/lighting.glsl
+struct Light {
+    glm::vec3 ambient;
+    glm::vec3 diffuse;
+    glm::vec3 specular;
+    float constant;
+    float linear;
+    float quadratic;
+};
+
+// blended quads drawn back to front after the opaque pass
+struct Transparent {
+    unsigned int texture;
+};
+
+inline Transform makeTransform(glm::vec3 position, glm::vec3 scale = glm::vec3(1.0f))
+{
+    return {position, glm::quat(1.0f, glm::vec3(0.0f)), scale};
+}
+
+// attenuation from the learnopengl table, 0.09/0.032 reaches about 50 units
+inline Light makePointLight(glm::vec3 color, float linear = 0.09f, float quadratic = 0.032f)
+{
+    return {color * 0.0625f, color, glm::vec3(1.0f), 1.0f, linear, quadratic};
+}
+
+inline glm::mat4 worldMatrix(const Transform& transform)
+{
+    glm::mat4 matrix = glm::mat4_cast(transform.rotation);
+    matrix[0] *= transform.scale.x;
+    matrix[1] *= transform.scale.y;
+    matrix[2] *= transform.scale.z;
+    matrix[3] = glm::vec4(transform.position, 1.0f);
+    return matrix;
+}
+
+// blend between two simulation ticks, t = 0 is a. Parts that didn't change between the ticks are copied, mix/slerp
+// of two equal values is off by an ulp for most t, and the world matrix of a resting object has to stay exactly
+// the same from frame to frame (the shadow cache hashes it)
+inline Transform interpolateTransform(const Transform& a, const Transform& b, float t)
+{
+    return {a.position == b.position ? a.position : glm::mix(a.position, b.position, t),
+            a.rotation == b.rotation ? a.rotation : glm::slerp(a.rotation, b.rotation, t),
+            a.scale == b.scale ? a.scale : glm::mix(a.scale, b.scale, t)};
+}
+
+// worldMatrix() for a whole array, 4 at a time through simdComposeTRS4
+inline void composeWorldMatrices(const Transform* transforms, WorldTransform* worlds, unsigned int count)
+{
+    static_assert(sizeof(WorldTransform) == sizeof(glm::mat4), "WorldTransform arrays are written as mat4 arrays");
+    unsigned int i = 0;
+    for(; i + 4 <= count; i += 4){
+        //px py pz qx qy qz qw sx sy sz, one lane per transform
+        float soa[10][4];
+        for(unsigned int k = 0; k < 4; k++){
+            const Transform& transform = transforms[i + k];
+            soa[0][k] = transform.position.x;
+            soa[1][k] = transform.position.y;
+            soa[2][k] = transform.position.z;
+            soa[3][k] = transform.rotation.x;
+            soa[4][k] = transform.rotation.y;
+            soa[5][k] = transform.rotation.z;
+            soa[6][k] = transform.rotation.w;
+            soa[7][k] = transform.scale.x;
+            soa[8][k] = transform.scale.y;
+            soa[9][k] = transform.scale.z;
+        }
+        simdComposeTRS4(soa[0], soa[1], soa[2], soa[3], soa[4], soa[5], soa[6], soa[7], soa[8], soa[9], (glm::mat4*)(worlds + i));
+    }
+    for(; i < count; i++)
+        worlds[i].matrix = worldMatrix(transforms[i]);
+}
+
+// chunks are spread over the job system, the inner loop only touches two packed arrays
+inline void updateWorldTransforms(World& world)
+{
+    std::vector<Chunk*> chunks = world.chunks<Transform, WorldTransform>();
+    jobSystem.parallelFor((unsigned int)chunks.size(), 1, [&chunks](unsigned int begin, unsigned int end){
+        for(unsigned int c = begin; c < end; c++){
+            composeWorldMatrices(chunks[c]->get<Transform>(), chunks[c]->get<WorldTransform>(), chunks[c]->count);
+        }
+    });
+}
+
+// the first maxLights lights go into pointLights[], the rest are switched off
+inline void setPointLights(World& world, Shader& shader, unsigned int maxLights)
+{
+    unsigned int index = 0;
+    world.each<WorldTransform, Light>([&](Entity, WorldTransform& transform, Light& light){
+        if(index >= maxLights)
+            return;
+        std::string name = "pointLights[" + std::to_string(index++) + "].";
+        shader.setVec3(name + "position", glm::vec3(transform.matrix[3]));
+        shader.setVec3(name + "ambient", light.ambient);
+        shader.setVec3(name + "diffuse", light.diffuse);
+        shader.setVec3(name + "specular", light.specular);
+        shader.setFloat(name + "constant", light.constant);
+        shader.setFloat(name + "linear", light.linear);
+        shader.setFloat(name + "quadratic", light.quadratic);
+    });
+    for(; index < maxLights; index++){
+        std::string name = "pointLights[" + std::to_string(index) + "].";
+        shader.setVec3(name + "ambient", glm::vec3(0.0f));
+        shader.setVec3(name + "diffuse", glm::vec3(0.0f));
+        shader.setVec3(name + "specular", glm::vec3(0.0f));
+        shader.setFloat(name + "constant", 1.0f);
+    }
+}
+
+struct TransparentDraw {
+    float distance;
+    glm::mat4 model;
+    unsigned int texture;
+};
+
+// farthest first, blending needs them in that order. Order independent transparency doesn't, it skips the sort
+inline void collectTransparent(World& world, const glm::vec3& cameraPosition, std::vector<TransparentDraw>& draws, bool backToFront = true)
+{
+    draws.clear();
+    world.eachChunk<WorldTransform, Transparent>([&](unsigned int count, const Entity*, WorldTransform* worlds, Transparent* transparent){
+        for(unsigned int i = 0; i < count; i++)
+            draws.push_back({glm::length(cameraPosition - glm::vec3(worlds[i].matrix[3])), worlds[i].matrix, transparent[i].texture});
+    });
+    if(!backToFront)
+        return;
+    std::sort(draws.begin(), draws.end(), [](const TransparentDraw& a, const TransparentDraw& b){
+        return a.distance > b.distance;
+    });
+}
+
+#endif
@@ -2,85 +2,121 @@
 #define SHADER_H
 
 #include <glad/glad.h> // include glad to get all the required OpenGL headers
+
+#include <glm/glm.hpp>
+
+#include "gl_ext.h"
+#include "gl_worker.h"
   
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
 #include <string>
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <functional>
+#include <map>
+#include <vector>
   
 
+// compiled programs are kept in cache/shaders (see glGetProgramBinary), delete the folder to force a full rebuild
+#define SHADER_CACHE_DIR "cache/shaders"
+#define SHADER_CACHE_VERSION 1
+
+// "NAME" or "NAME VALUE", each one becomes a #define line right after #version
+typedef std::vector<std::string> ShaderDefines;
+
+// Started by main when the driver has no KHR_parallel_shader_compile: shaders are then compiled on this thread's
+// shared context instead, so the render thread still only waits when a program is actually used.
+inline GLWorkerThread shaderCompileThread;
+
+class ShaderReloader;
+
 class Shader
 {
 public:
     // the program ID
     unsigned int shaderProgram;
+
+    // true if the program came out of the binary cache instead of being compiled
+    bool loadedFromCache = false;
+
+    // valid after finish()
+    bool linked = false;
+
+    // where the program came from, ShaderReloader rebuilds it from these when one of the files changes
+    std::string vertexPath;
+    std::string fragmentPath;
+    ShaderDefines defines;
+    bool useCache;
+    std::vector<std::string> sourceFiles; //both stages plus everything they #include
   
-    // constructor reads and builds the shader
-    Shader(const char* vertexPath, const char* fragmentPath)
-    {
-        // 1. retrieve the vertex/fragment source code from filePath
-        std::string vertexCode;
-        std::string fragmentCode;
-        std::ifstream vShaderFile;
-        std::ifstream fShaderFile;
-        // ensure ifstream objects can throw exceptions:
-        vShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
-        fShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
+    // constructor reads the sources and starts building the shader, it doesn't wait for the compile to finish.
+    // Create every shader up front so the driver (or shaderCompileThread) can work on all of them at once, the
+    // first use() waits for the result. Call use() or finish() before anything else touches shaderProgram.
+    // sources can #include "file" (relative to the including file, every file at most once) and get the defines
+    // inserted after #version, so one source file can be compiled into several specialized programs
+    Shader(const char* vertexPath, const char* fragmentPath, const ShaderDefines& defines = ShaderDefines(), bool useCache = true)
+        : shaderProgram(0), vertexPath(vertexPath), fragmentPath(fragmentPath), defines(defines), useCache(useCache)
+    {
+        // 1. retrieve the vertex/fragment source code from filePath, the cache key is built from the expanded result
+        std::string vertexCode = preprocess(vertexPath, defines, sourceFiles);
+        std::string fragmentCode = preprocess(fragmentPath, defines, sourceFiles);
+        start(vertexCode, fragmentCode);
+    };
 
-        try 
-        {
-            // open files
-            vShaderFile.open(vertexPath);
-            fShaderFile.open(fragmentPath);
-            std::stringstream vShaderStream, fShaderStream;
-            // read file's buffer contents into streams
-            vShaderStream << vShaderFile.rdbuf();
-            fShaderStream << fShaderFile.rdbuf();		
-            // close file handlers
-            vShaderFile.close();
-            fShaderFile.close();
-            // convert stream into string
-            vertexCode   = vShaderStream.str();
-            fragmentCode = fShaderStream.str();		
-        }
-        catch(std::ifstream::failure e)
-        {
-            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
+    // true once finish() won't block, never blocks itself
+    bool ready()
+    {
+        if(!pending)
+            return true;
+        if(workerResult.valid())
+            return workerResult.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+        if(glExt.parallelShaderCompile){
+            GLint done = 0;
+            glGetProgramiv(shaderProgram, GL_COMPLETION_STATUS_KHR, &done);
+            return done != 0;
         }
+        return true; //no way to ask without blocking, the driver may still be compiling in the background
+    }
 
-        const char* vShaderCode = vertexCode.c_str();
-        const char* fShaderCode = fragmentCode.c_str();
-
-        unsigned int vertexShader, fragmentShader;
+    // waits for the compile, reports errors and stores the binary in the cache
+    void finish()
+    {
+        if(!pending)
+            return;
+        pending = false;
 
-        // once again need to create shader object
-        vertexShader = glCreateShader(GL_VERTEX_SHADER);
+        if(workerResult.valid()){
+            BuiltProgram built = workerResult.get();
+            shaderProgram = built.program;
+            loadedFromCache = built.fromCache;
+            linked = built.linked;
+            workerResult = std::shared_future<BuiltProgram>();
+            return;
+        }
 
-        //attach shader to shader object
-        glShaderSource(vertexShader, 1, &vShaderCode, NULL);
-        glCompileShader(vertexShader);
         checkCompileErrors(vertexShader, "VERTEX");
-
-        //create another shader object for fragment shadder
-        fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-        glShaderSource(fragmentShader, 1, &fShaderCode, NULL);//attach source to fragment shader
-        glCompileShader(fragmentShader);
         checkCompileErrors(fragmentShader, "FRAGMENT");
-
-        //create a shader program object to link shader to the next shader
-        shaderProgram = glCreateProgram();
-        glAttachShader(shaderProgram, vertexShader);
-        glAttachShader(shaderProgram, fragmentShader);
-        glLinkProgram(shaderProgram);
-        checkCompileErrors(shaderProgram, "PROGRAM");
+        linked = checkCompileErrors(shaderProgram, "PROGRAM");
 
         //delete shaders after you linking success
+        glDetachShader(shaderProgram, vertexShader);
+        glDetachShader(shaderProgram, fragmentShader);
         glDeleteShader(vertexShader);
         glDeleteShader(fragmentShader);  
-    };
+
+        if(linked && !cachePath.empty())
+            saveBinary(cachePath, cacheKey);
+    }
 
     // use/activate the shader
     void use(){
+        if(pending)
+            finish();
         glUseProgram(shaderProgram);
     };
 
@@ -144,9 +180,220 @@ public:
 
 
 private:
+    friend class ShaderReloader;
+
+    struct BuiltProgram {
+        unsigned int program;
+        bool fromCache;
+        bool linked;
+    };
+
+    // state of a build that has been started but not finished
+    bool pending = false;
+    unsigned int vertexShader = 0, fragmentShader = 0;
+    std::string cachePath;
+    uint64_t cacheKey = 0;
+    std::shared_future<BuiltProgram> workerResult;
+
+    Shader() : shaderProgram(0), useCache(true) {}
+
+    // kicks off the build on shaderCompileThread if it runs, on this thread otherwise
+    void start(const std::string& vertexCode, const std::string& fragmentCode)
+    {
+        if(shaderCompileThread.running()){
+            bool cache = useCache;
+            workerResult = shaderCompileThread.submit([vertexCode, fragmentCode, cache](){
+                Shader shader;
+                shader.build(vertexCode, fragmentCode, cache);
+                shader.finish();
+                return BuiltProgram{shader.shaderProgram, shader.loadedFromCache, shader.linked};
+            }).share();
+            pending = true;
+        }else{
+            build(vertexCode, fragmentCode, useCache);
+        }
+    }
+
+    static std::string readFile(const char* path)
+    {
+        std::ifstream shaderFile;
+        // ensure ifstream objects can throw exceptions:
+        shaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
+        try 
+        {
+            // open file and read its buffer contents into a stream
+            shaderFile.open(path);
+            std::stringstream shaderStream;
+            shaderStream << shaderFile.rdbuf();
+            shaderFile.close();
+            return shaderStream.str();
+        }
+        catch(std::ifstream::failure& e)
+        {
+            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ " << path << std::endl;
+        }
+        return "";
+    }
+
+    // files gets every file that went into the result appended
+    static std::string preprocess(const std::string& path, const ShaderDefines& defines, std::vector<std::string>& files)
+    {
+        std::vector<std::string> included;
+        std::string source = expandIncludes(path, included);
+        files.insert(files.end(), included.begin(), included.end());
+
+        std::string defineLines;
+        for(unsigned int i = 0; i < defines.size(); i++)
+            defineLines += "#define " + defines[i] + "\n";
+        size_t versionEnd = source.find('\n', source.find("#version"));
+        if(defineLines.empty() || versionEnd == std::string::npos)
+            return source;
+        //#line keeps the line numbers in compile errors the same as in the file
+        return source.substr(0, versionEnd + 1) + defineLines + "#line 2\n" + source.substr(versionEnd + 1);
+    }
+
+    static std::string expandIncludes(const std::string& path, std::vector<std::string>& included)
+    {
+        included.push_back(path);
+        std::string directory = path.substr(0, path.find_last_of("/\\") + 1);
+
+        std::stringstream input(readFile(path.c_str()));
+        std::string output, line;
+        int lineNumber = 0;
+        while(std::getline(input, line)){
+            lineNumber++;
+            size_t start = line.find_first_not_of(" \t");
+            if(start == std::string::npos || line.compare(start, 8, "#include") != 0){
+                output += line + "\n";
+                continue;
+            }
+
+            size_t open = line.find('"', start);
+            size_t close = line.find('"', open + 1);
+            if(open == std::string::npos || close == std::string::npos){
+                std::cout << "ERROR::SHADER::BAD_INCLUDE " << path << ":" << lineNumber << std::endl;
+                continue;
+            }
+            std::string includePath = directory + line.substr(open + 1, close - open - 1);
+            bool seen = false;
+            for(unsigned int i = 0; i < included.size(); i++)
+                seen = seen || included[i] == includePath;
+            if(!seen)
+                output += "#line 1\n" + expandIncludes(includePath, included) + "#line " + std::to_string(lineNumber + 1) + "\n";
+        }
+        return output;
+    }
+
+    void build(const std::string& vertexCode, const std::string& fragmentCode, bool useCache)
+    {
+        // 2. a driver update or different gpu invalidates every binary, so the driver strings are part of the key
+        if(useCache && glExt.programBinary){
+            std::string driver = std::string((const char*)glGetString(GL_VENDOR)) + (const char*)glGetString(GL_RENDERER) + (const char*)glGetString(GL_VERSION);
+            cacheKey = hashString(vertexCode);
+            cacheKey = hashString(fragmentCode, cacheKey);
+            cacheKey = hashString(driver, cacheKey);
+            char name[32];
+            std::snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long)cacheKey);
+            cachePath = std::string(SHADER_CACHE_DIR) + "/" + name;
+
+            shaderProgram = glCreateProgram();
+            if(loadBinary(cachePath, cacheKey)){
+                loadedFromCache = true;
+                linked = true;
+                return;
+            }
+            glDeleteProgram(shaderProgram);
+        }
+
+        // 3. compile and link, no status queries here since every query waits for the compiler, finish() does them
+        const char* vShaderCode = vertexCode.c_str();
+        const char* fShaderCode = fragmentCode.c_str();
+
+        // once again need to create shader object
+        vertexShader = glCreateShader(GL_VERTEX_SHADER);
+
+        //attach shader to shader object
+        glShaderSource(vertexShader, 1, &vShaderCode, NULL);
+        glCompileShader(vertexShader);
+
+        //create another shader object for fragment shadder
+        fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
+        glShaderSource(fragmentShader, 1, &fShaderCode, NULL);//attach source to fragment shader
+        glCompileShader(fragmentShader);
+
+        //create a shader program object to link shader to the next shader
+        shaderProgram = glCreateProgram();
+        glAttachShader(shaderProgram, vertexShader);
+        glAttachShader(shaderProgram, fragmentShader);
+        if(!cachePath.empty())
+            glExt.ProgramParameteri(shaderProgram, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+        glLinkProgram(shaderProgram);
+        pending = true;
+    }
+
+    // header in front of every cached binary
+    struct BinaryHeader {
+        uint32_t magic;   // 'LOGS'
+        uint32_t version; // SHADER_CACHE_VERSION
+        uint64_t key;     // has to match the file name, catches truncated/renamed files
+        uint32_t format;  // driver specific binary format
+        uint32_t length;
+    };
+
+    static uint64_t hashString(const std::string& text, uint64_t hash = 14695981039346656037ull)
+    {
+        //FNV-1a
+        for(unsigned char c : text){
+            hash ^= c;
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+
+    bool loadBinary(const std::string& path, uint64_t key)
+    {
+        std::ifstream file(path, std::ios::binary);
+        if(!file)
+            return false;
+        BinaryHeader header;
+        if(!file.read((char*)&header, sizeof(header)) || header.magic != 0x53474F4C || header.version != SHADER_CACHE_VERSION || header.key != key)
+            return false;
+        std::vector<char> binary(header.length);
+        if(!file.read(binary.data(), binary.size()))
+            return false;
+
+        //the driver can still refuse a binary (it is allowed to after any update), we just compile again in that case
+        glExt.ProgramBinary(shaderProgram, header.format, binary.data(), (GLsizei)binary.size());
+        int success = 0;
+        glGetProgramiv(shaderProgram, GL_LINK_STATUS, &success);
+        return success != 0;
+    }
+
+    void saveBinary(const std::string& path, uint64_t key)
+    {
+        GLint length = 0;
+        glGetProgramiv(shaderProgram, GL_PROGRAM_BINARY_LENGTH, &length);
+        if(length <= 0)
+            return;
+        std::vector<char> binary(length);
+        GLenum format = 0;
+        glExt.GetProgramBinary(shaderProgram, length, NULL, &format, binary.data());
+
+        std::error_code error;
+        std::filesystem::create_directories(SHADER_CACHE_DIR, error);
+        std::ofstream file(path, std::ios::binary);
+        if(!file){
+            std::cout << "ERROR::SHADER::CANNOT_WRITE_CACHE " << path << std::endl;
+            return;
+        }
+        BinaryHeader header = {0x53474F4C, SHADER_CACHE_VERSION, key, format, (uint32_t)length};
+        file.write((const char*)&header, sizeof(header));
+        file.write(binary.data(), binary.size());
+    }
+
     // utility function for checking shader compilation/linking errors.
     // ------------------------------------------------------------------------
-    void checkCompileErrors(unsigned int shader, std::string type)
+    bool checkCompileErrors(unsigned int shader, std::string type)
     {
         int success;
         char infoLog[1024];
@@ -168,7 +415,77 @@ private:
                 std::cout << "ERROR::PROGRAM_LINKING_ERROR of type: " << type << "\n" << infoLog << "\n -- --------------------------------------------------- -- " << std::endl;
             }
         }
+        return success != 0;
+    }
+};
+  
+// Compiles permutations of one vertex/fragment pair on demand and keeps them around, so features can be
+// compiled out of the programs that don't need them instead of being branched on per fragment.
+// onBuild runs once for every variant the first time get() returns it (sampler units, uniform block bindings, ...).
+class ShaderVariants
+{
+public:
+    std::function<void(Shader&)> onBuild;
+
+    ShaderVariants(const std::string& vertexPath, const std::string& fragmentPath)
+        : vertexPath(vertexPath), fragmentPath(fragmentPath) {}
+
+    // the order of the defines doesn't matter, {"A", "B"} and {"B", "A"} are the same variant
+    Shader& get(const ShaderDefines& defines)
+    {
+        Variant& variant = start(defines);
+        if(!variant.setup){
+            variant.setup = true;
+            if(onBuild)
+                onBuild(variant.shader);
+        }
+        return variant.shader;
+    }
+
+    // starts compiling every listed variant without waiting for any of them, call it at load time for the
+    // variants a scene will need so switching to one later doesn't stall a frame
+    void prepare(const std::vector<ShaderDefines>& variantDefines)
+    {
+        for(unsigned int i = 0; i < variantDefines.size(); i++)
+            start(variantDefines[i]);
+    }
+
+    unsigned int count() const
+    {
+        return (unsigned int)variants.size();
+    }
+
+    void release()
+    {
+        for(std::map<std::string, Variant>::iterator it = variants.begin(); it != variants.end(); ++it){
+            it->second.shader.finish();
+            glDeleteProgram(it->second.shader.shaderProgram);
+        }
+        variants.clear();
+    }
+
+private:
+    struct Variant {
+        Shader shader;
+        bool setup;
+    };
+
+    std::string vertexPath;
+    std::string fragmentPath;
+    std::map<std::string, Variant> variants;
+
+    Variant& start(ShaderDefines defines)
+    {
+        std::sort(defines.begin(), defines.end());
+        std::string key;
+        for(unsigned int i = 0; i < defines.size(); i++)
+            key += defines[i] + ";";
+
+        std::map<std::string, Variant>::iterator it = variants.find(key);
+        if(it == variants.end())
+            it = variants.emplace(key, Variant{Shader(vertexPath.c_str(), fragmentPath.c_str(), defines), false}).first;
+        return it->second;
     }
 };
   
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,300 @@
+#ifndef SHADER_RELOAD_H
+#define SHADER_RELOAD_H
+
+#include <glad/glad.h>
+
+#include "shader.h"
+
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+// Shader hot reload: save a .vs/.fs (or anything they #include) and every Shader built from it is rebuilt.
+//  - a background thread waits for changes (inotify on linux, polling the modification times elsewhere)
+//    and reads + preprocesses the new sources, so the render thread never touches the disk
+//  - update() (once per frame, before anything is drawn) starts the compiles and swaps shaderProgram of every
+//    rebuild that finished, so a frame never sees half of a reload
+//  - a rebuild that doesn't compile or link is thrown away and the last good program stays in use
+//
+// usage: start() once, watch() every Shader that should reload, update() every frame, stop() at the end
+class ShaderReloader {
+    public:
+        // statistics
+        unsigned int reloadCount = 0;
+        unsigned int failedCount = 0;
+
+        void start(){
+            if(watcher.joinable())
+                return;
+#ifdef __linux__
+            inotifyFd = inotify_init1(IN_NONBLOCK);
+            if(inotifyFd < 0)
+                std::cout << "ERROR::SHADER_RELOADER::INOTIFY_INIT_FAILED falling back to polling" << std::endl;
+#endif
+            quit = false;
+            watcher = std::thread([this](){ run(); });
+        }
+
+        void stop(){
+            if(!watcher.joinable())
+                return;
+            quit = true;
+            watcher.join();
+#ifdef __linux__
+            if(inotifyFd >= 0)
+                close(inotifyFd);
+            inotifyFd = -1;
+#endif
+            for(unsigned int i = 0; i < watched.size(); i++){
+                if(watched[i]->building){
+                    watched[i]->candidate.finish();
+                    glDeleteProgram(watched[i]->candidate.shaderProgram);
+                }
+            }
+            watched.clear();
+        }
+
+        // onReload runs after every successful swap, for per program state like sampler units and block bindings
+        // (plain uniforms are reset by the relink too, so anything not set every frame belongs in there)
+        void watch(Shader& shader, std::function<void(Shader&)> onReload = nullptr){
+            std::shared_ptr<Watched> entry = std::make_shared<Watched>();
+            entry->shader = &shader;
+            entry->onReload = onReload;
+            entry->files = normalize(shader.sourceFiles);
+            entry->stamps = modificationTimes(entry->files);
+
+            std::lock_guard<std::mutex> lock(mutex);
+            watched.push_back(entry);
+            watchDirectories(entry->files);
+        }
+
+        // render thread, once per frame at the top of the loop
+        void update(){
+            std::vector<std::shared_ptr<Watched>> current;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                current = watched;
+            }
+
+            for(unsigned int i = 0; i < current.size(); i++){
+                Watched& entry = *current[i];
+
+                //new sources from the watcher thread, start compiling them (doesn't wait)
+                std::string vertexCode, fragmentCode;
+                std::vector<std::string> files;
+                bool changed = false;
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    if(entry.sourcesReady && !entry.building){
+                        vertexCode.swap(entry.vertexCode);
+                        fragmentCode.swap(entry.fragmentCode);
+                        files.swap(entry.newFiles);
+                        entry.sourcesReady = false;
+                        changed = true;
+                    }
+                }
+                if(changed){
+                    entry.candidate = Shader();
+                    entry.candidate.vertexPath = entry.shader->vertexPath;
+                    entry.candidate.fragmentPath = entry.shader->fragmentPath;
+                    entry.candidate.defines = entry.shader->defines;
+                    entry.candidate.useCache = entry.shader->useCache;
+                    entry.candidate.sourceFiles = files;
+                    entry.candidate.start(vertexCode, fragmentCode);
+                    entry.building = true;
+                }
+
+                //swap in whatever finished compiling
+                if(entry.building && entry.candidate.ready()){
+                    entry.building = false;
+                    entry.candidate.finish();
+                    if(!entry.candidate.linked){
+                        std::cout << "ERROR::SHADER_RELOADER::RELOAD_FAILED keeping the last good program of " << entry.shader->fragmentPath << std::endl;
+                        glDeleteProgram(entry.candidate.shaderProgram);
+                        failedCount++;
+                        continue;
+                    }
+
+                    entry.shader->finish();
+                    glDeleteProgram(entry.shader->shaderProgram);
+                    entry.shader->shaderProgram = entry.candidate.shaderProgram;
+                    entry.shader->loadedFromCache = false;
+                    entry.shader->sourceFiles = entry.candidate.sourceFiles;
+                    {
+                        //a new #include may have shown up
+                        std::lock_guard<std::mutex> lock(mutex);
+                        entry.files = normalize(entry.shader->sourceFiles);
+                        entry.stamps = modificationTimes(entry.files);
+                        watchDirectories(entry.files);
+                    }
+                    if(entry.onReload)
+                        entry.onReload(*entry.shader);
+                    reloadCount++;
+                    std::cout << "reloaded " << entry.shader->vertexPath << " + " << entry.shader->fragmentPath << std::endl;
+                }
+            }
+        }
+
+    private:
+        struct Watched {
+            Shader* shader;
+            std::function<void(Shader&)> onReload;
+            std::vector<std::string> files; //normalized, watcher thread reads these under the mutex
+            std::vector<std::filesystem::file_time_type> stamps; //only used by the polling fallback
+
+            //handed over from the watcher thread, guarded by the mutex
+            bool sourcesReady = false;
+            std::string vertexCode;
+            std::string fragmentCode;
+            std::vector<std::string> newFiles;
+
+            //render thread only
+            bool building = false;
+            Shader candidate;
+        };
+
+        struct Directory {
+            std::string path;
+            int wd; //inotify watch descriptor
+        };
+
+        std::vector<std::shared_ptr<Watched>> watched;
+        std::vector<Directory> directories;
+        std::mutex mutex;
+        std::thread watcher;
+        std::atomic<bool> quit{false};
+#ifdef __linux__
+        int inotifyFd = -1;
+#endif
+
+        static std::vector<std::string> normalize(const std::vector<std::string>& files){
+            std::vector<std::string> result;
+            for(unsigned int i = 0; i < files.size(); i++)
+                result.push_back(std::filesystem::path(files[i]).lexically_normal().generic_string());
+            return result;
+        }
+
+        static std::vector<std::filesystem::file_time_type> modificationTimes(const std::vector<std::string>& files){
+            std::vector<std::filesystem::file_time_type> stamps;
+            for(unsigned int i = 0; i < files.size(); i++){
+                std::error_code error;
+                stamps.push_back(std::filesystem::last_write_time(files[i], error));
+            }
+            return stamps;
+        }
+
+        // whole directories instead of files, editors often save by writing a new file and renaming it over the old one
+        void watchDirectories(const std::vector<std::string>& files){
+            for(unsigned int i = 0; i < files.size(); i++){
+                std::string directory = std::filesystem::path(files[i]).parent_path().generic_string();
+                if(directory.empty())
+                    directory = ".";
+                bool known = false;
+                for(unsigned int j = 0; j < directories.size() && !known; j++)
+                    known = directories[j].path == directory;
+                if(known)
+                    continue;
+                int wd = -1;
+#ifdef __linux__
+                if(inotifyFd >= 0)
+                    wd = inotify_add_watch(inotifyFd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+#endif
+                directories.push_back({directory, wd});
+            }
+        }
+
+        // watcher thread
+        void run(){
+            while(!quit){
+                std::vector<std::string> changed = waitForChanges();
+                if(changed.empty())
+                    continue;
+
+                //wait for the editor to finish writing, some write the file in several steps
+                std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+                std::vector<std::shared_ptr<Watched>> affected;
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    for(unsigned int i = 0; i < watched.size(); i++){
+                        bool hit = false;
+                        for(unsigned int f = 0; f < watched[i]->files.size() && !hit; f++){
+                            for(unsigned int c = 0; c < changed.size() && !hit; c++)
+                                hit = watched[i]->files[f] == changed[c];
+                        }
+                        if(hit)
+                            affected.push_back(watched[i]);
+                    }
+                }
+
+                //read and preprocess outside of the lock, this is the part that must not happen on the render thread
+                for(unsigned int i = 0; i < affected.size(); i++){
+                    Shader* shader = affected[i]->shader;
+                    std::vector<std::string> files;
+                    std::string vertexCode = Shader::preprocess(shader->vertexPath, shader->defines, files);
+                    std::string fragmentCode = Shader::preprocess(shader->fragmentPath, shader->defines, files);
+
+                    std::lock_guard<std::mutex> lock(mutex);
+                    affected[i]->vertexCode = vertexCode;
+                    affected[i]->fragmentCode = fragmentCode;
+                    affected[i]->newFiles = files;
+                    affected[i]->sourcesReady = true; //a newer save replaces one update() hasn't picked up yet
+                }
+            }
+        }
+
+        // blocks for a short while, returns the normalized paths of changed files
+        std::vector<std::string> waitForChanges(){
+            std::vector<std::string> changed;
+#ifdef __linux__
+            if(inotifyFd >= 0){
+                pollfd descriptor = {inotifyFd, POLLIN, 0};
+                if(poll(&descriptor, 1, 200) <= 0)
+                    return changed;
+
+                alignas(inotify_event) char buffer[4096];
+                ssize_t length;
+                while((length = read(inotifyFd, buffer, sizeof(buffer))) > 0){
+                    for(char* p = buffer; p < buffer + length; p += sizeof(inotify_event) + ((inotify_event*)p)->len){
+                        inotify_event* event = (inotify_event*)p;
+                        if(event->len == 0)
+                            continue;
+                        std::lock_guard<std::mutex> lock(mutex);
+                        for(unsigned int i = 0; i < directories.size(); i++){
+                            if(directories[i].wd == event->wd)
+                                changed.push_back((std::filesystem::path(directories[i].path) / event->name).lexically_normal().generic_string());
+                        }
+                    }
+                }
+                return changed;
+            }
+#endif
+            //polling fallback (macOS, or inotify not available)
+            std::this_thread::sleep_for(std::chrono::milliseconds(250));
+            std::lock_guard<std::mutex> lock(mutex);
+            for(unsigned int i = 0; i < watched.size(); i++){
+                std::vector<std::filesystem::file_time_type> stamps = modificationTimes(watched[i]->files);
+                for(unsigned int f = 0; f < stamps.size() && f < watched[i]->stamps.size(); f++){
+                    if(stamps[f] != watched[i]->stamps[f])
+                        changed.push_back(watched[i]->files[f]);
+                }
+                watched[i]->stamps = stamps;
+            }
+            return changed;
+        }
+};
+
+#endif
@@ -0,0 +1,18 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec2 aTexCoords;
+layout (location = 2) in mat4 aModel; //per instance, takes up locations 2-5
+
+out vec2 TexCoords;
+out float ViewDepth; //distance along the view axis, for the oit weight
+
+uniform mat4 view;
+uniform mat4 projection;
+
+void main()
+{
+    TexCoords = aTexCoords;    
+    vec4 viewPos = view * aModel * vec4(aPos, 1.0);
+    ViewDepth = -viewPos.z;
+    gl_Position = projection * viewPos;
+}
@@ -0,0 +1,22 @@
+#version 330 core
+//bloom, step 1: what is brighter than threshold, at half resolution (the 4 bilinear taps cover the 4x4 texels)
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+uniform sampler2D source;
+uniform float threshold;
+
+void main()
+{
+    vec2 texel = 1.0 / vec2(textureSize(source, 0));
+    vec3 color = 0.25 * (texture(source, TexCoords + vec2(-texel.x, -texel.y)).rgb
+                       + texture(source, TexCoords + vec2( texel.x, -texel.y)).rgb
+                       + texture(source, TexCoords + vec2(-texel.x,  texel.y)).rgb
+                       + texture(source, TexCoords + vec2( texel.x,  texel.y)).rgb);
+    float brightness = max(color.r, max(color.g, color.b));
+    //soft knee so pixels don't pop in and out of the bloom right at the threshold
+    float knee = clamp(brightness - threshold * 0.5, 0.0, threshold);
+    float weight = max(knee * knee / (2.0 * threshold + 1e-4), brightness - threshold) / max(brightness, 1e-4);
+    FragColor = vec4(color * weight, 1.0);
+}
@@ -0,0 +1,22 @@
+#version 330 core
+//one direction of a 9 tap gaussian, 5 fetches thanks to bilinear filtering between the off center taps
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+uniform sampler2D source;
+uniform vec2 direction; //(1, 0) or (0, 1)
+
+const float offsets[3] = float[](0.0, 1.3846153846, 3.2307692308);
+const float weights[3] = float[](0.2270270270, 0.3162162162, 0.0702702703);
+
+void main()
+{
+    vec2 texelStep = direction / vec2(textureSize(source, 0));
+    vec3 color = texture(source, TexCoords).rgb * weights[0];
+    for(int i = 1; i < 3; i++){
+        color += texture(source, TexCoords + texelStep * offsets[i]).rgb * weights[i];
+        color += texture(source, TexCoords - texelStep * offsets[i]).rgb * weights[i];
+    }
+    FragColor = vec4(color, 1.0);
+}
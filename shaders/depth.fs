@@ -1,11 +1,6 @@
 #version 330 core
-out vec4 FragColor;
-
-in vec2 TexCoords;
-
-uniform sampler2D texture1;
+//color writes are off while this runs, the shader is empty and the gpu only writes depth
 
 void main()
-{    
-    FragColor = texture(texture1, TexCoords);
-}
\ No newline at end of file
+{
+}
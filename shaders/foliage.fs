@@ -0,0 +1,22 @@
+#version 330 core
+//permutations:
+//  ALPHA_TO_COVERAGE   the framebuffer is multisampled, alpha becomes the sample mask instead of a discard
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+uniform sampler2D texture1;
+
+void main()
+{
+    vec4 color = texture(texture1, TexCoords);
+#ifdef ALPHA_TO_COVERAGE
+    //sharpen alpha to a ramp about a pixel wide around the cutoff, the edge gets antialiased instead of blurred
+    color.a = clamp((color.a - 0.5) / max(fwidth(color.a), 1e-4) + 0.5, 0.0, 1.0);
+#else
+    if(color.a < 0.5)
+        discard;
+    color.a = 1.0;
+#endif
+    FragColor = color;
+}
@@ -0,0 +1,21 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec2 aTexCoords;
+layout (location = 2) in vec4 aBlade; //per instance, xyz: base position, w: scale
+
+out vec2 TexCoords;
+
+uniform mat4 view;
+uniform mat4 projection;
+
+void main()
+{
+    //yaw from a hash of the position so the blades don't all line up, nothing to store per instance
+    float angle = fract(sin(dot(aBlade.xz, vec2(12.9898, 78.233))) * 43758.5453) * 6.2831853;
+    float s = sin(angle);
+    float c = cos(angle);
+    vec3 local = aPos * aBlade.w;
+    vec3 worldPos = vec3(c * local.x + s * local.z, local.y, c * local.z - s * local.x) + aBlade.xyz;
+    TexCoords = aTexCoords;
+    gl_Position = projection * view * vec4(worldPos, 1.0);
+}
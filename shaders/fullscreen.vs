@@ -0,0 +1,10 @@
+#version 330 core
+//one triangle that covers the whole screen, draw 3 vertices with an empty vao bound
+out vec2 TexCoords;
+
+void main()
+{
+    vec2 corner = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+    TexCoords = corner;
+    gl_Position = vec4(corner * 2.0 - 1.0, 0.0, 1.0);
+}
@@ -0,0 +1,40 @@
+#version 330 core
+//FXAA (the compact variant of Lottes' FXAA): find the edge direction from the luma of the 4 diagonal neighbours
+//and blend along it, pixels with little contrast are left alone
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+uniform sampler2D source;
+
+const float REDUCE_MIN = 1.0 / 128.0;
+const float REDUCE_MUL = 1.0 / 8.0;
+const float SPAN_MAX = 8.0;
+const vec3 LUMA = vec3(0.299, 0.587, 0.114);
+
+void main()
+{
+    vec2 texel = 1.0 / vec2(textureSize(source, 0));
+    vec3 rgbM = texture(source, TexCoords).rgb;
+    float lumaNW = dot(texture(source, TexCoords + vec2(-1.0, -1.0) * texel).rgb, LUMA);
+    float lumaNE = dot(texture(source, TexCoords + vec2( 1.0, -1.0) * texel).rgb, LUMA);
+    float lumaSW = dot(texture(source, TexCoords + vec2(-1.0,  1.0) * texel).rgb, LUMA);
+    float lumaSE = dot(texture(source, TexCoords + vec2( 1.0,  1.0) * texel).rgb, LUMA);
+    float lumaM = dot(rgbM, LUMA);
+    float lumaMin = min(lumaM, min(min(lumaNW, lumaNE), min(lumaSW, lumaSE)));
+    float lumaMax = max(lumaM, max(max(lumaNW, lumaNE), max(lumaSW, lumaSE)));
+    if(lumaMax - lumaMin < max(0.0312, lumaMax * 0.125)){
+        FragColor = vec4(rgbM, 1.0);
+        return;
+    }
+
+    vec2 dir = vec2(-((lumaNW + lumaNE) - (lumaSW + lumaSE)), (lumaNW + lumaSW) - (lumaNE + lumaSE));
+    float dirReduce = max((lumaNW + lumaNE + lumaSW + lumaSE) * (0.25 * REDUCE_MUL), REDUCE_MIN);
+    float rcpDirMin = 1.0 / (min(abs(dir.x), abs(dir.y)) + dirReduce);
+    dir = clamp(dir * rcpDirMin, vec2(-SPAN_MAX), vec2(SPAN_MAX)) * texel;
+
+    vec3 rgbA = 0.5 * (texture(source, TexCoords + dir * (1.0 / 3.0 - 0.5)).rgb + texture(source, TexCoords + dir * (2.0 / 3.0 - 0.5)).rgb);
+    vec3 rgbB = rgbA * 0.5 + 0.25 * (texture(source, TexCoords - dir * 0.5).rgb + texture(source, TexCoords + dir * 0.5).rgb);
+    float lumaB = dot(rgbB, LUMA);
+    FragColor = vec4((lumaB < lumaMin || lumaB > lumaMax) ? rgbA : rgbB, 1.0);
+}
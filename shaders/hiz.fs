@@ -0,0 +1,22 @@
+#version 330 core
+//one texel of the hi-z readback (occlusion.h): the farthest depth of a footprint x footprint block of pixels
+out vec4 FragColor;
+
+uniform sampler2D depthTexture;
+uniform int footprint;
+uniform bool reversedZ; //far is 0 instead of 1
+
+void main()
+{
+    ivec2 size = textureSize(depthTexture, 0);
+    ivec2 base = ivec2(gl_FragCoord.xy) * footprint;
+    float farthest = reversedZ ? 1.0 : 0.0;
+    for(int y = 0; y < footprint; y++){
+        for(int x = 0; x < footprint; x++){
+            //past the edge repeats the last pixel, the block still only holds depths that are really there
+            float depth = texelFetch(depthTexture, min(base + ivec2(x, y), size - 1), 0).r;
+            farthest = reversedZ ? min(farthest, depth) : max(farthest, depth);
+        }
+    }
+    FragColor = vec4(farthest);
+}
@@ -0,0 +1,183 @@
+//phong lighting from old/lighting, the surface colors are passed in so it works with any material setup
+//permutations:
+//  NR_POINT_LIGHTS n   number of point lights (default 4, 0 compiles them out)
+//  FLASHLIGHT          camera spot light, compiled out instead of branching on a uniform bool
+//  SHADOWS             the directional light is shadowed by the cascaded shadow maps of shadows.h
+
+#ifndef NR_POINT_LIGHTS
+#define NR_POINT_LIGHTS 4
+#endif
+
+struct DirLight {
+    vec3 direction;
+
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+};
+
+struct PointLight {
+    vec3 position;
+
+    //attenuation
+    float constant;
+    float linear;
+    float quadratic;
+
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+};
+
+struct SpotLight {
+    vec3 position;
+    vec3 direction;
+
+    float cutOff;
+    float outerCutOff;
+
+    float constant;
+    float linear;
+    float quadratic;
+
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+};
+
+//what the light functions need to know about the surface
+struct Surface {
+    vec3 position;
+    vec3 normal;
+    vec3 diffuse;
+    vec3 specular;
+    float shininess;
+};
+
+uniform vec3 viewPos;
+uniform DirLight dirLight;
+#if NR_POINT_LIGHTS > 0
+uniform PointLight pointLights[NR_POINT_LIGHTS];
+#endif
+#ifdef FLASHLIGHT
+uniform SpotLight flashLight;
+#endif
+
+#ifdef SHADOWS
+//has to match shadows.h
+#define SHADOW_CASCADES 4
+
+//ShadowData of shadows.h, one vec4 component per cascade
+layout (std140) uniform Shadows {
+    mat4 shadowMatrices[SHADOW_CASCADES]; //world -> map coordinates and depth
+    vec4 cascadeSplits;                   //view distance each cascade ends at
+    vec4 shadowNormalOffsets;             //world units the lookup moves out along the normal
+};
+
+uniform sampler2DArrayShadow shadowMap;
+uniform mat4 view; //the vertex shader's
+
+//1 lit .. 0 in shadow, lit past the last cascade
+float CalcDirShadow(Surface surface, vec3 lightDir){
+    float viewDistance = -(view * vec4(surface.position, 1.0)).z;
+    int cascade = SHADOW_CASCADES;
+    for(int i = SHADOW_CASCADES - 1; i >= 0; i--){
+        if(viewDistance < cascadeSplits[i])
+            cascade = i;
+    }
+    if(cascade == SHADOW_CASCADES)
+        return 1.0;
+
+    //a texel covers a slope of the surface, move out of it, farther the more the light grazes
+    float cosTheta = clamp(dot(surface.normal, lightDir), 0.0, 1.0);
+    vec3 position = surface.position + surface.normal * shadowNormalOffsets[cascade] * (2.0 - cosTheta);
+    vec3 coords = (shadowMatrices[cascade] * vec4(position, 1.0)).xyz;
+    if(coords.z >= 1.0)
+        return 1.0;
+
+    //4 taps half a texel apart, each one a 2x2 compare, 16 texels
+    vec2 texel = 1.0 / vec2(textureSize(shadowMap, 0).xy);
+    float lit = 0.0;
+    lit += texture(shadowMap, vec4(coords.xy + vec2(-0.5, -0.5) * texel, float(cascade), coords.z));
+    lit += texture(shadowMap, vec4(coords.xy + vec2( 0.5, -0.5) * texel, float(cascade), coords.z));
+    lit += texture(shadowMap, vec4(coords.xy + vec2(-0.5,  0.5) * texel, float(cascade), coords.z));
+    lit += texture(shadowMap, vec4(coords.xy + vec2( 0.5,  0.5) * texel, float(cascade), coords.z));
+    return lit * 0.25;
+}
+#endif
+
+//shadow only dims what the light adds, not the ambient
+vec3 CalcDirLight(DirLight light, Surface surface, vec3 viewDir, float shadow){
+    vec3 lightDir = normalize(-light.direction);//negate to get frag to light
+
+    vec3 ambient = light.ambient * surface.diffuse;
+
+    float diff = max(dot(surface.normal, lightDir), 0.0); //cos of the angle between surface normal and lightDir
+    vec3 diffuse = light.diffuse * diff * surface.diffuse;
+
+    vec3 reflectDir = reflect(-lightDir, surface.normal);
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), surface.shininess);
+    vec3 specular = light.specular * spec * surface.specular;
+
+    return ambient + (diffuse + specular) * shadow;
+}
+
+vec3 CalcPointLight(PointLight light, Surface surface, vec3 viewDir){
+    vec3 lightDir = normalize(light.position - surface.position);//Frag to Light
+
+    vec3 ambient = light.ambient * surface.diffuse;
+
+    float diff = max(dot(surface.normal, lightDir), 0.0);
+    vec3 diffuse = light.diffuse * diff * surface.diffuse;
+
+    vec3 reflectDir = reflect(-lightDir, surface.normal);
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), surface.shininess);
+    vec3 specular = light.specular * spec * surface.specular;
+
+    float distance = length(light.position - surface.position);
+    float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
+
+    return (ambient + diffuse + specular) * attenuation;
+}
+
+vec3 CalcSpotLight(SpotLight light, Surface surface, vec3 viewDir){
+    vec3 lightDir = normalize(light.position - surface.position);//Frag to Light
+
+    vec3 ambient = light.ambient * surface.diffuse;
+
+    float diff = max(dot(surface.normal, lightDir), 0.0);
+    vec3 diffuse = light.diffuse * diff * surface.diffuse;
+
+    vec3 reflectDir = reflect(-lightDir, surface.normal);
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), surface.shininess);
+    vec3 specular = light.specular * spec * surface.specular;
+
+    float distance = length(light.position - surface.position);
+    float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
+
+    //clamped spotlight
+    float theta = dot(lightDir, normalize(-light.direction));
+    float epsilon = (light.cutOff - light.outerCutOff);
+    float intensity = clamp((theta - light.outerCutOff) / epsilon, 0.0, 1.0);
+
+    return (ambient + diffuse + specular) * attenuation * intensity;
+}
+
+vec3 CalcLighting(Surface surface)
+{
+    vec3 viewDir = normalize(viewPos - surface.position);
+#ifdef SHADOWS
+    float shadow = CalcDirShadow(surface, normalize(-dirLight.direction));
+#else
+    float shadow = 1.0;
+#endif
+    vec3 result = CalcDirLight(dirLight, surface, viewDir, shadow);
+#if NR_POINT_LIGHTS > 0
+    for(int i = 0; i < NR_POINT_LIGHTS; i++)
+        result += CalcPointLight(pointLights[i], surface, viewDir);
+#endif
+#ifdef FLASHLIGHT
+    result += CalcSpotLight(flashLight, surface, viewDir);
+#endif
+    return result;
+}
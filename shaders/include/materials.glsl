@@ -0,0 +1,31 @@
+//material table of material.h: every material is one entry of the Materials block, its textures are layers of texture arrays
+
+//must match material.h
+#define MAX_TEXTURE_ARRAYS 8
+#define MAX_MATERIALS 256
+
+struct Material {
+    ivec4 textures; //diffuse array, diffuse layer, specular array (-1 = none), specular layer
+    vec4 params;    //x = shininess
+};
+
+layout (std140) uniform Materials {
+    Material materials[MAX_MATERIALS];
+};
+
+uniform sampler2DArray textureArrays[MAX_TEXTURE_ARRAYS];
+
+//glsl 3.30 only allows constant indices into sampler arrays, so pick the array with branches
+vec4 sampleArray(int array, int layer, vec2 uv)
+{
+    vec3 uvw = vec3(uv, float(layer));
+    if(array == 0) return texture(textureArrays[0], uvw);
+    if(array == 1) return texture(textureArrays[1], uvw);
+    if(array == 2) return texture(textureArrays[2], uvw);
+    if(array == 3) return texture(textureArrays[3], uvw);
+    if(array == 4) return texture(textureArrays[4], uvw);
+    if(array == 5) return texture(textureArrays[5], uvw);
+    if(array == 6) return texture(textureArrays[6], uvw);
+    if(array == 7) return texture(textureArrays[7], uvw);
+    return vec4(0.0);
+}
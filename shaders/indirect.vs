@@ -0,0 +1,36 @@
+#version 430 core
+#extension GL_ARB_shader_draw_parameters : require
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoords;
+
+//one entry per draw of the multi draw, see DrawData in indirect.h
+struct DrawData {
+    mat4 model;
+    uint materialIndex;
+};
+
+layout (std430, binding = 0) readonly buffer DrawBuffer {
+    DrawData draws[];
+};
+
+out vec2 TexCoords;
+out vec3 Normal;
+out vec3 FragPos;
+flat out int MaterialIndex;
+
+uniform mat4 view;
+uniform mat4 projection;
+
+invariant gl_Position;
+uniform int drawBase; //gl_DrawID restarts at 0 for every multi draw call
+
+void main()
+{
+    DrawData draw = draws[drawBase + gl_DrawIDARB];
+    TexCoords = aTexCoords;
+    FragPos = vec3(draw.model * vec4(aPos, 1.0));
+    Normal = mat3(draw.model) * aNormal; //scene models only use uniform scale, no normal matrix needed
+    MaterialIndex = int(draw.materialIndex);
+    gl_Position = projection * view * vec4(FragPos, 1.0);
+}
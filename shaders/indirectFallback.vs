@@ -0,0 +1,26 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoords;
+
+//same outputs as indirect.vs but the per draw data comes in as uniforms
+out vec2 TexCoords;
+out vec3 Normal;
+out vec3 FragPos;
+flat out int MaterialIndex;
+
+uniform mat4 model;
+uniform mat4 view;
+uniform mat4 projection;
+
+invariant gl_Position;
+uniform int materialIndex;
+
+void main()
+{
+    TexCoords = aTexCoords;
+    FragPos = vec3(model * vec4(aPos, 1.0));
+    Normal = mat3(model) * aNormal; //scene models only use uniform scale, no normal matrix needed
+    MaterialIndex = materialIndex;
+    gl_Position = projection * view * vec4(FragPos, 1.0);
+}
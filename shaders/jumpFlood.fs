@@ -0,0 +1,35 @@
+#version 330 core
+//one jump flood pass: take the nearest of the seeds stored step pixels away in the 8 directions and here
+out uvec2 Seed;
+
+uniform usampler2D seeds;
+uniform int step;
+uniform vec4 bounds; //x0, y0, x1, y1 in pixels, texels outside are stale
+
+const uint NO_SEED = 65535u; //OUTLINE_NO_SEED
+
+void main()
+{
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    ivec2 lo = ivec2(bounds.xy);
+    ivec2 hi = ivec2(bounds.zw) - 1;
+    uvec2 best = uvec2(NO_SEED);
+    float bestDistance = 1e20;
+    for(int y = -1; y <= 1; y++){
+        for(int x = -1; x <= 1; x++){
+            ivec2 neighbour = pixel + ivec2(x, y) * step;
+            if(any(lessThan(neighbour, lo)) || any(greaterThan(neighbour, hi)))
+                continue;
+            uvec2 seed = texelFetch(seeds, neighbour, 0).xy;
+            if(seed.x == NO_SEED)
+                continue;
+            vec2 offset = vec2(seed) - vec2(pixel);
+            float seedDistance = dot(offset, offset);
+            if(seedDistance < bestDistance){
+                bestDistance = seedDistance;
+                best = seed;
+            }
+        }
+    }
+    Seed = best;
+}
@@ -0,0 +1,18 @@
+#version 330 core
+//weighted blended oit accumulation, the targets and the blend state are explained in oit.h
+layout (location = 0) out vec4 Accumulation; //rgb: color * alpha * weight (added), a: alpha (multiplies revealage)
+layout (location = 1) out vec4 Weight;       //r: alpha * weight (added)
+
+in vec2 TexCoords;
+in float ViewDepth;
+
+uniform sampler2D texture1;
+
+void main()
+{
+    vec4 color = texture(texture1, TexCoords);
+    //McGuire & Bavoil equation 10, on view space distance so it doesn't care about reversed-Z
+    float weight = color.a * clamp(10.0 / (1e-5 + pow(ViewDepth / 5.0, 2.0) + pow(ViewDepth / 200.0, 6.0)), 1e-2, 3e3);
+    Accumulation = vec4(color.rgb * color.a * weight, color.a);
+    Weight = vec4(color.a * weight);
+}
@@ -0,0 +1,21 @@
+#version 330 core
+//resolves the weighted blended oit targets over the opaque image, blended with (ONE_MINUS_SRC_ALPHA, SRC_ALPHA)
+out vec4 FragColor;
+
+uniform sampler2D accumulation;
+uniform sampler2D weights;
+
+void main()
+{
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    vec4 accum = texelFetch(accumulation, pixel, 0);
+    float revealage = accum.a;
+    if(revealage >= 1.0)
+        discard; //nothing transparent here
+
+    //a lot of bright layers can overflow the half floats, fall back to white (the divide below gives 1.0)
+    float weight = texelFetch(weights, pixel, 0).r;
+    if(any(isinf(accum.rgb)))
+        accum.rgb = vec3(weight);
+    FragColor = vec4(accum.rgb / max(weight, 1e-5), revealage);
+}
@@ -0,0 +1,22 @@
+#version 330 core
+//outline color where the nearest seed is closer than thickness, the stencil keeps it off the selection itself
+out vec4 FragColor;
+
+uniform usampler2D seeds;
+uniform float thickness;
+uniform vec3 color;
+
+const uint NO_SEED = 65535u; //OUTLINE_NO_SEED
+
+void main()
+{
+    uvec2 seed = texelFetch(seeds, ivec2(gl_FragCoord.xy), 0).xy;
+    if(seed.x == NO_SEED)
+        discard;
+    float seedDistance = length(vec2(seed) - floor(gl_FragCoord.xy));
+    //a pixel wide ramp at the outer edge instead of a hard step
+    float alpha = clamp(thickness + 0.5 - seedDistance, 0.0, 1.0);
+    if(alpha <= 0.0)
+        discard;
+    FragColor = vec4(color, alpha);
+}
@@ -0,0 +1,8 @@
+#version 330 core
+//only runs on the stencilled (selected) pixels, each one is its own nearest seed
+out uvec2 Seed;
+
+void main()
+{
+    Seed = uvec2(gl_FragCoord.xy);
+}
@@ -0,0 +1,26 @@
+#version 330 core
+//permutations: the ones of include/lighting.glsl
+out vec4 FragColor;
+
+in vec2 TexCoords;
+in vec3 Normal;
+in vec3 FragPos;
+flat in int MaterialIndex;
+
+#include "include/materials.glsl"
+#include "include/lighting.glsl"
+
+void main()
+{    
+    Material material = materials[MaterialIndex];
+    vec4 diffuse = sampleArray(material.textures.x, material.textures.y, TexCoords);
+
+    Surface surface;
+    surface.position = FragPos;
+    surface.normal = normalize(Normal);
+    surface.diffuse = diffuse.rgb;
+    surface.specular = material.textures.z >= 0 ? sampleArray(material.textures.z, material.textures.w, TexCoords).rgb : vec3(0.0);
+    surface.shininess = material.params.x;
+
+    FragColor = vec4(CalcLighting(surface), diffuse.a);
+}
@@ -0,0 +1,31 @@
+#version 330 core
+//permutations:
+//  BLOOM   add the blurred highlights before tonemapping
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+uniform sampler2D scene;
+uniform float exposure;
+#ifdef BLOOM
+uniform sampler2D bloom;
+uniform float bloomStrength;
+#endif
+
+//identity up to shoulderStart, then rolls off towards 1. The scene was lit for an 8 bit target, so everything
+//that used to fit keeps its look and only what goes past 1 (highlights, bloom) gets compressed
+vec3 shoulder(vec3 color)
+{
+    const float shoulderStart = 0.8;
+    vec3 over = max(color - shoulderStart, 0.0);
+    return min(color, shoulderStart) + (1.0 - shoulderStart) * (1.0 - exp(-over / (1.0 - shoulderStart)));
+}
+
+void main()
+{
+    vec3 color = texture(scene, TexCoords).rgb;
+#ifdef BLOOM
+    color += texture(bloom, TexCoords).rgb * bloomStrength;
+#endif
+    FragColor = vec4(shoulder(color * exposure), 1.0);
+}
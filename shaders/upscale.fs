@@ -0,0 +1,23 @@
+#version 330 core
+//dynamic resolution upscale: bilinear from the lower resolution image, then sharpened against the 4 neighbours one
+//source texel away. The sharpened value is clamped to the neighbourhood's range so edges don't ring
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+uniform sampler2D source;
+uniform float sharpness; //0 = plain bilinear
+
+void main()
+{
+    vec2 texel = 1.0 / vec2(textureSize(source, 0));
+    vec3 center = texture(source, TexCoords).rgb;
+    vec3 left = texture(source, TexCoords - vec2(texel.x, 0.0)).rgb;
+    vec3 right = texture(source, TexCoords + vec2(texel.x, 0.0)).rgb;
+    vec3 down = texture(source, TexCoords - vec2(0.0, texel.y)).rgb;
+    vec3 up = texture(source, TexCoords + vec2(0.0, texel.y)).rgb;
+    vec3 lo = min(center, min(min(left, right), min(down, up)));
+    vec3 hi = max(center, max(max(left, right), max(down, up)));
+    vec3 sharpened = center + (center - 0.25 * (left + right + down + up)) * sharpness;
+    FragColor = vec4(clamp(sharpened, lo, hi), 1.0);
+}
@@ -0,0 +1,373 @@
+#ifndef SHADOWS_H
+#define SHADOWS_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "camera.h"
+#include "ecs.h"
+#include "indirect.h"
+#include "material.h"
+#include "occlusion.h"
+#include "ring_buffer.h"
+#include "scene.h"
+#include "shader.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// has to match SHADOW_CASCADES in shaders/include/lighting.glsl
+#define SHADOW_CASCADES 4
+#define SHADOW_CACHED_CASCADES 2 // the farthest ones
+#define SHADOW_TEXTURE_UNIT MAX_TEXTURE_ARRAYS // the first unit after the material arrays
+#define SHADOW_UBO_BINDING 2 // binding point of the Shadows uniform block, after MATERIAL_UBO_BINDING
+
+// the Shadows uniform block of shaders/include/lighting.glsl, std140
+struct ShadowData {
+    glm::mat4 matrices[SHADOW_CASCADES]; // world -> map coordinates and depth
+    glm::vec4 splits;                    // view distance each cascade ends at
+    glm::vec4 normalOffsets;             // world units the lookup moves out along the normal
+};
+
+// Cascaded shadow maps for the directional light, one layer of a GL_DEPTH_COMPONENT32F array per cascade.
+// The view distance up to shadowDistance is split between the cascades, a blend of uniform and logarithmic
+// splits (splitLambda), and every cascade gets an orthographic light projection around its slice of the camera
+// frustum:
+//  - the near cascades are fitted tightly around the slice and re-rendered whenever the camera (Camera::version()),
+//    the light or a caster changed. The square they cover only grows and shrinks in steps of 1/16 of the slice's
+//    bounding sphere and its corner sits on the texel grid, so the edges don't crawl while the camera moves
+//  - the far cascades (SHADOW_CACHED_CASCADES) cover the bounding sphere of their slice times cacheMargin and are
+//    kept. They are rendered again only when the light turns, a caster moves or appears (a hash over the mesh and
+//    world matrix of every MeshRenderer), or the camera moved far enough that its slice left the covered sphere.
+//    The hash relies on Simulation::interpolate() leaving the matrices of resting objects bit for bit the same.
+//    Most frames they cost nothing, no matter how much geometry they hold
+// Casters in front of a cascade are flattened onto its near plane with GL_DEPTH_CLAMP, so the depth range only
+// has to span the slice. Acne is handled by slope scaled polygon offset while rendering plus a normal offset of
+// normalBias texels in the lookup (shaders/include/lighting.glsl, SHADOWS), which does 4 hardware filtered taps.
+// The map always stores [0, 1] depth with GL_LESS, whatever the scene does with reversed-Z.
+// Grass doesn't cast.
+//
+// usage: create() once, setupShader() once per scene shader program, per frame update() -> render() with the depth
+// shader (the shadow pass) -> apply() before the opaque draws
+class CascadedShadowMaps {
+    public:
+        bool enabled = true;
+        int size = 2048;              // per cascade, fixed after create()
+        float shadowDistance = 40.0f; // along the view direction, past it everything is lit
+        float splitLambda = 0.8f;     // 0 uniform .. 1 logarithmic splits
+        float cacheMargin = 1.3f;     // radius of what a cached cascade covers over the radius of its slice
+        float slopeBias = 2.0f;       // glPolygonOffset factor and units while rendering
+        float normalBias = 1.0f;      // texels the lookup moves out along the normal
+
+        GLenum sceneDepthFunc = GL_LESS; // restored after render(), GL_GREATER with reversed-Z
+        bool zeroToOneDepth = false;     // glClipControl(.., GL_ZERO_TO_ONE) is active
+
+        unsigned int texture = 0;
+        unsigned int ubo = 0;
+
+        // last update()/render()
+        unsigned int renderedCascades = 0;
+        unsigned int casterDraws = 0;
+
+        bool create(){
+            glGenTextures(1, &texture);
+            glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+            glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT32F, size, size, SHADOW_CASCADES, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+            //linear + compare mode, every texture() is a 2x2 pcf
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+            glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+            glGenFramebuffers(SHADOW_CASCADES, fbo);
+            for(unsigned int i = 0; i < SHADOW_CASCADES; i++){
+                glBindFramebuffer(GL_FRAMEBUFFER, fbo[i]);
+                glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, texture, 0, i);
+                glDrawBuffer(GL_NONE);
+                glReadBuffer(GL_NONE);
+                GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+                if(status != GL_FRAMEBUFFER_COMPLETE){
+                    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+                    std::cout << "ERROR::SHADOWS::INCOMPLETE 0x" << std::hex << status << std::dec << std::endl;
+                    return false;
+                }
+            }
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+            glGenBuffers(1, &ubo);
+            glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+            glBufferData(GL_UNIFORM_BUFFER, sizeof(ShadowData), NULL, GL_DYNAMIC_DRAW);
+            glBindBuffer(GL_UNIFORM_BUFFER, 0);
+            return true;
+        }
+
+        // points the shader's shadow sampler and uniform block at what apply() binds, only needed once per program
+        void setupShader(Shader& shader){
+            shader.use();
+            shader.setInt("shadowMap", SHADOW_TEXTURE_UNIT);
+            unsigned int blockIndex = glGetUniformBlockIndex(shader.shaderProgram, "Shadows");
+            if(blockIndex != GL_INVALID_INDEX)
+                glUniformBlockBinding(shader.shaderProgram, blockIndex, SHADOW_UBO_BINDING);
+        }
+
+        // fits the cascades to the camera and marks the ones render() has to draw. fov (degrees), aspect and
+        // nearZ are the ones of the camera's projection, lightDirection points from the light into the scene
+        void update(World& world, const MeshPool& pool, Camera& camera, float fov, float aspect, float nearZ, glm::vec3 lightDirection){
+            renderedCascades = 0;
+
+            //every caster with its world bounds, hashed to notice when the cached cascades are out of date
+            casters.clear();
+            uint64_t casterHash = 1469598103934665603ull;
+            world.each<WorldTransform, MeshRenderer>([&](Entity, WorldTransform& transform, MeshRenderer& renderer){
+                Caster caster;
+                caster.mesh = renderer.mesh;
+                caster.material = renderer.material;
+                caster.model = transform.matrix;
+                const PoolMesh& mesh = pool.meshes[renderer.mesh];
+                transformBounds(mesh.boundsMin, mesh.boundsMax, transform.matrix, caster.boxMin, caster.boxMax);
+                casters.push_back(caster);
+                casterHash = hash(casterHash, &renderer.mesh, sizeof(renderer.mesh));
+                casterHash = hash(casterHash, &transform.matrix[0][0], sizeof(glm::mat4));
+            });
+
+            //a fixed rotation per light direction, so the texel grid only moves when the light does
+            glm::vec3 direction = glm::normalize(lightDirection);
+            glm::vec3 up = std::fabs(direction.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+            glm::mat4 lightRotation = glm::lookAt(glm::vec3(0.0f), direction, up);
+
+            float farZ = std::max(shadowDistance, nearZ * 2.0f);
+            float splitNear = nearZ;
+            float tanY = std::tan(glm::radians(fov * 0.5f));
+            float tanX = tanY * aspect;
+            glm::mat4 camToWorld = camera.camToWorldMatrix();
+
+            //the near cascades are kept too while neither the camera, the light, the splits nor a caster changed
+            const float parameters[5] = {fov, aspect, nearZ, shadowDistance, splitLambda};
+            uint64_t nearHash = hash(hash(casterHash, parameters, sizeof(parameters)), &direction[0], sizeof(glm::vec3));
+            bool nearCurrent = nearValid && camera.version() == nearCameraVersion && nearHash == nearStateHash;
+            nearValid = true;
+            nearCameraVersion = camera.version();
+            nearStateHash = nearHash;
+
+            for(unsigned int i = 0; i < SHADOW_CASCADES; i++){
+                Cascade& cascade = cascades[i];
+                float t = (float)(i + 1) / SHADOW_CASCADES;
+                float logarithmic = nearZ * std::pow(farZ / nearZ, t);
+                float uniform = nearZ + (farZ - nearZ) * t;
+                float splitFar = splitLambda * logarithmic + (1.0f - splitLambda) * uniform;
+                cascade.splitFar = splitFar;
+
+                //the smallest sphere around the slice, it doesn't change as the camera turns
+                float k2 = tanX * tanX + tanY * tanY;
+                float centerDistance = 0.5f * (splitNear + splitFar) * (1.0f + k2);
+                float radius;
+                if(centerDistance >= splitFar){
+                    centerDistance = splitFar;
+                    radius = splitFar * std::sqrt(k2);
+                }else{
+                    radius = std::sqrt((splitFar - centerDistance) * (splitFar - centerDistance) + splitFar * splitFar * k2);
+                }
+                glm::vec3 center = glm::vec3(lightRotation * camToWorld * glm::vec4(0.0f, 0.0f, -centerDistance, 1.0f));
+
+                if(i >= SHADOW_CASCADES - SHADOW_CACHED_CASCADES){
+                    bool covered = cascade.valid && cascade.lightDirection == direction && cascade.casterHash == casterHash
+                        && glm::length(center - cascade.center) + radius <= cascade.radius;
+                    if(!covered){
+                        float covers = radius * cacheMargin;
+                        float texel = 2.0f * covers / size;
+                        cascade.center = glm::vec3(std::floor(center.x / texel) * texel, std::floor(center.y / texel) * texel, center.z);
+                        cascade.radius = covers - 2.0f * texel; //what is still covered after the snap
+                        cascade.lightDirection = direction;
+                        cascade.casterHash = casterHash;
+                        cascade.valid = true;
+                        fit(cascade, lightRotation, cascade.center.x - covers, cascade.center.x + covers,
+                            cascade.center.y - covers, cascade.center.y + covers, -cascade.center.z - covers, -cascade.center.z + covers);
+                    }
+                }else if(!nearCurrent){
+                    glm::vec3 lo(1e30f);
+                    glm::vec3 hi(-1e30f);
+                    for(int c = 0; c < 8; c++){
+                        float d = c & 4 ? splitFar : splitNear;
+                        glm::vec4 corner(c & 1 ? d * tanX : -d * tanX, c & 2 ? d * tanY : -d * tanY, -d, 1.0f);
+                        glm::vec3 p = glm::vec3(lightRotation * camToWorld * corner);
+                        lo = glm::min(lo, p);
+                        hi = glm::max(hi, p);
+                    }
+                    float step = radius / 8.0f;
+                    float extent = std::min(std::ceil(std::max(hi.x - lo.x, hi.y - lo.y) / step) * step, 2.0f * radius);
+                    //two texels of slack for the snap
+                    float texel = extent / (size - 2);
+                    float left = std::floor((0.5f * (lo.x + hi.x - extent)) / texel) * texel - texel;
+                    float bottom = std::floor((0.5f * (lo.y + hi.y - extent)) / texel) * texel - texel;
+                    fit(cascade, lightRotation, left, left + size * texel, bottom, bottom + size * texel, -hi.z, -lo.z);
+                    cascade.valid = false;
+                }
+                splitNear = splitFar;
+            }
+            for(unsigned int i = 0; i < SHADOW_CASCADES; i++){
+                if(cascades[i].dirty)
+                    renderedCascades++;
+            }
+        }
+
+        // draws the cascades update() marked into their layers, depthShader is the scene's vertex shader with
+        // shaders/depth.fs. Leaves the scene's depth test and clear depth, and no framebuffer bound
+        void render(MeshPool& pool, Shader& depthShader, RingBuffer& ring){
+            casterDraws = 0;
+            if(renderedCascades == 0)
+                return;
+            glViewport(0, 0, size, size);
+            glEnable(GL_DEPTH_TEST);
+            glDepthMask(GL_TRUE);
+            glDepthFunc(GL_LESS);
+            glClearDepth(1.0);
+            glEnable(GL_DEPTH_CLAMP);
+            glEnable(GL_POLYGON_OFFSET_FILL);
+            glPolygonOffset(slopeBias, slopeBias);
+            depthShader.use();
+            depthShader.setMat4("view", glm::mat4(1.0f));
+            for(unsigned int i = 0; i < SHADOW_CASCADES; i++){
+                Cascade& cascade = cascades[i];
+                if(!cascade.dirty)
+                    continue;
+                glBindFramebuffer(GL_FRAMEBUFFER, fbo[i]);
+                glClear(GL_DEPTH_BUFFER_BIT);
+                draws.clear();
+                for(const Caster& caster : casters){
+                    if(boxInFrustum(cascade.planes, caster.boxMin, caster.boxMax))
+                        draws.add(caster.mesh, caster.model, caster.material);
+                }
+                depthShader.setMat4("projection", cascade.render);
+                draws.submit(pool, depthShader, ring);
+                casterDraws += draws.drawCount;
+                cascade.dirty = false;
+            }
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+            glDisable(GL_POLYGON_OFFSET_FILL);
+            glDisable(GL_DEPTH_CLAMP);
+            glDepthFunc(sceneDepthFunc);
+            glClearDepth(sceneDepthFunc == GL_GREATER ? 0.0 : 1.0);
+        }
+
+        // binds the map and the cascade data of lighting.glsl's SHADOWS permutation for every program set up with
+        // setupShader()
+        void apply(){
+            ShadowData data;
+            for(unsigned int i = 0; i < SHADOW_CASCADES; i++){
+                data.matrices[i] = cascades[i].lookup;
+                data.splits[i] = cascades[i].splitFar;
+                data.normalOffsets[i] = cascades[i].texelSize * normalBias;
+            }
+            glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+            glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(ShadowData), &data);
+            glBindBuffer(GL_UNIFORM_BUFFER, 0);
+            glBindBufferBase(GL_UNIFORM_BUFFER, SHADOW_UBO_BINDING, ubo);
+            glActiveTexture(GL_TEXTURE0 + SHADOW_TEXTURE_UNIT);
+            glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+            glActiveTexture(GL_TEXTURE0);
+        }
+
+        // for the window title
+        std::string summary() const{
+            char text[64];
+            std::snprintf(text, sizeof(text), "shadows %u/%d cascades, %u casters", renderedCascades, SHADOW_CASCADES, casterDraws);
+            return text;
+        }
+
+        // the cached cascades are drawn again on the next update()
+        void invalidate(){
+            for(unsigned int i = 0; i < SHADOW_CASCADES; i++)
+                cascades[i].valid = false;
+            nearValid = false;
+        }
+
+        void release(){
+            if(texture == 0)
+                return;
+            glDeleteFramebuffers(SHADOW_CASCADES, fbo);
+            glDeleteTextures(1, &texture);
+            glDeleteBuffers(1, &ubo);
+            texture = 0;
+            ubo = 0;
+        }
+
+    private:
+        struct Caster {
+            unsigned int mesh;
+            unsigned int material;
+            glm::mat4 model;
+            glm::vec3 boxMin;
+            glm::vec3 boxMax;
+        };
+
+        struct Cascade {
+            float splitFar = 0.0f;                 // view distance the cascade ends at
+            glm::mat4 render = glm::mat4(1.0f);    // world -> clip space of the map
+            glm::mat4 lookup = glm::mat4(1.0f);    // world -> [0, 1] map coordinates and depth
+            glm::vec4 planes[6];                   // what the map covers, the near one lets everything through
+            float texelSize = 0.0f;                // world units
+            bool dirty = false;
+
+            // cached cascades, what the layer holds
+            bool valid = false;
+            glm::vec3 center = glm::vec3(0.0f);    // light space
+            float radius = 0.0f;
+            glm::vec3 lightDirection = glm::vec3(0.0f);
+            uint64_t casterHash = 0;
+        };
+
+        Cascade cascades[SHADOW_CASCADES];
+        bool nearValid = false;             // what the near cascades were last fitted for
+        unsigned int nearCameraVersion = 0;
+        uint64_t nearStateHash = 0;
+        unsigned int fbo[SHADOW_CASCADES] = {0};
+        std::vector<Caster> casters;
+        DrawList draws;
+
+        static uint64_t hash(uint64_t h, const void* data, size_t bytes){
+            const unsigned char* p = (const unsigned char*)data;
+            for(size_t i = 0; i < bytes; i++){
+                h ^= p[i];
+                h *= 1099511628211ull;
+            }
+            return h;
+        }
+
+        // light space box -> the cascade's matrices and culling planes, marks it for render()
+        void fit(Cascade& cascade, const glm::mat4& lightRotation, float left, float right, float bottom, float top, float nearZ, float farZ){
+            glm::mat4 viewProjection = glm::ortho(left, right, bottom, top, nearZ, farZ) * lightRotation;
+            //[-1, 1] -> [0, 1], with GL_ZERO_TO_ONE the clip space depth is written as it is so it needs the remap too
+            glm::mat4 toDepthRange = glm::mat4(1.0f);
+            toDepthRange[2][2] = 0.5f;
+            toDepthRange[3][2] = 0.5f;
+            glm::mat4 toTexture = glm::translate(glm::mat4(1.0f), glm::vec3(0.5f)) * glm::scale(glm::mat4(1.0f), glm::vec3(0.5f));
+            cascade.render = zeroToOneDepth ? toDepthRange * viewProjection : viewProjection;
+            cascade.lookup = toTexture * viewProjection;
+            cascade.texelSize = (right - left) / size;
+            cascade.dirty = true;
+
+            //rows of the matrix, left right bottom top like Camera::frustumPlanes(). Casters in front still throw
+            //shadows into the slice, so there is no near plane
+            glm::vec4 rows[4];
+            for(int r = 0; r < 4; r++)
+                rows[r] = glm::vec4(viewProjection[0][r], viewProjection[1][r], viewProjection[2][r], viewProjection[3][r]);
+            cascade.planes[0] = rows[3] + rows[0];
+            cascade.planes[1] = rows[3] - rows[0];
+            cascade.planes[2] = rows[3] + rows[1];
+            cascade.planes[3] = rows[3] - rows[1];
+            cascade.planes[4] = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+            cascade.planes[5] = rows[3] - rows[2];
+        }
+};
+
+#endif
@@ -0,0 +1,249 @@
+#ifndef SIMD_MATH_H
+#define SIMD_MATH_H
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define SIMD_MATH_SSE
+//the AVX path is compiled for avx on its own whatever the build flags, simdHasAVX() picks it at runtime
+#if defined(__GNUC__) || defined(__clang__)
+#include <immintrin.h>
+#define SIMD_MATH_AVX
+#endif
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define SIMD_MATH_NEON
+#endif
+
+// SIMD paths for the matrix work that runs per object per frame, on plain glm::mat4 (column major, 16 floats)
+// so callers don't change types:
+//  - simdMul:        4x4 * 4x4, one column of the result per broadcast-multiply-add chain (AVX cpus: two at once)
+//  - simdMulAffine:  the same when b's last row is 0 0 0 1 (model matrices), skips the w terms
+//  - simdMulBatch:   a * b[i] for a whole array, a stays in registers
+//  - simdComposeTRS4: translate * rotate(quaternion) * scale for 4 objects at once, structure of arrays inside
+// glm without GLM_FORCE_INTRINSICS does all of this one float at a time, see benchmarks/simd_math.cpp.
+// Loads and stores are unaligned (glm::mat4 is only 4 byte aligned), on anything since Nehalem that is free
+// when the data happens to be aligned anyway.
+
+// 4 floats in a register, f4* are the few operations the paths below (and software_occlusion.h) need.
+// Comparisons return a mask, all bits set in the lanes where they hold, for f4And/f4Select/f4Any
+#if defined(SIMD_MATH_SSE)
+typedef __m128 f4;
+inline f4 f4Load(const float* p){ return _mm_loadu_ps(p); }
+inline void f4Store(float* p, f4 v){ _mm_storeu_ps(p, v); }
+inline f4 f4Set(float v){ return _mm_set1_ps(v); }
+inline f4 f4Add(f4 a, f4 b){ return _mm_add_ps(a, b); }
+inline f4 f4Sub(f4 a, f4 b){ return _mm_sub_ps(a, b); }
+inline f4 f4Mul(f4 a, f4 b){ return _mm_mul_ps(a, b); }
+#if defined(__FMA__)
+inline f4 f4MulAdd(f4 a, f4 b, f4 c){ return _mm_fmadd_ps(a, b, c); }
+#else
+inline f4 f4MulAdd(f4 a, f4 b, f4 c){ return _mm_add_ps(_mm_mul_ps(a, b), c); }
+#endif
+inline f4 f4GreaterEqual(f4 a, f4 b){ return _mm_cmpge_ps(a, b); }
+inline f4 f4Greater(f4 a, f4 b){ return _mm_cmpgt_ps(a, b); }
+inline f4 f4Less(f4 a, f4 b){ return _mm_cmplt_ps(a, b); }
+inline f4 f4And(f4 a, f4 b){ return _mm_and_ps(a, b); }
+inline f4 f4Select(f4 mask, f4 a, f4 b){ return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b)); }
+inline bool f4Any(f4 mask){ return _mm_movemask_ps(mask) != 0; }
+inline void f4Transpose(f4& a, f4& b, f4& c, f4& d){ _MM_TRANSPOSE4_PS(a, b, c, d); }
+#elif defined(SIMD_MATH_NEON)
+typedef float32x4_t f4;
+inline f4 f4Load(const float* p){ return vld1q_f32(p); }
+inline void f4Store(float* p, f4 v){ vst1q_f32(p, v); }
+inline f4 f4Set(float v){ return vdupq_n_f32(v); }
+inline f4 f4Add(f4 a, f4 b){ return vaddq_f32(a, b); }
+inline f4 f4Sub(f4 a, f4 b){ return vsubq_f32(a, b); }
+inline f4 f4Mul(f4 a, f4 b){ return vmulq_f32(a, b); }
+inline f4 f4MulAdd(f4 a, f4 b, f4 c){ return vmlaq_f32(c, a, b); }
+inline f4 f4GreaterEqual(f4 a, f4 b){ return vreinterpretq_f32_u32(vcgeq_f32(a, b)); }
+inline f4 f4Greater(f4 a, f4 b){ return vreinterpretq_f32_u32(vcgtq_f32(a, b)); }
+inline f4 f4Less(f4 a, f4 b){ return vreinterpretq_f32_u32(vcltq_f32(a, b)); }
+inline f4 f4And(f4 a, f4 b){ return vreinterpretq_f32_u32(vandq_u32(vreinterpretq_u32_f32(a), vreinterpretq_u32_f32(b))); }
+inline f4 f4Select(f4 mask, f4 a, f4 b){ return vbslq_f32(vreinterpretq_u32_f32(mask), a, b); }
+inline bool f4Any(f4 mask){
+    uint32x4_t bits = vreinterpretq_u32_f32(mask);
+    uint32x2_t half = vorr_u32(vget_low_u32(bits), vget_high_u32(bits));
+    return (vget_lane_u32(half, 0) | vget_lane_u32(half, 1)) != 0;
+}
+inline void f4Transpose(f4& a, f4& b, f4& c, f4& d){
+    float32x4x2_t ab = vtrnq_f32(a, b);
+    float32x4x2_t cd = vtrnq_f32(c, d);
+    a = vcombine_f32(vget_low_f32(ab.val[0]), vget_low_f32(cd.val[0]));
+    b = vcombine_f32(vget_low_f32(ab.val[1]), vget_low_f32(cd.val[1]));
+    c = vcombine_f32(vget_high_f32(ab.val[0]), vget_high_f32(cd.val[0]));
+    d = vcombine_f32(vget_high_f32(ab.val[1]), vget_high_f32(cd.val[1]));
+}
+#else
+struct f4 { float v[4]; };
+inline f4 f4Load(const float* p){ f4 r; std::memcpy(r.v, p, sizeof(r.v)); return r; }
+inline void f4Store(float* p, f4 v){ std::memcpy(p, v.v, sizeof(v.v)); }
+inline f4 f4Set(float v){ return {{v, v, v, v}}; }
+inline f4 f4Add(f4 a, f4 b){ for(int i = 0; i < 4; i++) a.v[i] += b.v[i]; return a; }
+inline f4 f4Sub(f4 a, f4 b){ for(int i = 0; i < 4; i++) a.v[i] -= b.v[i]; return a; }
+inline f4 f4Mul(f4 a, f4 b){ for(int i = 0; i < 4; i++) a.v[i] *= b.v[i]; return a; }
+inline f4 f4MulAdd(f4 a, f4 b, f4 c){ for(int i = 0; i < 4; i++) c.v[i] += a.v[i] * b.v[i]; return c; }
+//masks hold the bits of 0 or 0xffffffff in each float
+inline float f4MaskLane(bool set){ uint32_t bits = set ? 0xffffffffu : 0u; float lane; std::memcpy(&lane, &bits, sizeof(lane)); return lane; }
+inline bool f4LaneSet(float lane){ uint32_t bits; std::memcpy(&bits, &lane, sizeof(bits)); return bits != 0; }
+inline f4 f4GreaterEqual(f4 a, f4 b){ for(int i = 0; i < 4; i++) a.v[i] = f4MaskLane(a.v[i] >= b.v[i]); return a; }
+inline f4 f4Greater(f4 a, f4 b){ for(int i = 0; i < 4; i++) a.v[i] = f4MaskLane(a.v[i] > b.v[i]); return a; }
+inline f4 f4Less(f4 a, f4 b){ for(int i = 0; i < 4; i++) a.v[i] = f4MaskLane(a.v[i] < b.v[i]); return a; }
+inline f4 f4And(f4 a, f4 b){ for(int i = 0; i < 4; i++) a.v[i] = f4MaskLane(f4LaneSet(a.v[i]) && f4LaneSet(b.v[i])); return a; }
+inline f4 f4Select(f4 mask, f4 a, f4 b){ for(int i = 0; i < 4; i++) a.v[i] = f4LaneSet(mask.v[i]) ? a.v[i] : b.v[i]; return a; }
+inline bool f4Any(f4 mask){ return f4LaneSet(mask.v[0]) || f4LaneSet(mask.v[1]) || f4LaneSet(mask.v[2]) || f4LaneSet(mask.v[3]); }
+inline void f4Transpose(f4& a, f4& b, f4& c, f4& d){
+    f4* rows[4] = {&a, &b, &c, &d};
+    for(int i = 0; i < 4; i++){
+        for(int j = i + 1; j < 4; j++){
+            float t = rows[i]->v[j];
+            rows[i]->v[j] = rows[j]->v[i];
+            rows[j]->v[i] = t;
+        }
+    }
+}
+#endif
+
+inline const float* matrixData(const glm::mat4& m){ return &m[0][0]; }
+inline float* matrixData(glm::mat4& m){ return &m[0][0]; }
+
+#if defined(SIMD_MATH_AVX)
+// read once at startup, __builtin_cpu_init() since that can be before the runtime filled in the cpu features
+inline const bool simdHasAVX = (__builtin_cpu_init(), __builtin_cpu_supports("avx"));
+
+// two result columns per iteration: a's columns sit in both halves, each half broadcasts its own b column
+__attribute__((target("avx")))
+inline void simdMulAVX(const float* a, const float* b, float* out)
+{
+    __m256 a0 = _mm256_broadcast_ps((const __m128*)(a + 0));
+    __m256 a1 = _mm256_broadcast_ps((const __m128*)(a + 4));
+    __m256 a2 = _mm256_broadcast_ps((const __m128*)(a + 8));
+    __m256 a3 = _mm256_broadcast_ps((const __m128*)(a + 12));
+    for(int j = 0; j < 16; j += 8){
+        __m256 b01 = _mm256_loadu_ps(b + j);
+        __m256 r = _mm256_mul_ps(a0, _mm256_permute_ps(b01, 0x00));
+        r = _mm256_add_ps(r, _mm256_mul_ps(a1, _mm256_permute_ps(b01, 0x55)));
+        r = _mm256_add_ps(r, _mm256_mul_ps(a2, _mm256_permute_ps(b01, 0xAA)));
+        r = _mm256_add_ps(r, _mm256_mul_ps(a3, _mm256_permute_ps(b01, 0xFF)));
+        _mm256_storeu_ps(out + j, r);
+    }
+}
+#endif
+
+// a * b
+inline glm::mat4 simdMul(const glm::mat4& a, const glm::mat4& b)
+{
+    glm::mat4 result;
+#if defined(SIMD_MATH_AVX)
+    if(simdHasAVX){
+        simdMulAVX(matrixData(a), matrixData(b), matrixData(result));
+        return result;
+    }
+#endif
+    const float* pa = matrixData(a);
+    const float* pb = matrixData(b);
+    float* out = matrixData(result);
+    f4 a0 = f4Load(pa), a1 = f4Load(pa + 4), a2 = f4Load(pa + 8), a3 = f4Load(pa + 12);
+    for(int j = 0; j < 4; j++){
+        const float* column = pb + j * 4;
+        f4 r = f4Mul(a0, f4Set(column[0]));
+        r = f4MulAdd(a1, f4Set(column[1]), r);
+        r = f4MulAdd(a2, f4Set(column[2]), r);
+        r = f4MulAdd(a3, f4Set(column[3]), r);
+        f4Store(out + j * 4, r);
+    }
+    return result;
+}
+
+// a * b for a b whose last row is 0 0 0 1 (translation/rotation/scale), 12 multiply-adds less than simdMul
+inline glm::mat4 simdMulAffine(const glm::mat4& a, const glm::mat4& b)
+{
+    glm::mat4 result;
+    const float* pa = matrixData(a);
+    const float* pb = matrixData(b);
+    float* out = matrixData(result);
+    f4 a0 = f4Load(pa), a1 = f4Load(pa + 4), a2 = f4Load(pa + 8), a3 = f4Load(pa + 12);
+    for(int j = 0; j < 3; j++){
+        const float* column = pb + j * 4;
+        f4 r = f4Mul(a0, f4Set(column[0]));
+        r = f4MulAdd(a1, f4Set(column[1]), r);
+        r = f4MulAdd(a2, f4Set(column[2]), r);
+        f4Store(out + j * 4, r);
+    }
+    f4 r = f4MulAdd(a0, f4Set(pb[12]), a3);
+    r = f4MulAdd(a1, f4Set(pb[13]), r);
+    r = f4MulAdd(a2, f4Set(pb[14]), r);
+    f4Store(out + 12, r);
+    return result;
+}
+
+// out[i] = a * b[i], out may be b
+inline void simdMulBatch(const glm::mat4& a, const glm::mat4* b, glm::mat4* out, unsigned int count)
+{
+#if defined(SIMD_MATH_AVX)
+    if(simdHasAVX){
+        for(unsigned int i = 0; i < count; i++)
+            simdMulAVX(matrixData(a), matrixData(b[i]), matrixData(out[i]));
+        return;
+    }
+#endif
+    const float* pa = matrixData(a);
+    f4 a0 = f4Load(pa), a1 = f4Load(pa + 4), a2 = f4Load(pa + 8), a3 = f4Load(pa + 12);
+    for(unsigned int i = 0; i < count; i++){
+        const float* pb = matrixData(b[i]);
+        f4 r[4];
+        for(int j = 0; j < 4; j++){
+            const float* column = pb + j * 4;
+            r[j] = f4Mul(a0, f4Set(column[0]));
+            r[j] = f4MulAdd(a1, f4Set(column[1]), r[j]);
+            r[j] = f4MulAdd(a2, f4Set(column[2]), r[j]);
+            r[j] = f4MulAdd(a3, f4Set(column[3]), r[j]);
+        }
+        //all of b[i] is read before anything is written, so out can alias b
+        float* po = matrixData(out[i]);
+        for(int j = 0; j < 4; j++)
+            f4Store(po + j * 4, r[j]);
+    }
+}
+
+// translate(p) * mat4_cast(q) * scale(s) for 4 objects. The inputs are structure of arrays, 4 floats each,
+// q has to be normalized. Every lane is one object until the very end, where 4 transposes turn the rows into
+// the columns of the 4 matrices.
+inline void simdComposeTRS4(const float* px, const float* py, const float* pz,
+                            const float* qx, const float* qy, const float* qz, const float* qw,
+                            const float* sx, const float* sy, const float* sz, glm::mat4* out)
+{
+    f4 x = f4Load(qx), y = f4Load(qy), z = f4Load(qz), w = f4Load(qw);
+    f4 two = f4Set(2.0f), one = f4Set(1.0f);
+    f4 x2 = f4Mul(x, two), y2 = f4Mul(y, two), z2 = f4Mul(z, two);
+    f4 xx = f4Mul(x, x2), yy = f4Mul(y, y2), zz = f4Mul(z, z2);
+    f4 xy = f4Mul(x, y2), xz = f4Mul(x, z2), yz = f4Mul(y, z2);
+    f4 wx = f4Mul(w, x2), wy = f4Mul(w, y2), wz = f4Mul(w, z2);
+
+    f4 scaleX = f4Load(sx), scaleY = f4Load(sy), scaleZ = f4Load(sz);
+    //rcr = row r of column c, for all 4 objects
+    f4 r00 = f4Mul(f4Sub(one, f4Add(yy, zz)), scaleX);
+    f4 r10 = f4Mul(f4Add(xy, wz), scaleX);
+    f4 r20 = f4Mul(f4Sub(xz, wy), scaleX);
+    f4 r01 = f4Mul(f4Sub(xy, wz), scaleY);
+    f4 r11 = f4Mul(f4Sub(one, f4Add(xx, zz)), scaleY);
+    f4 r21 = f4Mul(f4Add(yz, wx), scaleY);
+    f4 r02 = f4Mul(f4Add(xz, wy), scaleZ);
+    f4 r12 = f4Mul(f4Sub(yz, wx), scaleZ);
+    f4 r22 = f4Mul(f4Sub(one, f4Add(xx, yy)), scaleZ);
+    f4 zero = f4Set(0.0f);
+    f4 r03 = f4Load(px), r13 = f4Load(py), r23 = f4Load(pz), r33 = one;
+
+    f4 rows[4][4] = {{r00, r10, r20, zero}, {r01, r11, r21, zero}, {r02, r12, r22, zero}, {r03, r13, r23, r33}};
+    for(int c = 0; c < 4; c++){
+        f4Transpose(rows[c][0], rows[c][1], rows[c][2], rows[c][3]);
+        for(int i = 0; i < 4; i++)
+            f4Store(matrixData(out[i]) + c * 4, rows[c][i]);
+    }
+}
+
+#endif
@@ -0,0 +1,287 @@
+#ifndef SIMULATION_H
+#define SIMULATION_H
+
+#include <glm/glm.hpp>
+
+#include "camera.h"
+#include "ecs.h"
+#include "jobs.h"
+#include "scene.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Fixed timestep simulation on its own thread, decoupled from rendering.
+// The simulation thread runs SIM_TICK_RATE ticks a second no matter how fast frames come: it applies the input
+// gathered by the main thread, moves the camera, runs onTick (animation, gameplay) and publishes a snapshot of
+// the result. The render thread keeps the two newest snapshots and draws an interpolation between them at
+// "now - one tick", so while it builds and submits frame N the simulation is already working on the next tick,
+// and motion stays smooth at any frame rate.
+//
+// Ownership while it runs:
+//  - the simulation thread writes Transform (and whatever onTick touches) and the camera
+//  - the render thread reads the snapshots and writes WorldTransform and Selectable (outline.h, the selection in
+//    main.cpp), every other component stays read only for it
+//  - nobody creates/destroys entities or adds/removes components, do that between stop() and start()
+//
+// usage: start(world) after the scene is set up, every frame setInput() + interpolate(world) before drawing, stop()
+
+#define SIM_TICK_RATE 60
+
+// what the main thread collected since the last tick
+struct SimInput {
+    bool forward = false;
+    bool backward = false;
+    bool left = false;
+    bool right = false;
+};
+
+struct SimSnapshot {
+    uint64_t tick = 0;
+    double time = 0.0; // seconds since start(), same clock as Simulation::clock()
+    glm::vec3 cameraPosition;
+    glm::vec3 cameraDirection;
+    glm::vec3 cameraUp;
+    bool flashLightOn = false;
+    // every Transform in the order of world.chunks<Transform, WorldTransform>(), which can't change while running
+    std::vector<Transform> transforms;
+};
+
+class Simulation {
+    public:
+        // simulation thread state, only touch it while the thread is stopped
+        Camera camera;
+        bool flashLightOn = true;
+        float fov = 45.0f; // mouse sensitivity scales with it
+        // scene systems, runs on the simulation thread once per tick with the fixed step in seconds
+        std::function<void(World&, float)> onTick;
+
+        // statistics
+        std::atomic<uint64_t> ticks{0};
+        std::atomic<uint64_t> droppedTicks{0}; // skipped because a tick took longer than its budget
+
+        explicit Simulation(const Camera& startCamera) : camera(startCamera) {}
+
+        static float tickLength(){
+            return 1.0f / SIM_TICK_RATE;
+        }
+
+        void start(World& scene){
+            if(thread.joinable())
+                return;
+            world = &scene;
+            quit = false;
+            startTime = std::chrono::steady_clock::now();
+            //tick 0 is the scene as it was set up, so the first frame has something to draw
+            capture(back, 0);
+            previous = back;
+            current = back;
+            ready = back;
+            hasReady = false;
+            thread = std::thread([this](){ run(); });
+        }
+
+        void stop(){
+            if(!thread.joinable())
+                return;
+            quit = true;
+            thread.join();
+        }
+
+        // seconds since start()
+        double clock() const{
+            return std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+        }
+
+        // main thread, held keys at the time of the call
+        void setInput(const SimInput& input){
+            std::lock_guard<std::mutex> lock(inputMutex);
+            pendingInput = input;
+        }
+
+        // main thread, mouse offsets add up until the next tick
+        void addMouseMovement(float xoffset, float yoffset){
+            std::lock_guard<std::mutex> lock(inputMutex);
+            mouseX += xoffset;
+            mouseY += yoffset;
+        }
+
+        void toggleFlashLight(){
+            std::lock_guard<std::mutex> lock(inputMutex);
+            flashLightToggles++;
+        }
+
+        // render thread, once per frame: picks up the newest snapshot, interpolates every Transform into
+        // WorldTransform and returns the blend factor between previousSnapshot() and currentSnapshot()
+        float interpolate(World& scene){
+            {
+                std::lock_guard<std::mutex> lock(snapshotMutex);
+                if(hasReady){
+                    std::swap(previous, current);
+                    std::swap(current, ready);
+                    hasReady = false;
+                }
+            }
+
+            //one tick behind, so there is almost always a newer snapshot to blend towards
+            float alpha = 1.0f;
+            double renderTime = clock() - tickLength();
+            if(current.time > previous.time)
+                alpha = (float)((renderTime - previous.time) / (current.time - previous.time));
+            alpha = alpha < 0.0f ? 0.0f : (alpha > 1.0f ? 1.0f : alpha);
+            blend = alpha;
+
+            std::vector<Chunk*> chunks = scene.chunks<Transform, WorldTransform>();
+            std::vector<unsigned int> first(chunks.size());
+            unsigned int total = 0;
+            for(unsigned int c = 0; c < chunks.size(); c++){
+                first[c] = total;
+                total += chunks[c]->count;
+            }
+            if(current.transforms.size() != total)
+                return alpha;
+            const Transform* from = previous.transforms.size() == total ? previous.transforms.data() : current.transforms.data();
+            const Transform* to = current.transforms.data();
+            jobSystem.parallelFor((unsigned int)chunks.size(), 1, [&](unsigned int begin, unsigned int end){
+                for(unsigned int c = begin; c < end; c++){
+                    WorldTransform* worlds = chunks[c]->get<WorldTransform>();
+                    //blend a batch, then build the matrices of the whole batch with simd
+                    Transform blended[64];
+                    for(unsigned int start = 0; start < chunks[c]->count; start += 64){
+                        unsigned int batch = chunks[c]->count - start < 64 ? chunks[c]->count - start : 64;
+                        for(unsigned int i = 0; i < batch; i++)
+                            blended[i] = interpolateTransform(from[first[c] + start + i], to[first[c] + start + i], alpha);
+                        composeWorldMatrices(blended, worlds + start, batch);
+                    }
+                }
+            });
+            return alpha;
+        }
+
+        const SimSnapshot& previousSnapshot() const{
+            return previous;
+        }
+
+        const SimSnapshot& currentSnapshot() const{
+            return current;
+        }
+
+        // moves camera to where it was at the time interpolate() was called for, built from the snapshots only since
+        // the live camera belongs to the simulation thread. Goes through the setters, so camera.version() only
+        // changes when the camera really moved. That needs the exact snapshot values while it stands still,
+        // glm::mix(x, x, t) is off by an ulp for most t
+        void interpolateCamera(Camera& target) const{
+            target.setPosition(mixExact(previous.cameraPosition, current.cameraPosition, blend));
+            target.setOrientation(mixExact(previous.cameraDirection, current.cameraDirection, blend),
+                                  mixExact(previous.cameraUp, current.cameraUp, blend));
+        }
+
+        // render state that doesn't interpolate comes from the newest tick
+        bool flashLight() const{
+            return current.flashLightOn;
+        }
+
+    private:
+        static glm::vec3 mixExact(const glm::vec3& a, const glm::vec3& b, float t){
+            return a == b ? a : glm::mix(a, b, t);
+        }
+
+        World* world = nullptr;
+        std::thread thread;
+        std::atomic<bool> quit{false};
+        std::chrono::steady_clock::time_point startTime;
+
+        std::mutex inputMutex;
+        SimInput pendingInput;
+        float mouseX = 0.0f;
+        float mouseY = 0.0f;
+        unsigned int flashLightToggles = 0;
+
+        // four buffers that only ever get swapped: the simulation fills back and trades it for ready,
+        // the render thread trades current for ready and keeps the old current as previous
+        std::mutex snapshotMutex;
+        SimSnapshot back;
+        SimSnapshot ready;
+        bool hasReady = false;
+        SimSnapshot previous; //render thread
+        SimSnapshot current;  //render thread
+        float blend = 1.0f;
+
+        void run(){
+            const std::chrono::steady_clock::duration step = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(tickLength()));
+            uint64_t tick = 0;
+            while(!quit){
+                std::this_thread::sleep_until(startTime + step * (tick + 1));
+                tick++;
+                //more than a few ticks behind (debugger, hitch), drop them instead of trying to catch up
+                uint64_t due = (uint64_t)((std::chrono::steady_clock::now() - startTime) / step);
+                if(due > tick + 4){
+                    droppedTicks += due - tick;
+                    tick = due;
+                }
+                update(tickLength());
+                capture(back, tick);
+                {
+                    std::lock_guard<std::mutex> lock(snapshotMutex);
+                    std::swap(back, ready);
+                    hasReady = true;
+                }
+                ticks++;
+            }
+        }
+
+        void update(float dt){
+            SimInput input;
+            float x, y;
+            unsigned int toggles;
+            {
+                std::lock_guard<std::mutex> lock(inputMutex);
+                input = pendingInput;
+                x = mouseX;
+                y = mouseY;
+                toggles = flashLightToggles;
+                mouseX = mouseY = 0.0f;
+                flashLightToggles = 0;
+            }
+
+            if(x != 0.0f || y != 0.0f)
+                camera.ProcessMouseMovement(x, y, fov);
+            if(input.forward)
+                camera.ProcessKeyboard(FORWARD, dt);
+            if(input.backward)
+                camera.ProcessKeyboard(BACKWARD, dt);
+            if(input.left)
+                camera.ProcessKeyboard(LEFT, dt);
+            if(input.right)
+                camera.ProcessKeyboard(RIGHT, dt);
+            if(toggles % 2)
+                flashLightOn = !flashLightOn;
+
+            if(onTick)
+                onTick(*world, dt);
+        }
+
+        void capture(SimSnapshot& snapshot, uint64_t tick){
+            snapshot.tick = tick;
+            snapshot.time = tick * (double)tickLength();
+            snapshot.cameraPosition = camera.camPos;
+            snapshot.cameraDirection = camera.direction;
+            snapshot.cameraUp = camera.up;
+            snapshot.flashLightOn = flashLightOn;
+
+            std::vector<Chunk*> chunks = world->chunks<Transform, WorldTransform>();
+            snapshot.transforms.clear();
+            for(unsigned int c = 0; c < chunks.size(); c++){
+                const Transform* transforms = chunks[c]->get<Transform>();
+                snapshot.transforms.insert(snapshot.transforms.end(), transforms, transforms + chunks[c]->count);
+            }
+        }
+};
+
+#endif
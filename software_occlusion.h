@@ -0,0 +1,375 @@
+#ifndef SOFTWARE_OCCLUSION_H
+#define SOFTWARE_OCCLUSION_H
+
+#include <glm/glm.hpp>
+
+#include "ecs.h"
+#include "jobs.h"
+#include "occlusion.h"
+#include "scene.h"
+#include "simd_math.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+//the AVX2 rows are compiled for avx2/fma on their own whatever the build flags, and picked at runtime
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define SOFTWARE_OCCLUSION_AVX2
+#endif
+
+// Occlusion culling without the gpu: a handful of low poly occluder meshes are rasterized depth only into a
+// small cpu depth buffer with the camera's matrices, the depth goes into a HiZBuffer (occlusion.h) and boxes are
+// tested against that the same way as against the gpu readback. No readback latency, so no popping, and it
+// works on machines that have no gpu at all.
+//  - begin() -> draw()... transforms and near clips the triangles and bins them into 64x32 tiles
+//  - finish() rasterizes the tiles in parallel on the job system, then builds the pyramid
+//  - rows of a tile are walked 8 pixels at a time with AVX2 (edge functions and the depth plane for 8 pixels
+//    per step) when the cpu has it, 4 at a time with simd_math.h's f4 (SSE2, NEON) otherwise
+// Occluders have to be inside the real geometry: a low resolution pixel counts as covered when its center is, so
+// a stand in that sticks out can hide things that are visible past its edge.
+//
+// usage per frame: begin(viewProjection, reversedZ) -> draw(mesh, model)... -> finish() -> isOccluded()...
+
+#define OCCLUSION_TILE_WIDTH 64
+#define OCCLUSION_TILE_HEIGHT 32
+
+// low poly stand in for an entity's mesh, drawn into the software depth buffer
+struct Occluder {
+    unsigned int mesh; // handle from SoftwareOcclusion::addMesh
+};
+
+class SoftwareOcclusion {
+    public:
+        bool simd = true; // off forces the scalar rows (benchmarks)
+        bool avx2 = cpuHasAVX2(); // 8 wide rows instead of 4, off when the cpu can't
+
+        // statistics of the last frame
+        unsigned int triangles = 0;     // after near clipping
+        unsigned int tileTriangles = 0; // summed over the bins, triangles covering several tiles count several times
+
+        SoftwareOcclusion(int width = 320, int height = 192){
+            resize(width, height);
+        }
+
+        // width is rounded up to a multiple of 8 so rows are whole AVX registers
+        void resize(int w, int h){
+            width = (w + 7) & ~7;
+            height = h;
+            depth.assign(width * height, 0.0f);
+            tilesX = (width + OCCLUSION_TILE_WIDTH - 1) / OCCLUSION_TILE_WIDTH;
+            tilesY = (height + OCCLUSION_TILE_HEIGHT - 1) / OCCLUSION_TILE_HEIGHT;
+            bins.assign(tilesX * tilesY, std::vector<uint32_t>());
+        }
+
+        // returns the handle for Occluder/draw(), indices are a triangle list
+        unsigned int addMesh(const std::vector<glm::vec3>& positions, const std::vector<unsigned int>& indices){
+            meshes.push_back({positions, indices});
+            return (unsigned int)meshes.size() - 1;
+        }
+
+        void begin(const glm::mat4& matrix, bool reversed){
+            viewProjection = matrix;
+            reversedZ = reversed;
+            screen.clear();
+            for(unsigned int i = 0; i < bins.size(); i++)
+                bins[i].clear();
+            triangles = 0;
+            tileTriangles = 0;
+        }
+
+        void draw(unsigned int mesh, const glm::mat4& model){
+            const OccluderMesh& occluder = meshes[mesh];
+            glm::mat4 mvp = simdMul(viewProjection, model);
+            clip.resize(occluder.positions.size());
+            for(unsigned int i = 0; i < occluder.positions.size(); i++)
+                clip[i] = mvp * glm::vec4(occluder.positions[i], 1.0f);
+
+            for(unsigned int i = 0; i + 3 <= occluder.indices.size(); i += 3){
+                glm::vec4 polygon[4];
+                unsigned int count = clipNear(clip[occluder.indices[i]], clip[occluder.indices[i + 1]], clip[occluder.indices[i + 2]], polygon);
+                //a clipped triangle is a quad, fan it
+                for(unsigned int k = 2; k < count; k++)
+                    addTriangle(polygon[0], polygon[k - 1], polygon[k]);
+            }
+        }
+
+        void finish(){
+            float clearDepth = reversedZ ? 0.0f : 1.0f;
+            jobSystem.parallelFor((unsigned int)bins.size(), 1, [this, clearDepth](unsigned int begin, unsigned int end){
+                for(unsigned int tile = begin; tile < end; tile++)
+                    rasterizeTile(tile, clearDepth);
+            });
+            hiz.build(depth.data(), width, height, glm::vec2((float)width, (float)height), viewProjection, reversedZ);
+        }
+
+        bool isOccluded(glm::vec3 boxMin, glm::vec3 boxMax) const{
+            return hiz.isOccluded(boxMin, boxMax);
+        }
+
+        const HiZBuffer& depthPyramid() const{
+            return hiz;
+        }
+
+        // row 0 at the bottom, width x height
+        const float* depthBuffer() const{
+            return depth.data();
+        }
+
+        int bufferWidth() const{
+            return width;
+        }
+
+        int bufferHeight() const{
+            return height;
+        }
+
+    private:
+        struct OccluderMesh {
+            std::vector<glm::vec3> positions;
+            std::vector<unsigned int> indices;
+        };
+
+        // screen space in pixels, counter clockwise, depth as the plane z = z0 + dzdx * x + dzdy * y
+        struct ScreenTriangle {
+            float x[3], y[3];
+            float z0, dzdx, dzdy;
+            int minX, maxX, minY, maxY; // pixel bounds, inclusive
+        };
+
+        int width = 0;
+        int height = 0;
+        int tilesX = 0;
+        int tilesY = 0;
+        std::vector<float> depth;
+        std::vector<OccluderMesh> meshes;
+        std::vector<glm::vec4> clip;
+        std::vector<ScreenTriangle> screen;
+        std::vector<std::vector<uint32_t>> bins;
+        glm::mat4 viewProjection = glm::mat4(1.0f);
+        bool reversedZ = false;
+        HiZBuffer hiz;
+
+        // distance to the near plane in clip space, >= 0 is in front of it
+        float nearDistance(const glm::vec4& v) const{
+            return reversedZ ? v.w - v.z : v.z + v.w;
+        }
+
+        // Sutherland-Hodgman against the near plane only, x/y are clamped to the screen when binning and the far
+        // plane (if there is one) is rejected by the depth test since nothing is farther than the clear value
+        unsigned int clipNear(const glm::vec4& a, const glm::vec4& b, const glm::vec4& c, glm::vec4* out) const{
+            const glm::vec4 in[3] = {a, b, c};
+            float distance[3] = {nearDistance(a), nearDistance(b), nearDistance(c)};
+            if(distance[0] >= 0.0f && distance[1] >= 0.0f && distance[2] >= 0.0f){
+                out[0] = a;
+                out[1] = b;
+                out[2] = c;
+                return 3;
+            }
+            unsigned int count = 0;
+            for(int i = 0; i < 3; i++){
+                int j = (i + 1) % 3;
+                if(distance[i] >= 0.0f)
+                    out[count++] = in[i];
+                if((distance[i] >= 0.0f) != (distance[j] >= 0.0f)){
+                    float t = distance[i] / (distance[i] - distance[j]);
+                    out[count++] = in[i] + (in[j] - in[i]) * t;
+                }
+            }
+            return count;
+        }
+
+        void addTriangle(glm::vec4 a, glm::vec4 b, glm::vec4 c){
+            glm::vec4 v[3] = {a, b, c};
+            ScreenTriangle triangle;
+            float z[3];
+            for(int i = 0; i < 3; i++){
+                float w = v[i].w > 1e-6f ? v[i].w : 1e-6f;
+                triangle.x[i] = (v[i].x / w * 0.5f + 0.5f) * width;
+                triangle.y[i] = (v[i].y / w * 0.5f + 0.5f) * height;
+                z[i] = reversedZ ? v[i].z / w : v[i].z / w * 0.5f + 0.5f;
+            }
+
+            float area = (triangle.x[1] - triangle.x[0]) * (triangle.y[2] - triangle.y[0]) - (triangle.x[2] - triangle.x[0]) * (triangle.y[1] - triangle.y[0]);
+            if(area == 0.0f)
+                return;
+            //both windings are drawn, flip the clockwise ones so inside is always where all edges are >= 0
+            if(area < 0.0f){
+                std::swap(triangle.x[1], triangle.x[2]);
+                std::swap(triangle.y[1], triangle.y[2]);
+                std::swap(z[1], z[2]);
+                area = -area;
+            }
+            triangle.dzdx = ((z[1] - z[0]) * (triangle.y[2] - triangle.y[0]) - (z[2] - z[0]) * (triangle.y[1] - triangle.y[0])) / area;
+            triangle.dzdy = ((z[2] - z[0]) * (triangle.x[1] - triangle.x[0]) - (z[1] - z[0]) * (triangle.x[2] - triangle.x[0])) / area;
+            //the plane is stored relative to pixel 0,0 so the rasterizer doesn't need x0/y0
+            triangle.z0 = z[0] - triangle.dzdx * triangle.x[0] - triangle.dzdy * triangle.y[0];
+
+            float minX = std::min(triangle.x[0], std::min(triangle.x[1], triangle.x[2]));
+            float maxX = std::max(triangle.x[0], std::max(triangle.x[1], triangle.x[2]));
+            float minY = std::min(triangle.y[0], std::min(triangle.y[1], triangle.y[2]));
+            float maxY = std::max(triangle.y[0], std::max(triangle.y[1], triangle.y[2]));
+            //pixel centers at +0.5
+            triangle.minX = std::max(0, (int)std::ceil(minX - 0.5f));
+            triangle.maxX = std::min(width - 1, (int)std::floor(maxX - 0.5f));
+            triangle.minY = std::max(0, (int)std::ceil(minY - 0.5f));
+            triangle.maxY = std::min(height - 1, (int)std::floor(maxY - 0.5f));
+            if(triangle.minX > triangle.maxX || triangle.minY > triangle.maxY)
+                return;
+
+            uint32_t index = (uint32_t)screen.size();
+            screen.push_back(triangle);
+            triangles++;
+            for(int ty = triangle.minY / OCCLUSION_TILE_HEIGHT; ty <= triangle.maxY / OCCLUSION_TILE_HEIGHT; ty++){
+                for(int tx = triangle.minX / OCCLUSION_TILE_WIDTH; tx <= triangle.maxX / OCCLUSION_TILE_WIDTH; tx++){
+                    bins[ty * tilesX + tx].push_back(index);
+                    tileTriangles++;
+                }
+            }
+        }
+
+        void rasterizeTile(unsigned int tile, float clearDepth){
+            int tileX = (int)(tile % tilesX) * OCCLUSION_TILE_WIDTH;
+            int tileY = (int)(tile / tilesX) * OCCLUSION_TILE_HEIGHT;
+            int tileMaxX = std::min(tileX + OCCLUSION_TILE_WIDTH, width) - 1;
+            int tileMaxY = std::min(tileY + OCCLUSION_TILE_HEIGHT, height) - 1;
+            for(int y = tileY; y <= tileMaxY; y++)
+                std::fill(depth.begin() + y * width + tileX, depth.begin() + y * width + tileMaxX + 1, clearDepth);
+
+            const std::vector<uint32_t>& bin = bins[tile];
+            for(unsigned int i = 0; i < bin.size(); i++){
+                const ScreenTriangle& triangle = screen[bin[i]];
+                //edge i goes from vertex i to vertex i + 1, e(x, y) = a * x + b * y + c is >= 0 inside
+                float a[3], b[3], c[3];
+                for(int e = 0; e < 3; e++){
+                    int n = (e + 1) % 3;
+                    a[e] = triangle.y[e] - triangle.y[n];
+                    b[e] = triangle.x[n] - triangle.x[e];
+                    c[e] = triangle.x[e] * triangle.y[n] - triangle.x[n] * triangle.y[e];
+                }
+                int x0 = std::max(triangle.minX, tileX), x1 = std::min(triangle.maxX, tileMaxX);
+                int y0 = std::max(triangle.minY, tileY), y1 = std::min(triangle.maxY, tileMaxY);
+                if(simd){
+#if defined(SOFTWARE_OCCLUSION_AVX2)
+                    if(avx2){
+                        rasterizeAVX2(triangle, a, b, c, x0, x1, y0, y1);
+                        continue;
+                    }
+#endif
+                    rasterize4(triangle, a, b, c, x0, x1, y0, y1);
+                    continue;
+                }
+                for(int y = y0; y <= y1; y++){
+                    float py = y + 0.5f;
+                    float* row = depth.data() + y * width;
+                    for(int x = x0; x <= x1; x++){
+                        float px = x + 0.5f;
+                        if(a[0] * px + b[0] * py + c[0] < 0.0f || a[1] * px + b[1] * py + c[1] < 0.0f || a[2] * px + b[2] * py + c[2] < 0.0f)
+                            continue;
+                        float z = triangle.z0 + triangle.dzdx * px + triangle.dzdy * py;
+                        if(reversedZ ? z > row[x] : z < row[x])
+                            row[x] = z;
+                    }
+                }
+            }
+        }
+
+        // 4 pixels of a row per step from x0 rounded down to 4, the same walk as rasterizeAVX2 at half the width
+        void rasterize4(const ScreenTriangle& triangle, const float* a, const float* b, const float* c, int x0, int x1, int y0, int y1){
+            static const float laneOffsets[4] = {0.5f, 1.5f, 2.5f, 3.5f};
+            const f4 lane = f4Load(laneOffsets);
+            const f4 zero = f4Set(0.0f);
+            const f4 end = f4Set(x1 + 1.0f);
+            f4 a0 = f4Set(a[0]), a1 = f4Set(a[1]), a2 = f4Set(a[2]);
+            f4 dzdx = f4Set(triangle.dzdx);
+            int start = x0 & ~3;
+            for(int y = y0; y <= y1; y++){
+                float py = y + 0.5f;
+                f4 r0 = f4Set(b[0] * py + c[0]);
+                f4 r1 = f4Set(b[1] * py + c[1]);
+                f4 r2 = f4Set(b[2] * py + c[2]);
+                f4 rz = f4Set(triangle.z0 + triangle.dzdy * py);
+                float* row = depth.data() + y * width;
+                for(int x = start; x <= x1; x += 4){
+                    f4 px = f4Add(f4Set((float)x), lane);
+                    f4 inside = f4And(f4And(f4GreaterEqual(f4MulAdd(a0, px, r0), zero), f4GreaterEqual(f4MulAdd(a1, px, r1), zero)),
+                                      f4GreaterEqual(f4MulAdd(a2, px, r2), zero));
+                    if(!f4Any(inside))
+                        continue;
+                    //pixel centers past x1 + 1 are the neighbouring tile's
+                    inside = f4And(inside, f4Less(px, end));
+                    f4 z = f4MulAdd(dzdx, px, rz);
+                    f4 current = f4Load(row + x);
+                    f4 closer = reversedZ ? f4Greater(z, current) : f4Less(z, current);
+                    f4Store(row + x, f4Select(f4And(inside, closer), z, current));
+                }
+            }
+        }
+
+#if defined(SOFTWARE_OCCLUSION_AVX2)
+        // the first call can come from a global's constructor, before the runtime filled in the cpu features
+        static bool cpuHasAVX2(){
+            static const bool supported = (__builtin_cpu_init(), __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"));
+            return supported;
+        }
+
+        // 8 pixels of a row per step from x0 rounded down to 8, which is still inside the tile since tiles start on
+        // multiples of 64. Lanes left of x0 are left of the triangle and fail the edge test, lanes past x1 are
+        // masked off
+        __attribute__((target("avx2,fma")))
+        void rasterizeAVX2(const ScreenTriangle& triangle, const float* a, const float* b, const float* c, int x0, int x1, int y0, int y1){
+            const __m256 lane = _mm256_setr_ps(0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f);
+            const __m256 zero = _mm256_setzero_ps();
+            __m256 a0 = _mm256_set1_ps(a[0]), a1 = _mm256_set1_ps(a[1]), a2 = _mm256_set1_ps(a[2]);
+            __m256 dzdx = _mm256_set1_ps(triangle.dzdx);
+            int start = x0 & ~7;
+            for(int y = y0; y <= y1; y++){
+                float py = y + 0.5f;
+                //row constants: b * py + c, and the depth plane at x = 0
+                __m256 r0 = _mm256_set1_ps(b[0] * py + c[0]);
+                __m256 r1 = _mm256_set1_ps(b[1] * py + c[1]);
+                __m256 r2 = _mm256_set1_ps(b[2] * py + c[2]);
+                __m256 rz = _mm256_set1_ps(triangle.z0 + triangle.dzdy * py);
+                float* row = depth.data() + y * width;
+                for(int x = start; x <= x1; x += 8){
+                    __m256 px = _mm256_add_ps(_mm256_set1_ps((float)x), lane);
+                    __m256 e0 = _mm256_fmadd_ps(a0, px, r0);
+                    __m256 e1 = _mm256_fmadd_ps(a1, px, r1);
+                    __m256 e2 = _mm256_fmadd_ps(a2, px, r2);
+                    __m256 z = _mm256_fmadd_ps(dzdx, px, rz);
+                    __m256 inside = _mm256_and_ps(_mm256_and_ps(_mm256_cmp_ps(e0, zero, _CMP_GE_OQ), _mm256_cmp_ps(e1, zero, _CMP_GE_OQ)), _mm256_cmp_ps(e2, zero, _CMP_GE_OQ));
+                    if(_mm256_testz_ps(inside, inside))
+                        continue;
+                    //lanes past x1 belong to the neighbouring tile (or the row padding), leave them alone
+                    if(x + 7 > x1){
+                        __m256i index = _mm256_add_epi32(_mm256_set1_epi32(x), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+                        __m256i limit = _mm256_set1_epi32(x1 + 1);
+                        inside = _mm256_and_ps(inside, _mm256_castsi256_ps(_mm256_cmpgt_epi32(limit, index)));
+                    }
+                    __m256 current = _mm256_loadu_ps(row + x);
+                    __m256 closer = reversedZ ? _mm256_cmp_ps(z, current, _CMP_GT_OQ) : _mm256_cmp_ps(z, current, _CMP_LT_OQ);
+                    _mm256_storeu_ps(row + x, _mm256_blendv_ps(current, z, _mm256_and_ps(inside, closer)));
+                }
+            }
+        }
+#else
+        static bool cpuHasAVX2(){
+            return false;
+        }
+#endif
+};
+
+// every entity with an Occluder, at its current WorldTransform
+inline void rasterizeOccluders(World& world, SoftwareOcclusion& occlusion, const glm::mat4& viewProjection, bool reversedZ)
+{
+    occlusion.begin(viewProjection, reversedZ);
+    world.eachChunk<WorldTransform, Occluder>([&occlusion](unsigned int count, const Entity*, WorldTransform* worlds, Occluder* occluders){
+        for(unsigned int i = 0; i < count; i++)
+            occlusion.draw(occluders[i].mesh, worlds[i].matrix);
+    });
+    occlusion.finish();
+}
+
+#endif
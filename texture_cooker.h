@@ -0,0 +1,849 @@
+#ifndef TEXTURE_COOKER_H
+#define TEXTURE_COOKER_H
+
+#include <glad/glad.h>
+
+#include "stb_image.h"
+#include "gl_ext.h"
+#include "jobs.h"
+#include "mipmap.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Texture cooker: turns a png/jpg into a block compressed mip chain and caches it on disk as a .dds, so the
+// next launch skips stbi decoding, mip generation and the encoder, and the gpu keeps the compressed blocks
+// (BC1 is 1/8 of RGBA8, BC3/BC5/BC7 are 1/4).
+//
+//  - opaque color      -> BC1, or BC7 (mode 6) with highQuality (~+5-9dB psnr on our textures for twice the size)
+//  - color with alpha  -> BC3, its separate alpha block measured better than a single mode 6 BC7 line
+//  - normal maps       -> BC5 (only x/y are stored, z gets rebuilt in the shader)
+//
+// Without EXT_texture_compression_s3tc, BC7 takes over when ARB_texture_compression_bptc is there, otherwise
+// everything but BC5 stays RGBA8 and nothing is cached.
+// ETC2 is not produced: desktop drivers usually decompress it to RGBA8 on upload so it wouldn't save any vram.
+// tools/cook_textures.cpp runs the cooker offline and prints a quality/size report.
+
+#define TEXTURE_CACHE_DIR "cache/textures"
+#define TEXTURE_COOKER_VERSION 2
+
+// EXT_texture_compression_s3tc / EXT_texture_sRGB and ARB_texture_compression_bptc (core in 4.2)
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#define GL_COMPRESSED_RGBA_S3TC_DXT1_EXT 0x83F1
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+#ifndef GL_COMPRESSED_SRGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_SRGB_S3TC_DXT1_EXT 0x8C4C
+#define GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT 0x8C4F
+#endif
+#ifndef GL_COMPRESSED_RGBA_BPTC_UNORM
+#define GL_COMPRESSED_RGBA_BPTC_UNORM 0x8E8C
+#define GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM 0x8E8D
+#endif
+
+enum TextureFormat {
+    TEXTURE_RGBA8,
+    TEXTURE_BC1,
+    TEXTURE_BC3,
+    TEXTURE_BC5,
+    TEXTURE_BC7
+};
+
+struct CookOptions {
+    bool srgb = false;
+    bool normalMap = false;
+    bool allowS3TC = true;  // BC1/BC3
+    bool allowBC7 = true;
+    bool highQuality = false; // BC7 instead of BC1 for opaque textures
+    float alphaCutoff = 0.5f; // alpha coverage to preserve in the mips of textures with alpha, 0 = off
+    bool useCache = true;
+};
+
+// a whole mip chain in one format, level 0 first
+struct CookedTexture {
+    TextureFormat format = TEXTURE_RGBA8;
+    bool srgb = false;
+    bool hasAlpha = false;
+    int width = 0;
+    int height = 0;
+    std::vector<std::vector<uint8_t>> levels;
+
+    bool valid() const { return !levels.empty(); }
+    bool compressed() const { return format != TEXTURE_RGBA8; }
+
+    size_t byteSize() const {
+        size_t size = 0;
+        for(unsigned int i = 0; i < levels.size(); i++)
+            size += levels[i].size();
+        return size;
+    }
+
+    GLenum internalFormat() const {
+        switch(format){
+            case TEXTURE_BC1: return srgb ? GL_COMPRESSED_SRGB_S3TC_DXT1_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+            case TEXTURE_BC3: return srgb ? GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+            case TEXTURE_BC5: return GL_COMPRESSED_RG_RGTC2;
+            case TEXTURE_BC7: return srgb ? GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM : GL_COMPRESSED_RGBA_BPTC_UNORM;
+            default:          return srgb ? GL_SRGB8_ALPHA8 : GL_RGBA8;
+        }
+    }
+};
+
+// what the cooker measured, filled by cookTexture
+struct TextureReport {
+    std::string path;
+    TextureFormat format = TEXTURE_RGBA8;
+    bool fromCache = false;
+    size_t rawBytes = 0;     // RGBA8 with the same mip chain
+    size_t cookedBytes = 0;
+    double psnr = 0.0;       // level 0, over every stored channel (0 when loaded from the cache)
+};
+
+inline const char* textureFormatName(TextureFormat format)
+{
+    switch(format){
+        case TEXTURE_BC1: return "BC1";
+        case TEXTURE_BC3: return "BC3";
+        case TEXTURE_BC5: return "BC5";
+        case TEXTURE_BC7: return "BC7";
+        default:          return "RGBA8";
+    }
+}
+
+// cook options that match what the current context can sample
+inline CookOptions runtimeCookOptions(bool srgb = false)
+{
+    CookOptions options;
+    options.srgb = srgb;
+    options.allowS3TC = glExt.textureCompressionS3TC && (!srgb || glExt.textureCompressionS3TCsRGB);
+    options.allowBC7 = glExt.textureCompressionBPTC;
+    options.useCache = options.allowS3TC || options.allowBC7;
+    return options;
+}
+
+// ------------------------------------------------------------------------
+// block encoders, every block is 4x4 rgba8 texels in row order
+// ------------------------------------------------------------------------
+
+// dominant direction of a point cloud by power iteration on the covariance matrix
+inline void principalAxis(const float* points, int count, int dims, float* mean, float* axis)
+{
+    for(int d = 0; d < dims; d++){
+        mean[d] = 0.0f;
+        for(int i = 0; i < count; i++)
+            mean[d] += points[i * dims + d];
+        mean[d] /= count;
+    }
+
+    float cov[4][4] = {};
+    for(int i = 0; i < count; i++){
+        for(int a = 0; a < dims; a++){
+            for(int b = 0; b < dims; b++)
+                cov[a][b] += (points[i * dims + a] - mean[a]) * (points[i * dims + b] - mean[b]);
+        }
+    }
+
+    for(int d = 0; d < dims; d++)
+        axis[d] = 1.0f;
+    for(int iteration = 0; iteration < 8; iteration++){
+        float next[4] = {};
+        float length = 0.0f;
+        for(int a = 0; a < dims; a++){
+            for(int b = 0; b < dims; b++)
+                next[a] += cov[a][b] * axis[b];
+            length += next[a] * next[a];
+        }
+        length = std::sqrt(length);
+        if(length < 1e-6f){
+            //flat block, any axis works
+            for(int d = 0; d < dims; d++)
+                axis[d] = d == 0 ? 1.0f : 0.0f;
+            return;
+        }
+        for(int d = 0; d < dims; d++)
+            axis[d] = next[d] / length;
+    }
+}
+
+// endpoints along the principal axis, pulled in by 1/16 of the range which lowers the average error
+inline void fitEndpoints(const float* points, int dims, float* e0, float* e1)
+{
+    float mean[4], axis[4];
+    principalAxis(points, 16, dims, mean, axis);
+
+    float minT = 1e30f, maxT = -1e30f;
+    for(int i = 0; i < 16; i++){
+        float t = 0.0f;
+        for(int d = 0; d < dims; d++)
+            t += (points[i * dims + d] - mean[d]) * axis[d];
+        minT = std::fmin(minT, t);
+        maxT = std::fmax(maxT, t);
+    }
+    float inset = (maxT - minT) / 16.0f;
+    minT += inset;
+    maxT -= inset;
+    for(int d = 0; d < dims; d++){
+        e0[d] = std::fmin(std::fmax(mean[d] + axis[d] * maxT, 0.0f), 255.0f);
+        e1[d] = std::fmin(std::fmax(mean[d] + axis[d] * minT, 0.0f), 255.0f);
+    }
+}
+
+inline uint16_t packRGB565(const float* c)
+{
+    int r = (int)std::lround(c[0] * 31.0f / 255.0f);
+    int g = (int)std::lround(c[1] * 63.0f / 255.0f);
+    int b = (int)std::lround(c[2] * 31.0f / 255.0f);
+    return (uint16_t)((r << 11) | (g << 5) | b);
+}
+
+inline void unpackRGB565(uint16_t c, int* rgb)
+{
+    int r = (c >> 11) & 31, g = (c >> 5) & 63, b = c & 31;
+    rgb[0] = (r << 3) | (r >> 2);
+    rgb[1] = (g << 2) | (g >> 4);
+    rgb[2] = (b << 3) | (b >> 2);
+}
+
+// 4 color mode only, which is also what the color half of BC3 always uses
+inline void encodeBC1Block(const uint8_t* rgba, uint8_t* out)
+{
+    float points[16 * 3];
+    for(int i = 0; i < 16; i++){
+        for(int d = 0; d < 3; d++)
+            points[i * 3 + d] = rgba[i * 4 + d];
+    }
+    float e0[3], e1[3];
+    fitEndpoints(points, 3, e0, e1);
+
+    uint16_t c0 = packRGB565(e0);
+    uint16_t c1 = packRGB565(e1);
+    if(c0 < c1){
+        uint16_t t = c0; c0 = c1; c1 = t;
+    }
+
+    uint32_t indices = 0;
+    if(c0 != c1){
+        int palette[4][3];
+        unpackRGB565(c0, palette[0]);
+        unpackRGB565(c1, palette[1]);
+        for(int d = 0; d < 3; d++){
+            palette[2][d] = (2 * palette[0][d] + palette[1][d]) / 3;
+            palette[3][d] = (palette[0][d] + 2 * palette[1][d]) / 3;
+        }
+        for(int i = 0; i < 16; i++){
+            int best = 0, bestError = 1 << 30;
+            for(int p = 0; p < 4; p++){
+                int error = 0;
+                for(int d = 0; d < 3; d++){
+                    int diff = rgba[i * 4 + d] - palette[p][d];
+                    error += diff * diff;
+                }
+                if(error < bestError){
+                    bestError = error;
+                    best = p;
+                }
+            }
+            indices |= (uint32_t)best << (2 * i);
+        }
+    }
+
+    out[0] = c0 & 0xFF; out[1] = c0 >> 8;
+    out[2] = c1 & 0xFF; out[3] = c1 >> 8;
+    std::memcpy(out + 4, &indices, 4);
+}
+
+// single channel block (BC4 layout), used for the alpha of BC3 and both channels of BC5.
+// stride is the distance between two texels in values
+inline void encodeChannelBlock(const uint8_t* values, int stride, uint8_t* out)
+{
+    int minV = 255, maxV = 0;
+    for(int i = 0; i < 16; i++){
+        minV = std::min(minV, (int)values[i * stride]);
+        maxV = std::max(maxV, (int)values[i * stride]);
+    }
+
+    //a0 > a1 selects the 8 value mode
+    out[0] = (uint8_t)maxV;
+    out[1] = (uint8_t)minV;
+    uint64_t indices = 0;
+    if(maxV != minV){
+        int palette[8];
+        palette[0] = maxV;
+        palette[1] = minV;
+        for(int p = 1; p < 7; p++)
+            palette[p + 1] = ((7 - p) * maxV + p * minV) / 7;
+        for(int i = 0; i < 16; i++){
+            int best = 0, bestError = 1 << 30;
+            for(int p = 0; p < 8; p++){
+                int error = std::abs(values[i * stride] - palette[p]);
+                if(error < bestError){
+                    bestError = error;
+                    best = p;
+                }
+            }
+            indices |= (uint64_t)best << (3 * i);
+        }
+    }
+    for(int b = 0; b < 6; b++)
+        out[2 + b] = (uint8_t)(indices >> (8 * b));
+}
+
+inline void encodeBC3Block(const uint8_t* rgba, uint8_t* out)
+{
+    encodeChannelBlock(rgba + 3, 4, out);
+    encodeBC1Block(rgba, out + 8);
+}
+
+inline void encodeBC5Block(const uint8_t* rgba, uint8_t* out)
+{
+    encodeChannelBlock(rgba, 4, out);
+    encodeChannelBlock(rgba + 1, 4, out + 8);
+}
+
+static const int BC7_WEIGHTS4[16] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+// writes count bits of value starting at bit position pos
+inline void writeBits(uint8_t* block, int& pos, uint32_t value, int count)
+{
+    for(int i = 0; i < count; i++, pos++){
+        if(value & (1u << i))
+            block[pos >> 3] |= (uint8_t)(1u << (pos & 7));
+    }
+}
+
+// BC7 mode 6 only: one subset, rgba endpoints with 7 bits + a shared p-bit each and 4 bit indices.
+// It's the simplest mode and already beats BC3 on anything with smooth alpha.
+inline void encodeBC7Block(const uint8_t* rgba, uint8_t* out)
+{
+    float points[16 * 4];
+    for(int i = 0; i < 64; i++)
+        points[i] = rgba[i];
+    float e[2][4];
+    fitEndpoints(points, 4, e[0], e[1]);
+
+    //quantize to 7 bits, pick the p-bit that lands closer
+    int q[2][4], pbit[2], endpoint[2][4];
+    for(int n = 0; n < 2; n++){
+        int bestError = 1 << 30;
+        for(int p = 0; p < 2; p++){
+            int error = 0, candidate[4];
+            for(int d = 0; d < 4; d++){
+                candidate[d] = std::min(std::max((int)std::lround((e[n][d] - p) / 2.0f), 0), 127);
+                int diff = (candidate[d] << 1 | p) - (int)std::lround(e[n][d]);
+                error += diff * diff;
+            }
+            if(error < bestError){
+                bestError = error;
+                pbit[n] = p;
+                for(int d = 0; d < 4; d++)
+                    q[n][d] = candidate[d];
+            }
+        }
+        for(int d = 0; d < 4; d++)
+            endpoint[n][d] = q[n][d] << 1 | pbit[n];
+    }
+
+    int palette[16][4];
+    for(int p = 0; p < 16; p++){
+        for(int d = 0; d < 4; d++)
+            palette[p][d] = ((64 - BC7_WEIGHTS4[p]) * endpoint[0][d] + BC7_WEIGHTS4[p] * endpoint[1][d] + 32) >> 6;
+    }
+    int indices[16];
+    for(int i = 0; i < 16; i++){
+        int best = 0, bestError = 1 << 30;
+        for(int p = 0; p < 16; p++){
+            int error = 0;
+            for(int d = 0; d < 4; d++){
+                int diff = rgba[i * 4 + d] - palette[p][d];
+                error += diff * diff;
+            }
+            if(error < bestError){
+                bestError = error;
+                best = p;
+            }
+        }
+        indices[i] = best;
+    }
+
+    //the first index only has 3 bits so its top bit must be 0, swapping the endpoints flips every index
+    if(indices[0] & 8){
+        for(int d = 0; d < 4; d++){
+            int t = q[0][d]; q[0][d] = q[1][d]; q[1][d] = t;
+        }
+        int t = pbit[0]; pbit[0] = pbit[1]; pbit[1] = t;
+        for(int i = 0; i < 16; i++)
+            indices[i] = 15 - indices[i];
+    }
+
+    std::memset(out, 0, 16);
+    int pos = 0;
+    writeBits(out, pos, 1u << 6, 7); //mode 6
+    for(int d = 0; d < 4; d++){
+        writeBits(out, pos, q[0][d], 7);
+        writeBits(out, pos, q[1][d], 7);
+    }
+    writeBits(out, pos, pbit[0], 1);
+    writeBits(out, pos, pbit[1], 1);
+    for(int i = 0; i < 16; i++)
+        writeBits(out, pos, indices[i], i == 0 ? 3 : 4);
+}
+
+// ------------------------------------------------------------------------
+// decoders, only used to measure the quality of what we just encoded
+// ------------------------------------------------------------------------
+
+inline void decodeBC1Block(const uint8_t* in, uint8_t* rgba)
+{
+    uint16_t c0 = in[0] | in[1] << 8, c1 = in[2] | in[3] << 8;
+    uint32_t indices;
+    std::memcpy(&indices, in + 4, 4);
+    int palette[4][3];
+    unpackRGB565(c0, palette[0]);
+    unpackRGB565(c1, palette[1]);
+    for(int d = 0; d < 3; d++){
+        palette[2][d] = (2 * palette[0][d] + palette[1][d]) / 3;
+        palette[3][d] = (palette[0][d] + 2 * palette[1][d]) / 3;
+    }
+    for(int i = 0; i < 16; i++){
+        int p = (indices >> (2 * i)) & 3;
+        for(int d = 0; d < 3; d++)
+            rgba[i * 4 + d] = (uint8_t)palette[p][d];
+        rgba[i * 4 + 3] = 255;
+    }
+}
+
+inline void decodeChannelBlock(const uint8_t* in, uint8_t* values, int stride)
+{
+    int palette[8];
+    palette[0] = in[0];
+    palette[1] = in[1];
+    if(palette[0] > palette[1]){
+        for(int p = 1; p < 7; p++)
+            palette[p + 1] = ((7 - p) * palette[0] + p * palette[1]) / 7;
+    }else{
+        for(int p = 1; p < 5; p++)
+            palette[p + 1] = ((5 - p) * palette[0] + p * palette[1]) / 5;
+        palette[6] = 0;
+        palette[7] = 255;
+    }
+    uint64_t indices = 0;
+    for(int b = 0; b < 6; b++)
+        indices |= (uint64_t)in[2 + b] << (8 * b);
+    for(int i = 0; i < 16; i++)
+        values[i * stride] = (uint8_t)palette[(indices >> (3 * i)) & 7];
+}
+
+inline uint32_t readBits(const uint8_t* block, int& pos, int count)
+{
+    uint32_t value = 0;
+    for(int i = 0; i < count; i++, pos++)
+        value |= (uint32_t)((block[pos >> 3] >> (pos & 7)) & 1) << i;
+    return value;
+}
+
+inline void decodeBC7Block(const uint8_t* in, uint8_t* rgba)
+{
+    int pos = 7;
+    int q[2][4], endpoint[2][4];
+    for(int d = 0; d < 4; d++){
+        q[0][d] = readBits(in, pos, 7);
+        q[1][d] = readBits(in, pos, 7);
+    }
+    int p0 = readBits(in, pos, 1), p1 = readBits(in, pos, 1);
+    for(int d = 0; d < 4; d++){
+        endpoint[0][d] = q[0][d] << 1 | p0;
+        endpoint[1][d] = q[1][d] << 1 | p1;
+    }
+    for(int i = 0; i < 16; i++){
+        int w = BC7_WEIGHTS4[readBits(in, pos, i == 0 ? 3 : 4)];
+        for(int d = 0; d < 4; d++)
+            rgba[i * 4 + d] = (uint8_t)(((64 - w) * endpoint[0][d] + w * endpoint[1][d] + 32) >> 6);
+    }
+}
+
+// ------------------------------------------------------------------------
+// whole images
+// ------------------------------------------------------------------------
+
+inline int textureBlockSize(TextureFormat format)
+{
+    return format == TEXTURE_BC1 ? 8 : 16;
+}
+
+inline std::vector<uint8_t> compressImage(const std::vector<uint8_t>& rgba, int width, int height, TextureFormat format)
+{
+    int blocksX = (width + 3) / 4, blocksY = (height + 3) / 4;
+    int blockSize = textureBlockSize(format);
+    std::vector<uint8_t> out(blocksX * blocksY * blockSize);
+    //rows of blocks are independent, spread them over the job system
+    jobSystem.parallelFor(blocksY, 4, [&](unsigned int firstRow, unsigned int endRow){
+        uint8_t block[64];
+        for(int by = (int)firstRow; by < (int)endRow; by++){
+            for(int bx = 0; bx < blocksX; bx++){
+                //edge blocks repeat the last row/column
+                for(int y = 0; y < 4; y++){
+                    for(int x = 0; x < 4; x++){
+                        int sx = std::min(bx * 4 + x, width - 1), sy = std::min(by * 4 + y, height - 1);
+                        std::memcpy(block + (y * 4 + x) * 4, &rgba[(sy * width + sx) * 4], 4);
+                    }
+                }
+                uint8_t* dst = &out[(by * blocksX + bx) * blockSize];
+                switch(format){
+                    case TEXTURE_BC1: encodeBC1Block(block, dst); break;
+                    case TEXTURE_BC3: encodeBC3Block(block, dst); break;
+                    case TEXTURE_BC5: encodeBC5Block(block, dst); break;
+                    case TEXTURE_BC7: encodeBC7Block(block, dst); break;
+                    default: break;
+                }
+            }
+        }
+    });
+    return out;
+}
+
+inline std::vector<uint8_t> decompressImage(const std::vector<uint8_t>& data, int width, int height, TextureFormat format)
+{
+    std::vector<uint8_t> rgba(width * height * 4);
+    int blocksX = (width + 3) / 4, blocksY = (height + 3) / 4;
+    int blockSize = textureBlockSize(format);
+    uint8_t block[64];
+    for(int by = 0; by < blocksY; by++){
+        for(int bx = 0; bx < blocksX; bx++){
+            const uint8_t* src = &data[(by * blocksX + bx) * blockSize];
+            switch(format){
+                case TEXTURE_BC1: decodeBC1Block(src, block); break;
+                case TEXTURE_BC3: decodeBC1Block(src + 8, block); decodeChannelBlock(src, block + 3, 4); break;
+                case TEXTURE_BC5:
+                    decodeChannelBlock(src, block, 4);
+                    decodeChannelBlock(src + 8, block + 1, 4);
+                    for(int i = 0; i < 16; i++){
+                        block[i * 4 + 2] = 0;
+                        block[i * 4 + 3] = 255;
+                    }
+                    break;
+                case TEXTURE_BC7: decodeBC7Block(src, block); break;
+                default: break;
+            }
+            for(int y = 0; y < 4 && by * 4 + y < height; y++){
+                for(int x = 0; x < 4 && bx * 4 + x < width; x++)
+                    std::memcpy(&rgba[((by * 4 + y) * width + bx * 4 + x) * 4], block + (y * 4 + x) * 4, 4);
+            }
+        }
+    }
+    return rgba;
+}
+
+// peak signal to noise ratio over the first channels channels (higher is better, 40+ is hard to tell apart)
+inline double imagePSNR(const std::vector<uint8_t>& a, const std::vector<uint8_t>& b, int channels)
+{
+    double sum = 0.0;
+    size_t count = 0;
+    for(size_t i = 0; i < a.size(); i += 4){
+        for(int c = 0; c < channels; c++){
+            double diff = (double)a[i + c] - (double)b[i + c];
+            sum += diff * diff;
+            count++;
+        }
+    }
+    if(sum == 0.0)
+        return 99.0;
+    return 10.0 * std::log10(255.0 * 255.0 / (sum / count));
+}
+
+inline TextureFormat chooseTextureFormat(bool hasAlpha, const CookOptions& options)
+{
+    if(options.normalMap)
+        return TEXTURE_BC5; //rgtc is core in 3.0
+    if(options.allowS3TC && !(options.highQuality && !hasAlpha && options.allowBC7))
+        return hasAlpha ? TEXTURE_BC3 : TEXTURE_BC1;
+    return options.allowBC7 ? TEXTURE_BC7 : TEXTURE_RGBA8;
+}
+
+// ------------------------------------------------------------------------
+// dds cache
+// ------------------------------------------------------------------------
+
+// FNV-1a, only used to notice that the source image changed
+inline uint64_t hashBytes(const void* data, size_t size, uint64_t hash = 14695981039346656037ull)
+{
+    const uint8_t* bytes = (const uint8_t*)data;
+    for(size_t i = 0; i < size; i++){
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+inline bool readFileBytes(const std::string& path, std::vector<uint8_t>& bytes)
+{
+    std::ifstream file(path, std::ios::binary);
+    if(!file)
+        return false;
+    bytes.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    return true;
+}
+
+inline std::string textureCachePath(const std::string& path)
+{
+    std::string name = path;
+    for(unsigned int i = 0; i < name.size(); i++){
+        if(name[i] == '/' || name[i] == '\\' || name[i] == ':')
+            name[i] = '_';
+    }
+    return std::string(TEXTURE_CACHE_DIR) + "/" + name + ".dds";
+}
+
+// DDS_HEADER + DDS_HEADER_DXT10, we always write the DX10 extension so every BC format is described the same way.
+// dwReserved1 carries our cache key: 'LOGL', cooker version, source hash (2 words), option bits
+struct DDSFile {
+    uint32_t magic;
+    uint32_t size, flags, height, width, pitchOrLinearSize, depth, mipMapCount;
+    uint32_t reserved1[11];
+    uint32_t pfSize, pfFlags, pfFourCC, pfRGBBitCount, pfRBitMask, pfGBitMask, pfBBitMask, pfABitMask;
+    uint32_t caps, caps2, caps3, caps4, reserved2;
+    uint32_t dxgiFormat, resourceDimension, miscFlag, arraySize, miscFlags2;
+};
+
+inline uint32_t ddsFourCC(char a, char b, char c, char d)
+{
+    return (uint32_t)a | (uint32_t)b << 8 | (uint32_t)c << 16 | (uint32_t)d << 24;
+}
+
+inline uint32_t dxgiFormat(TextureFormat format, bool srgb)
+{
+    switch(format){
+        case TEXTURE_BC1: return srgb ? 72 : 71;
+        case TEXTURE_BC3: return srgb ? 78 : 77;
+        case TEXTURE_BC5: return 83;
+        case TEXTURE_BC7: return srgb ? 99 : 98;
+        default:          return srgb ? 29 : 28;
+    }
+}
+
+inline uint32_t cookOptionBits(const CookOptions& options)
+{
+    return (options.srgb ? 1 : 0) | (options.normalMap ? 2 : 0) | (options.allowS3TC ? 4 : 0) | (options.allowBC7 ? 8 : 0)
+         | (options.highQuality ? 16 : 0);
+}
+
+inline bool writeTextureCache(const std::string& cachePath, const CookedTexture& texture, uint64_t sourceHash, const CookOptions& options)
+{
+    std::error_code error;
+    std::filesystem::create_directories(std::filesystem::path(cachePath).parent_path(), error);
+    std::ofstream file(cachePath, std::ios::binary);
+    if(!file){
+        std::cout << "ERROR::TEXTURE_COOKER::CANNOT_WRITE " << cachePath << std::endl;
+        return false;
+    }
+
+    DDSFile header = {};
+    header.magic = ddsFourCC('D', 'D', 'S', ' ');
+    header.size = 124;
+    header.flags = 0x1 | 0x2 | 0x4 | 0x1000 | 0x20000 | 0x80000; //caps, height, width, pixelformat, mipmapcount, linearsize
+    header.height = texture.height;
+    header.width = texture.width;
+    header.pitchOrLinearSize = (uint32_t)texture.levels[0].size();
+    header.mipMapCount = (uint32_t)texture.levels.size();
+    header.reserved1[0] = ddsFourCC('L', 'O', 'G', 'L');
+    header.reserved1[1] = TEXTURE_COOKER_VERSION;
+    header.reserved1[2] = (uint32_t)sourceHash;
+    header.reserved1[3] = (uint32_t)(sourceHash >> 32);
+    header.reserved1[4] = cookOptionBits(options) | (texture.hasAlpha ? 32 : 0);
+    header.reserved1[5] = (uint32_t)(options.alphaCutoff * 255.0f + 0.5f);
+    header.pfSize = 32;
+    header.pfFlags = 0x4; //fourcc
+    header.pfFourCC = ddsFourCC('D', 'X', '1', '0');
+    header.caps = 0x1000 | 0x400000 | 0x8; //texture, mipmap, complex
+    header.dxgiFormat = dxgiFormat(texture.format, texture.srgb);
+    header.resourceDimension = 3; //texture2d
+    header.arraySize = 1;
+
+    file.write((const char*)&header, sizeof(header));
+    for(unsigned int i = 0; i < texture.levels.size(); i++)
+        file.write((const char*)texture.levels[i].data(), texture.levels[i].size());
+    return (bool)file;
+}
+
+// only accepts files we wrote ourselves for exactly this source and these options
+inline bool readTextureCache(const std::string& cachePath, uint64_t sourceHash, const CookOptions& options, CookedTexture& texture)
+{
+    std::vector<uint8_t> bytes;
+    if(!readFileBytes(cachePath, bytes) || bytes.size() < sizeof(DDSFile))
+        return false;
+
+    DDSFile header;
+    std::memcpy(&header, bytes.data(), sizeof(header));
+    if(header.magic != ddsFourCC('D', 'D', 'S', ' ') || header.reserved1[0] != ddsFourCC('L', 'O', 'G', 'L')
+        || header.reserved1[1] != TEXTURE_COOKER_VERSION || header.reserved1[2] != (uint32_t)sourceHash
+        || header.reserved1[3] != (uint32_t)(sourceHash >> 32) || (header.reserved1[4] & 31) != cookOptionBits(options)
+        || header.reserved1[5] != (uint32_t)(options.alphaCutoff * 255.0f + 0.5f))
+        return false;
+
+    TextureFormat formats[] = {TEXTURE_BC1, TEXTURE_BC3, TEXTURE_BC5, TEXTURE_BC7, TEXTURE_RGBA8};
+    bool known = false;
+    for(TextureFormat format : formats){
+        if(dxgiFormat(format, options.srgb) == header.dxgiFormat){
+            texture.format = format;
+            known = true;
+        }
+    }
+    if(!known)
+        return false;
+
+    texture.srgb = options.srgb;
+    texture.hasAlpha = (header.reserved1[4] & 32) != 0;
+    texture.width = header.width;
+    texture.height = header.height;
+    texture.levels.clear();
+    size_t offset = sizeof(DDSFile);
+    int width = texture.width, height = texture.height;
+    for(uint32_t level = 0; level < header.mipMapCount; level++){
+        size_t size = texture.compressed() ? (size_t)((width + 3) / 4) * ((height + 3) / 4) * textureBlockSize(texture.format)
+                                           : (size_t)width * height * 4;
+        if(offset + size > bytes.size())
+            return false;
+        texture.levels.push_back(std::vector<uint8_t>(bytes.begin() + offset, bytes.begin() + offset + size));
+        offset += size;
+        width = std::max(width / 2, 1);
+        height = std::max(height / 2, 1);
+    }
+    return true;
+}
+
+// ------------------------------------------------------------------------
+// entry points
+// ------------------------------------------------------------------------
+
+// decode + mip chain + compress. Goes through the on-disk cache when options.useCache is set, report is optional
+inline CookedTexture cookTexture(const std::string& path, const CookOptions& options, TextureReport* report = nullptr)
+{
+    CookedTexture texture;
+    std::vector<uint8_t> source;
+    if(!readFileBytes(path, source)){
+        std::cout << "Texture failed to load at path: " << path << std::endl;
+        return texture;
+    }
+    uint64_t sourceHash = hashBytes(source.data(), source.size());
+    std::string cachePath = textureCachePath(path);
+
+    if(report){
+        *report = TextureReport();
+        report->path = path;
+    }
+
+    if(options.useCache && readTextureCache(cachePath, sourceHash, options, texture)){
+        if(report){
+            report->format = texture.format;
+            report->fromCache = true;
+            report->cookedBytes = texture.byteSize();
+            int width = texture.width, height = texture.height;
+            for(unsigned int i = 0; i < texture.levels.size(); i++){
+                report->rawBytes += (size_t)width * height * 4;
+                width = std::max(width / 2, 1);
+                height = std::max(height / 2, 1);
+            }
+        }
+        return texture;
+    }
+
+    int width, height, nrComponents;
+    unsigned char* data = stbi_load_from_memory(source.data(), (int)source.size(), &width, &height, &nrComponents, 4);
+    if(!data){
+        std::cout << "Texture failed to load at path: " << path << std::endl;
+        return texture;
+    }
+    texture.width = width;
+    texture.height = height;
+    texture.srgb = options.srgb && !options.normalMap;
+    for(size_t i = 3; i < (size_t)width * height * 4 && !texture.hasAlpha; i += 4)
+        texture.hasAlpha = data[i] != 255;
+    texture.format = chooseTextureFormat(texture.hasAlpha, options);
+
+    //textures with alpha get clamped by uploadTexture in main.cpp, everything else repeats
+    MipOptions mipOptions;
+    mipOptions.srgb = texture.srgb;
+    mipOptions.wrap = !texture.hasAlpha;
+    mipOptions.alphaCutoff = texture.hasAlpha ? options.alphaCutoff : 0.0f;
+    std::vector<std::vector<uint8_t>> mips = generateMipChain(data, width, height, mipOptions);
+    stbi_image_free(data);
+
+    for(unsigned int level = 0; level < mips.size(); level++){
+        if(report)
+            report->rawBytes += mips[level].size();
+        texture.levels.push_back(texture.compressed() ? compressImage(mips[level], width, height, texture.format) : mips[level]);
+        width = std::max(width / 2, 1);
+        height = std::max(height / 2, 1);
+    }
+    const std::vector<uint8_t>& firstLevel = mips[0];
+
+    if(report){
+        report->format = texture.format;
+        report->cookedBytes = texture.byteSize();
+        if(texture.compressed()){
+            int channels = texture.format == TEXTURE_BC5 ? 2 : (texture.hasAlpha ? 4 : 3);
+            report->psnr = imagePSNR(firstLevel, decompressImage(texture.levels[0], texture.width, texture.height, texture.format), channels);
+        }else{
+            report->psnr = 99.0;
+        }
+    }
+
+    if(options.useCache && texture.compressed())
+        writeTextureCache(cachePath, texture, sourceHash, options);
+    return texture;
+}
+
+// runs cookTexture on a worker thread, start these early and collect them right before the upload.
+// From a job thread with workers around the cook becomes a job (and its encoder splits into more), otherwise it
+// gets its own thread. Collect a job cook with jobSystem.waitFor() before get(), a plain get() never runs it.
+inline std::future<CookedTexture> cookTextureAsync(const std::string& path, const CookOptions& options)
+{
+    if(!jobSystem.onJobThread() || jobSystem.threadCount() == 1){
+        return std::async(std::launch::async, [path, options](){
+            return cookTexture(path, options);
+        });
+    }
+    //jobs only hold trivially destructible captures, the job deletes its state when it's done
+    struct Cook {
+        std::string path;
+        CookOptions options;
+        std::promise<CookedTexture> result;
+    };
+    Cook* cook = new Cook{path, options, std::promise<CookedTexture>()};
+    std::future<CookedTexture> result = cook->result.get_future();
+    jobSystem.run(jobSystem.create([cook](){
+        cook->result.set_value(cookTexture(cook->path, cook->options));
+        delete cook;
+    }));
+    return result;
+}
+
+// uploads every level as is, the caller sets wrap/filter parameters
+inline unsigned int uploadCookedTexture(const CookedTexture& texture)
+{
+    unsigned int textureID;
+    glGenTextures(1, &textureID);
+    glBindTexture(GL_TEXTURE_2D, textureID);
+    int width = texture.width, height = texture.height;
+    for(unsigned int level = 0; level < texture.levels.size(); level++){
+        if(texture.compressed())
+            glCompressedTexImage2D(GL_TEXTURE_2D, level, texture.internalFormat(), width, height, 0, (GLsizei)texture.levels[level].size(), texture.levels[level].data());
+        else
+            glTexImage2D(GL_TEXTURE_2D, level, texture.internalFormat(), width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, texture.levels[level].data());
+        width = std::max(width / 2, 1);
+        height = std::max(height / 2, 1);
+    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)texture.levels.size() - 1);
+    return textureID;
+}
+
+#endif
@@ -0,0 +1,59 @@
+// Offline texture cooker: fills cache/textures with block compressed mip chains so the app never has to
+// encode at startup, and prints a quality/size report for every texture.
+//
+// build (from the repo root):
+//   clang++ -std=c++17 -O2 -I. -Idependencies/include tools/cook_textures.cpp stb_helper.cpp -o cook_textures
+// run from the repo root so the cache paths match the ones the app uses:
+//   ./cook_textures [--hq] [--no-bc7] [--no-s3tc] [--srgb] [--normal] textures/*.png textures/*.jpg
+
+#include "texture_cooker.h"
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+int main(int argc, char** argv)
+{
+    CookOptions options;
+    std::vector<std::string> paths;
+    for(int i = 1; i < argc; i++){
+        std::string arg = argv[i];
+        if(arg == "--hq")
+            options.highQuality = true;
+        else if(arg == "--no-bc7")
+            options.allowBC7 = false;
+        else if(arg == "--no-s3tc")
+            options.allowS3TC = false;
+        else if(arg == "--srgb")
+            options.srgb = true;
+        else if(arg == "--normal")
+            options.normalMap = true;
+        else
+            paths.push_back(arg);
+    }
+    if(paths.empty()){
+        //the textures main.cpp uses
+        paths = {"textures/marble.jpg", "textures/metal.png", "textures/window.png", "textures/grass.png"};
+    }
+
+    size_t totalRaw = 0, totalCooked = 0;
+    printf("%-32s %-6s %6s %12s %12s %7s %8s\n", "texture", "format", "mips", "rgba8", "cooked", "ratio", "psnr");
+    for(unsigned int i = 0; i < paths.size(); i++){
+        TextureReport report;
+        CookedTexture texture = cookTexture(paths[i], options, &report);
+        if(!texture.valid())
+            continue;
+
+        totalRaw += report.rawBytes;
+        totalCooked += report.cookedBytes;
+        printf("%-32s %-6s %6d %12zu %12zu %6.1fx", paths[i].c_str(), textureFormatName(report.format), (int)texture.levels.size(),
+            report.rawBytes, report.cookedBytes, (double)report.rawBytes / report.cookedBytes);
+        if(report.fromCache)
+            printf(" %8s\n", "cached");
+        else
+            printf(" %6.2fdB\n", report.psnr);
+    }
+    if(totalCooked > 0)
+        printf("total: %zu -> %zu bytes (%.1fx smaller)\n", totalRaw, totalCooked, (double)totalRaw / totalCooked);
+    return 0;
+}